@@ -0,0 +1,25 @@
+/**
+ * Functions called by ffi_call.yog. bench/run.py builds this into
+ * ffi_call.so.
+ */
+
+struct Point {
+    int x;
+    int y;
+};
+
+int
+add(int a, int b)
+{
+    return a + b;
+}
+
+int
+point_sum(struct Point* p)
+{
+    return p->x + p->y;
+}
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
@@ -0,0 +1,147 @@
+# -*- coding: utf-8 -*-
+"""
+Runs benchmarks in this directory and prints the best wall-clock time of each
+one. Set YOG to use a yog other than ../src/yog.
+
+    $ python bench/run.py [-n times] [benchmark.yog ...]
+
+--startup-benchmark measures how long yog takes to boot and exit with an empty
+script, with and without the boot snapshot.
+
+    $ python bench/run.py --startup-benchmark [-n times]
+
+--gc-threads-benchmark runs gc_mark.yog with 1, 2, 4, ... GC threads and
+prints a chart of the time. Parallel marking is implemented in the
+mark-sweep-compact GC, so set YOG to yog-mark-sweep-compact.
+
+    $ YOG=src/yog-mark-sweep-compact python bench/run.py --gc-threads-benchmark
+
+--ffi-benchmark measures overhead of FFI calls of int f(int, int) and of a
+function taking a pointer to a struct. ffi_call.c is built with $CC (default:
+cc) into a temporary directory.
+
+    $ python bench/run.py --ffi-benchmark [-n times]
+"""
+
+from __future__ import print_function
+
+from glob import glob
+from multiprocessing import cpu_count
+from optparse import OptionParser
+from os import environ
+from os.path import abspath, basename, dirname, join
+from shutil import rmtree
+from subprocess import PIPE, Popen, check_call
+from tempfile import mkdtemp
+from time import time
+import sys
+
+def get_command():
+    try:
+        return environ["YOG"]
+    except KeyError:
+        pass
+    return abspath(join(dirname(abspath(__file__)), "..", "src", "yog"))
+
+def run(yog, args):
+    start = time()
+    proc = Popen([yog] + args, stdin=PIPE, stdout=PIPE)
+    proc.communicate()
+    elapsed = time() - start
+    if proc.returncode != 0:
+        raise Exception("%s exited with %d" % (" ".join(args), proc.returncode))
+    return elapsed
+
+def print_result(name, sec):
+    print("%-24s %8.3f sec" % (name, sec))
+    sys.stdout.flush()
+
+def run_startup_benchmark(yog, times):
+    # yog reads an empty script from stdin.
+    dir = mkdtemp()
+    try:
+        snapshot = "--boot-snapshot=" + join(dir, "boot.yogc")
+        run(yog, [snapshot])
+        for name, args in [
+                ("no-boot-snapshot", ["--no-boot-snapshot"]),
+                ("boot-snapshot", [snapshot])]:
+            print_result(name, min([run(yog, args) for _ in range(times)]))
+    finally:
+        rmtree(dir)
+
+def build_ffi_lib(dir):
+    src = join(dirname(abspath(__file__)), "ffi_call.c")
+    so = join(dir, "ffi_call.so")
+    cc = environ.get("CC", "cc")
+    check_call([cc, "-O2", "-shared", "-fPIC", "-o", so, src])
+    return so
+
+def run_ffi_benchmark(yog, times):
+    benchmark = join(dirname(abspath(__file__)), "ffi_call.yog")
+    dir = mkdtemp()
+    try:
+        so = build_ffi_lib(dir)
+        for kind in ["int", "struct"]:
+            args = [benchmark, so, kind]
+            name = "ffi_call (%s)" % (kind, )
+            print_result(name, min([run(yog, args) for _ in range(times)]))
+    finally:
+        rmtree(dir)
+
+def run_gc_threads_benchmark(yog, times):
+    benchmark = join(dirname(abspath(__file__)), "gc_mark.yog")
+    results = []
+    n = 1
+    while n <= cpu_count():
+        args = ["--gc-threads=%d" % (n, ), benchmark]
+        results.append((n, min([run(yog, args) for _ in range(times)])))
+        n *= 2
+    longest = max([sec for _, sec in results])
+    for n, sec in results:
+        bar = "#" * int(40 * sec / longest)
+        print("%2d threads %8.3f sec %s" % (n, sec, bar))
+        sys.stdout.flush()
+
+def main():
+    parser = OptionParser(
+            usage="%prog [-n times] [--startup-benchmark] [--gc-threads-benchmark] "
+            "[--ffi-benchmark] [benchmark.yog ...]")
+    parser.add_option("-n", dest="times", type="int", default=5,
+            help="runs each benchmark TIMES times (default: 5)")
+    parser.add_option("--startup-benchmark", dest="startup",
+            action="store_true", default=False,
+            help="measures startup time instead of benchmarks")
+    parser.add_option("--gc-threads-benchmark", dest="gc_threads",
+            action="store_true", default=False,
+            help="measures major GC time with various numbers of GC threads")
+    parser.add_option("--ffi-benchmark", dest="ffi",
+            action="store_true", default=False,
+            help="measures overhead of FFI calls")
+    opts, args = parser.parse_args()
+
+    yog = get_command()
+    if opts.startup:
+        run_startup_benchmark(yog, opts.times)
+        return
+    if opts.gc_threads:
+        run_gc_threads_benchmark(yog, opts.times)
+        return
+    if opts.ffi:
+        run_ffi_benchmark(yog, opts.times)
+        return
+    benchmarks = args or sorted(glob(join(dirname(abspath(__file__)), "*.yog")))
+    dir = mkdtemp()
+    try:
+        for benchmark in benchmarks:
+            args = [benchmark]
+            if basename(benchmark) == "ffi_call.yog":
+                args.append(build_ffi_lib(dir))
+            best = min([run(yog, args) for _ in range(opts.times)])
+            print_result(basename(benchmark), best)
+    finally:
+        rmtree(dir)
+
+if __name__ == "__main__":
+    main()
+
+# vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
@@ -10,6 +10,7 @@
  */
 /* src/builtins.c */
 void YogBuiltins_boot(YogEnv*, YogHandle*);
+void YogBuiltins_boot_gc(YogEnv*, YogHandle*);
 
 /* PROTOTYPE_END */
 
@@ -24,6 +24,16 @@ struct YogClass {
     void (*exec_set_descr)(YogEnv*, YogVal, YogVal, YogVal);
     Executor exec;
     Caller call;
+
+    /**
+     * version is bumped whenever an attribute of this class is changed. An
+     * inline cache of load_attr is valid only while this value and
+     * YogVM::attr_cache_serial are same as when the cache was filled. A change
+     * of a class which has subclasses bumps attr_cache_serial instead of
+     * versions of all subclasses.
+     */
+    uint_t version;
+    BOOL has_subclass;
 };
 
 typedef struct YogClass YogClass;
@@ -57,8 +67,10 @@ YogVal YogClass_get_attr(YogEnv*, YogVal, ID);
 YogVal YogClass_get_attr_and_defining_class(YogEnv*, YogVal, ID, YogVal*);
 void YogClass_include_module(YogEnv*, YogVal, YogVal);
 void YogClass_init(YogEnv*, YogVal, type_t, YogVal);
+void YogClass_invalidate_attr_caches(YogEnv*, YogVal);
 void YogClass_keep_children(YogEnv*, void*, ObjectKeeper, void*);
 YogVal YogClass_new(YogEnv*, const char*, YogVal);
+void YogClass_set_super(YogEnv*, YogVal, YogVal);
 
 /* PROTOTYPE_END */
 
@@ -28,6 +28,42 @@ struct YogLinenoTableEntry {
 
 typedef struct YogLinenoTableEntry YogLinenoTableEntry;
 
+#define ATTR_CACHE_WAYS     4
+
+/**
+ * An inline cache entry of load_attr. The entry is valid when the receiver's
+ * class is klass, its version is version and YogVM::attr_cache_serial is
+ * serial.
+ */
+struct YogAttrCacheEntry {
+    YogVal klass;
+    uint_t version;
+    uint_t serial;
+    YogVal attr;
+    YogVal defining_class;
+};
+
+typedef struct YogAttrCacheEntry YogAttrCacheEntry;
+
+/**
+ * shape and slot cache an instance attribute. slot is negative when objects of
+ * the shape don't have the attribute.
+ */
+struct YogAttrCache {
+    struct YogAttrCacheEntry entries[ATTR_CACHE_WAYS];
+    YogVal shape;
+    int_t slot;
+};
+
+typedef struct YogAttrCache YogAttrCache;
+
+struct YogAttrCacheArray {
+    uint_t size;
+    struct YogAttrCache items[0];
+};
+
+typedef struct YogAttrCacheArray YogAttrCacheArray;
+
 struct YogCode {
     struct YogBasicObj base;
 
@@ -49,6 +85,8 @@ struct YogCode {
     YogVal filename;
     ID class_name;
     ID func_name;
+
+    YogVal attr_caches;
 };
 
 typedef struct YogCode YogCode;
@@ -65,9 +103,13 @@ typedef struct YogCode YogCode;
  * DON'T EDIT THIS AREA. HERE IS GENERATED BY update_prototype.py.
  */
 /* src/code.c */
+YogVal YogCode_alloc_attr_caches(YogEnv*, uint_t);
 void YogCode_define_classes(YogEnv*, YogHandle*);
+int_t YogCode_find_slot(YogEnv*, YogVal, uint_t, YogVal, ID);
 BOOL YogCode_get_lineno(YogEnv*, YogVal, uint_t, uint_t*);
+YogVal YogCode_lookup_attr_cache(YogEnv*, YogVal, uint_t, YogVal, YogVal*);
 YogVal YogCode_new(YogEnv*);
+void YogCode_update_attr_cache(YogEnv*, YogVal, uint_t, YogVal, YogVal, YogVal);
 
 /* src/code.inc */
 const char* YogCode_get_op_name(OpCode);
@@ -0,0 +1,43 @@
+#if !defined(YOG_CODE_CACHE_H_INCLUDED)
+#define YOG_CODE_CACHE_H_INCLUDED
+
+#include <stdio.h>
+#if defined(YOG_HAVE_STDINT_H)
+#   include <stdint.h>
+#endif
+#include "yog/vm.h"
+#include "yog/yog.h"
+
+/**
+ * Identifies contents of a source file. A cache file (foo.yogc) is valid for
+ * foo.yog when they have the same stamp. hash is computed only when mtime is
+ * not enough to decide.
+ */
+struct YogSourceStamp {
+    BOOL valid;
+    uint64_t mtime;
+    uint64_t size;
+    BOOL hashed;
+    uint32_t hash;
+};
+
+typedef struct YogSourceStamp YogSourceStamp;
+
+/* PROTOTYPE_START */
+
+/**
+ * DON'T EDIT THIS AREA. HERE IS GENERATED BY update_prototype.py.
+ */
+/* src/code_cache.c */
+YogVal YogCodeCache_get_boot_code(YogEnv*, YogVM*, const char*);
+YogVal YogCodeCache_load(YogEnv*, YogHandle*, FILE*, YogSourceStamp*);
+void YogCodeCache_load_boot_snapshot(YogEnv*, YogVM*);
+void YogCodeCache_store(YogEnv*, YogHandle*, YogSourceStamp*, YogHandle*);
+void YogCodeCache_store_boot_snapshot(YogEnv*, YogVM*);
+
+/* PROTOTYPE_END */
+
+#endif
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
@@ -10,6 +10,7 @@
  */
 /* src/coroutine.c */
 void YogCoroutine_define_classes(YogEnv*, YogVal);
+void YogCoroutine_unmap_machine_stacks(YogEnv*, YogVal);
 
 /* PROTOTYPE_END */
 
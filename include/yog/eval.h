@@ -14,7 +14,10 @@ YogVal YogEval_call_method0(YogEnv*, YogVal, const char*);
 YogVal YogEval_call_method1(YogEnv*, YogVal, const char*, YogVal);
 YogVal YogEval_call_method2(YogEnv*, YogVal, const char*, uint_t, YogVal*, YogVal);
 YogVal YogEval_call_method_id(YogEnv*, YogVal, ID, uint_t, YogVal*);
+YogVal YogEval_call_method_id0(YogEnv*, YogVal, ID);
+YogVal YogEval_call_method_id1(YogEnv*, YogVal, ID, YogVal);
 YogVal YogEval_call_method_id2(YogEnv*, YogVal, ID, uint_t, YogVal*, YogVal);
+YogVal YogEval_eval_code(YogEnv*, YogHandle*, YogVal);
 YogVal YogEval_eval_file(YogEnv*, FILE*, YogHandle*, YogHandle*);
 void YogEval_eval_package(YogEnv*, YogHandle*, YogVal);
 YogVal YogEval_eval_stdin(YogEnv*, YogHandle*, YogHandle*);
@@ -22,6 +25,7 @@ void YogEval_longjmp(YogEnv*, int);
 void YogEval_longjmp_to_prev_buf(YogEnv*, int);
 YogVal YogEval_mainloop(YogEnv*);
 void YogEval_pop_frame(YogEnv*);
+void YogEval_print_inst_profile(YogEnv*);
 void YogEval_push_finish_frame(YogEnv*);
 void YogEval_push_frame(YogEnv*, YogVal);
 void YogEval_push_returned_multi_value(YogEnv*, YogVal);
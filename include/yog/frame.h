@@ -47,7 +47,9 @@ struct YogScriptFrame {
 
     /**
      * Becomes TRUE when YogFunction::outer_frame refers this frame. Once it is
-     * TRUE, never returns to FALSE. Used frames are not reused.
+     * TRUE, never returns to FALSE. Used frames are not reused. A frame
+     * whose this flag is FALSE returns to the frame stack of the thread at
+     * ret (See YogThread_put_script_frame).
      */
     BOOL used_by_func;
 
@@ -107,6 +109,14 @@ typedef struct YogScriptFrame YogScriptFrame;
 #define SCRIPT_FRAME_STACK_TOP(frame) (SCRIPT_FRAME((frame))->locals_etc + SCRIPT_FRAME((frame))->stack_size)
 #define SCRIPT_FRAME_LOCALS(frame) (SCRIPT_FRAME((frame))->locals_etc + SCRIPT_FRAME((frame))->stack_capacity)
 #define SCRIPT_FRAME_OUTER_FRAMES(frame) (SCRIPT_FRAME_LOCALS((frame)) + SCRIPT_FRAME((frame))->locals_num)
+#define SCRIPT_FRAME_SLOTS_NUM(frame) (SCRIPT_FRAME((frame))->stack_capacity + SCRIPT_FRAME((frame))->locals_num + SCRIPT_FRAME((frame))->outer_frames_num)
+
+/**
+ * Frames from YogFrame_get_script_frame have at least this number of slots
+ * (locals_etc). Slots are rounded up to a power of two so that a returned
+ * frame fits calls of other functions.
+ */
+#define SCRIPT_FRAME_MIN_SLOTS 16
 
 /* PROTOTYPE_START */
 
@@ -1,6 +1,11 @@
 #if !defined(YOG_GC_H_INCLUDED)
 #define YOG_GC_H_INCLUDED
 
+#include "yog/config.h"
+#include <errno.h>
+#if defined(YOG_HAVE_STDINT_H)
+#   include <stdint.h>
+#endif
 #include "yog/yog.h"
 
 #define ALLOC_OBJ_SIZE(env, keep_children, finalizer, size) \
@@ -10,10 +15,16 @@
 #define ALLOC_OBJ_ITEM(env, keep_children, finalizer, type, size, item_type) \
     ALLOC_OBJ_SIZE(env, keep_children, finalizer, sizeof(type) + size * sizeof(item_type))
 
+/**
+ * Objects of this size or larger (in bytes) are allocated with mmap(2) out of
+ * the nursery and arenas. They are never copied. See src/gc/mark-sweep-compact.c.
+ */
+#define YogGC_LARGE_OBJECT_SIZE (64 * 1024)
+
 #if defined(GC_GENERATIONAL)
     /**
-     * TODO: PAYLOAD2GENERATION and PAYLOAD2REMEMBERED depend on structs in
-     * include/yog/gc/internal.h. These are not good.
+     * TODO: PAYLOAD2GENERATION, PAYLOAD2REMEMBERED and PAYLOAD2OWNER depend on
+     * structs in include/yog/gc/internal.h. These are not good.
      */
 #   define PAYLOAD2GENERATION(payload) \
                                 (*((uint_t*)(payload) - 1))
@@ -25,18 +36,52 @@
                                 (*((uint_t*)(payload) - 2))
 #   define YogGC_IS_REMEMBERED(obj) \
                                 PAYLOAD2REMEMBERED((obj))
+    /**
+     * Heap of the thread which allocated a young object. This is valid only
+     * for young objects.
+     */
+#   define PAYLOAD2OWNER(payload) \
+                                (*((struct YogHeap**)((uint_t*)(payload) - 2) - 1))
+#   define YogGC_OWNER(obj)     PAYLOAD2OWNER((obj))
+    /**
+     * Card table of a large old YogSlots object. One byte covers
+     * 1 << YogGC_CARD_SHIFT bytes of the payload. NULL for other objects.
+     */
+#   define PAYLOAD2CARDS(payload) \
+                                (*((unsigned char**)((uint_t*)(payload) - 2) - 1))
+#   define YogGC_CARD_SHIFT     9
+#   define YogGC_MARK_CARD(obj, offset) do { \
+    unsigned char* cards = PAYLOAD2CARDS((obj)); \
+    if (cards != NULL) { \
+        cards[(offset) >> YogGC_CARD_SHIFT] = TRUE; \
+    } \
+} while (0)
+#   define YogGC_OFFSET(obj, member) \
+                                ((uint_t)((char*)&(obj)->member - (char*)(obj)))
+    /**
+     * A young object escapes from its thread when it is stored into an old
+     * object or into a young object of another thread. YogGC_write_barrier
+     * marks the heap of such object as shared. A thread can collect its young
+     * generation without stopping other threads while its heap is not shared.
+     */
 #   define YogGC_UPDATE_PTR(env, obj, member, val) do { \
     do { \
-        if (!IS_PTR(PTR2VAL((obj))) || YogGC_IS_YOUNG((obj))) { \
+        if (!IS_PTR(PTR2VAL((obj)))) { \
             break; \
         } \
-        if (YogGC_IS_REMEMBERED((obj))) { \
+        if (!IS_PTR(PTR2VAL((val))) || YogGC_IS_OLD((val))) { \
             break; \
         } \
-        if (!IS_PTR(PTR2VAL((val))) || YogGC_IS_OLD((val))) { \
+        if (YogGC_IS_YOUNG((obj))) { \
+            if (YogGC_OWNER((obj)) == YogGC_OWNER((val))) { \
+                break; \
+            } \
+        } \
+        else if (YogGC_IS_REMEMBERED((obj)) && YogGC_OWNER((val))->shared) { \
+            YogGC_MARK_CARD((obj), YogGC_OFFSET((obj), member)); \
             break; \
         } \
-        YogGC_add_to_remembered_set((env), (obj)); \
+        YogGC_write_barrier((env), (obj), (void*)(val), YogGC_OFFSET((obj), member)); \
     } while (0); \
     (obj)->member = (val); \
 } while (0)
@@ -46,11 +91,47 @@
 } while (0)
 #endif
 
+/**
+ * A safepoint. A thread which runs without allocating must poll here not to
+ * block other threads' GC. The check is one load of a VM member.
+ */
+#define YogGC_SAFEPOINT(env) do { \
+    if ((env)->vm->waiting_suspend) { \
+        YogGC_safepoint((env)); \
+    } \
+} while (0)
+
+/**
+ * Runs stmt, which may block in a system call, free from GC. GC of other
+ * threads does not wait for this thread meanwhile. GC may move objects during
+ * stmt, so stmt must not touch the GC heap. Copy buffers out of the heap
+ * before. errno set by stmt is kept.
+ */
+#define YogGC_BLOCKING_REGION(env, stmt) do { \
+    YogGC_free_from_gc((env)); \
+    stmt; \
+    int saved_errno = errno; \
+    YogGC_bind_to_gc((env)); \
+    errno = saved_errno; \
+} while (0)
+
 #define YogGC_KEEP(env, obj, member, keeper, heap) do { \
     YogVal val = YogGC_keep((env), (obj)->member, (keeper), (heap)); \
     YogGC_UPDATE_PTR((env), (obj), member, val); \
 } while (0)
 
+/**
+ * Layout of objects which have only YogVals after their size (YogValArray and
+ * bins of YogTable). They must be allocated with YogGC_keep_slots. The
+ * generational GC scans only dirty cards of large ones in minor GC.
+ */
+struct YogSlots {
+    uint_t size;
+    YogVal items[0];
+};
+
+typedef struct YogSlots YogSlots;
+
 struct YogMarkedObjects {
     YogVal* ptr;
     uint_t size;
@@ -67,14 +148,66 @@ struct YogHeap {
     struct YogHeap* prev;
     struct YogHeap* next;
     BOOL refered;
+#if defined(GC_GENERATIONAL)
+    /**
+     * shared is TRUE when some young objects in this heap may be referred from
+     * other threads. Such heap is collected only in stop-the-world GC.
+     * tenure_all and keep_shared are used in stop-the-world GC. See
+     * src/gc/generational.c.
+     */
+    BOOL shared;
+    BOOL tenure_all;
+    BOOL keep_shared;
+#endif
 
     YogMarkedObjects marked_objects[2];
     YogMarkedObjects* prev_marked_objects;
     YogMarkedObjects* cur_marked_objects;
+
+    /**
+     * Bytes allocated by the thread of this heap. Only the thread updates
+     * this.
+     */
+    uint64_t allocated_size;
 };
 
 typedef struct YogHeap YogHeap;
 
+#define YogGC_HISTOGRAM_SIZE    6
+
+/**
+ * Durations in microseconds. histogram[i] counts durations less than
+ * 10 ** (i + 1) usec. The last one counts all longer ones.
+ */
+struct YogGCTimes {
+    uint_t num;
+    uint64_t total;
+    uint64_t max;
+    uint_t histogram[YogGC_HISTOGRAM_SIZE];
+};
+
+typedef struct YogGCTimes YogGCTimes;
+
+/**
+ * Statistics of GC. minor_gc includes thread-local GC. major_gc is a full GC
+ * (every GC in non-generational GC). time_to_safepoint is time from a GC
+ * request until all other threads stop. allocated_size counts bytes of
+ * threads whose heaps were deleted. The others are in YogHeap.
+ */
+struct YogGCStats {
+    YogGCTimes minor_gc;
+    YogGCTimes major_gc;
+    YogGCTimes time_to_safepoint;
+    uint_t local_gc_num;
+    uint_t parallel_mark_num;
+    uint64_t allocated_size;
+    uint64_t promoted_size;
+    uint_t remembered_set_size;
+    uint_t max_remembered_set_size;
+};
+
+typedef struct YogGCStats YogGCStats;
+
 #include <sys/types.h>
 
 /* PROTOTYPE_START */
@@ -91,13 +224,20 @@ void YogGC_compact(YogEnv*);
 void YogGC_delete(YogEnv*);
 void YogGC_free(YogEnv*, void*, size_t);
 void YogGC_free_from_gc(YogEnv*);
+size_t YogGC_get_stats(YogEnv*, YogGCStats*);
+uint_t YogGC_get_threads_stats(YogEnv*, uint_t*, uint64_t*, uint_t);
 void YogGC_init_memory(YogEnv*, void*, size_t);
 YogVal YogGC_keep(YogEnv*, YogVal, ObjectKeeper, void*);
+void YogGC_keep_slots(YogEnv*, void*, ObjectKeeper, void*);
 void* YogGC_malloc(YogEnv*, size_t);
 void YogGC_perform(YogEnv*);
 void YogGC_perform_major(YogEnv*);
 void YogGC_perform_minor(YogEnv*);
+void YogGC_print_stats(YogEnv*);
+void YogGC_safepoint(YogEnv*);
+void YogGC_share(YogEnv*, YogVal);
 void YogGC_suspend(YogEnv*);
+void YogGC_write_barrier(YogEnv*, void*, void*, uint_t);
 void YogHeap_add_to_marked_objects(YogEnv*, YogHeap*, YogVal);
 void YogHeap_finalize(YogEnv*, YogHeap*);
 void YogHeap_init(YogEnv*, YogHeap*);
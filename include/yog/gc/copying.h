@@ -20,12 +20,15 @@ Finalizer YogCopying_get_finalizer(YogEnv*, YogHeap*, void*);
 void* YogCopying_get_forwarding_addr(YogEnv*, YogHeap*, void*);
 ChildrenKeeper YogCopying_get_keeper(YogEnv*, YogHeap*, void*);
 size_t YogCopying_get_payload_size(YogEnv*, YogHeap*, void*);
+size_t YogCopying_get_size(YogEnv*, YogHeap*);
+size_t YogCopying_get_used_size(YogEnv*, YogHeap*);
 BOOL YogCopying_is_empty(YogEnv*, YogHeap*);
 BOOL YogCopying_is_finished(YogEnv*, YogHeap*);
 void YogCopying_keep_root(YogEnv*, void*, ChildrenKeeper, YogHeap*);
 YogHeap* YogCopying_new(YogEnv*, uint_t);
 void YogCopying_post_gc(YogEnv*, YogHeap*);
 void YogCopying_prepare(YogEnv*, YogHeap*);
+void YogCopying_resize(YogEnv*, YogHeap*, uint_t);
 void YogCopying_scan(YogEnv*, YogHeap*, ObjectKeeper, void*);
 void YogCopying_set_forwarding_addr(YogEnv*, YogHeap*, void*, void*);
 
@@ -13,7 +13,11 @@
 /* src/gc/generational.c */
 void YogGenerational_add_to_remembered_set(YogEnv*, YogHeap*, void*);
 void* YogGenerational_alloc(YogEnv*, YogHeap*, ChildrenKeeper, Finalizer, size_t);
+void YogGenerational_collect_locally(YogEnv*, YogHeap*);
 void YogGenerational_delete(YogEnv*, YogHeap*);
+void* YogGenerational_forward_major(YogEnv*, void*, void*);
+void* YogGenerational_forward_minor(YogEnv*, void*, void*);
+size_t YogGenerational_get_size(YogEnv*, YogHeap*);
 BOOL YogGenerational_is_empty(YogEnv*, YogHeap*);
 BOOL YogGenerational_is_finished(YogEnv*, YogHeap*);
 void YogGenerational_major_delete_garbage(YogEnv*, YogHeap*);
@@ -24,9 +28,11 @@ void YogGenerational_minor_delete_garbage(YogEnv*, YogHeap*);
 void YogGenerational_minor_keep_vm(YogEnv*, YogHeap*);
 void YogGenerational_minor_post_gc(YogEnv*, YogHeap*);
 void YogGenerational_minor_traverse(YogEnv*, YogHeap*);
+void YogGenerational_mark_card(YogEnv*, void*, uint_t);
 YogHeap* YogGenerational_new(YogEnv*, uint_t, uint_t, uint_t);
 void YogGenerational_prepare_major(YogEnv*, YogHeap*);
 void YogGenerational_prepare_minor(YogEnv*, YogHeap*);
+void YogGenerational_resize_young(YogEnv*, YogHeap*, uint_t);
 
 /* PROTOTYPE_END */
 
@@ -20,6 +20,10 @@ typedef struct RememberedSet RememberedSet;
                                 (sizeof(RememberedSet) + sizeof(void*) * (size))
 
 struct YoungHeader {
+    /**
+     * owner must be just before age. See PAYLOAD2OWNER in include/yog/gc.h.
+     */
+    struct YogHeap* owner;
     uint_t age;
 
     /**
@@ -31,6 +35,11 @@ struct YoungHeader {
 typedef struct YoungHeader YoungHeader;
 
 struct OldHeader {
+    /**
+     * cards must be just before remembered. See PAYLOAD2CARDS in
+     * include/yog/gc.h.
+     */
+    unsigned char* cards;
     BOOL remembered;
 
     /**
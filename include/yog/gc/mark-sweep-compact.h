@@ -5,6 +5,15 @@
 #include "yog/gc.h"
 #include "yog/yog.h"
 
+typedef struct YogMarkers YogMarkers;
+
+/**
+ * The mark phase is shared by markers only when the heaps have this number of
+ * living objects at least. See "Parallel Marking" in
+ * src/gc/mark-sweep-compact.c.
+ */
+#define PARALLEL_MARK_THRESHOLD 65536
+
 /* PROTOTYPE_START */
 
 /**
@@ -14,14 +23,22 @@
 void* YogMarkSweepCompact_alloc(YogEnv*, YogHeap*, ChildrenKeeper, Finalizer, size_t);
 void YogMarkSweepCompact_delete(YogEnv*, YogHeap*);
 void YogMarkSweepCompact_delete_garbage(YogEnv*, YogHeap*);
+void YogMarkSweepCompact_delete_markers(YogEnv*, YogMarkers*);
+void YogMarkSweepCompact_finish_sweeping(YogEnv*, YogHeap*);
 ChildrenKeeper YogMarkSweepCompact_get_children_keeper(YogEnv*, YogHeap*, void*);
+size_t YogMarkSweepCompact_get_size(YogEnv*, YogHeap*);
 BOOL YogMarkSweepCompact_is_empty(YogEnv*, YogHeap*);
+BOOL YogMarkSweepCompact_is_marked(YogEnv*, void*);
 void YogMarkSweepCompact_keep_root(YogEnv*, void*, ChildrenKeeper, YogHeap*);
 void* YogMarkSweepCompact_mark(YogEnv*, void*, ObjectKeeper, void*);
 void YogMarkSweepCompact_mark_children(YogEnv*, YogHeap*, ObjectKeeper);
 void YogMarkSweepCompact_mark_in_breadth_first(YogEnv*, YogHeap*);
+void YogMarkSweepCompact_mark_in_parallel(YogEnv*, YogMarkers*);
 void* YogMarkSweepCompact_mark_recursively(YogEnv*, void*, ObjectKeeper, void*);
 YogHeap* YogMarkSweepCompact_new(YogEnv*, size_t);
+YogMarkers* YogMarkSweepCompact_new_markers(YogEnv*, uint_t);
+void YogMarkSweepCompact_run_finalizers(YogEnv*, YogHeap*);
+void YogMarkSweepCompact_start_sweeping(YogEnv*, YogHeap*);
 
 /* PROTOTYPE_END */
 
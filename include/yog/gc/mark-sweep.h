@@ -14,10 +14,13 @@
 void* YogMarkSweep_alloc(YogEnv*, YogHeap*, ChildrenKeeper, Finalizer, size_t);
 void YogMarkSweep_delete(YogEnv*, YogHeap*);
 void YogMarkSweep_delete_garbage(YogEnv*, YogHeap*);
+size_t YogMarkSweep_get_size(YogEnv*, YogHeap*);
 BOOL YogMarkSweep_is_empty(YogEnv*, YogHeap*);
+BOOL YogMarkSweep_is_marked(YogEnv*, void*);
 void YogMarkSweep_keep_root(YogEnv*, void*, ChildrenKeeper, YogHeap*);
 YogHeap* YogMarkSweep_new(YogEnv*, size_t);
 void YogMarkSweep_prepare(YogEnv*, YogHeap*);
+void YogMarkSweep_start_sweeping(YogEnv*, YogHeap*);
 
 /* PROTOTYPE_END */
 
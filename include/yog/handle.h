@@ -76,6 +76,27 @@ YogHandleScope_close(YogEnv* env)
     handles->used_num -= scope->used_num;
 }
 
+/**
+ * Releases all handles of the current scope without closing it. The main loop
+ * of the interpreter calls this between instructions instead of opening and
+ * closing a scope for each of them. This does nothing when the instruction
+ * registered no handles.
+ */
+static inline void
+YogHandleScope_reset(YogEnv* env)
+{
+    YogHandles* handles = env->handles;
+    YogHandleScope* scope = handles->scope;
+    uint_t used_num = scope->used_num;
+    if (used_num == 0) {
+        return;
+    }
+
+    env->pos = env->last = NULL;
+    handles->used_num -= used_num;
+    scope->used_num = 0;
+}
+
 #endif
 /**
  * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
@@ -0,0 +1,36 @@
+#if !defined(YOG_HEAP_PROFILER_H_INCLUDED)
+#define YOG_HEAP_PROFILER_H_INCLUDED
+
+#include <stddef.h>
+#include "yog/yog.h"
+
+struct YogHeapProfiler;
+
+typedef struct YogHeapProfiler YogHeapProfiler;
+
+/**
+ * Returns the new address of a sampled object after GC, or NULL if the object
+ * died.
+ */
+typedef void* (*YogSampleForwarder)(YogEnv*, void*, void*);
+
+/* PROTOTYPE_START */
+
+/**
+ * DON'T EDIT THIS AREA. HERE IS GENERATED BY update_prototype.py.
+ */
+/* src/heap_profiler.c */
+void YogHeapProfiler_delete(YogEnv*, YogHeapProfiler*);
+void YogHeapProfiler_dump_live(YogEnv*, YogHeapProfiler*);
+YogHeapProfiler* YogHeapProfiler_new(YogEnv*, const char*, size_t);
+void YogHeapProfiler_sample(YogEnv*, YogHeapProfiler*, void*, size_t);
+void YogHeapProfiler_set_class(YogEnv*, YogHeapProfiler*, YogVal, YogVal);
+void YogHeapProfiler_update(YogEnv*, YogHeapProfiler*, YogSampleForwarder, void*, BOOL);
+void YogHeapProfiler_write(YogEnv*, YogHeapProfiler*);
+
+/* PROTOTYPE_END */
+
+#endif
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
@@ -28,9 +28,15 @@ struct YogBasicObj {
 
 typedef struct YogBasicObj YogBasicObj;
 
+/**
+ * When shape is a YogShape, attrs is a YogValArray of attribute values laid out
+ * by the shape. Otherwise attrs is a symbol table (classes, modules, packages
+ * and objects which could not get shapes. See SHAPE_MAX_CHILDREN).
+ */
 struct YogObj {
     YOGBASICOBJ_HEAD;
     YogVal attrs;
+    YogVal shape;
 };
 
 #define TYPE_OBJ TO_TYPE(YogObj_new)
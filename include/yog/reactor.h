@@ -0,0 +1,19 @@
+#if !defined(YOG_REACTOR_H_INCLUDED)
+#define YOG_REACTOR_H_INCLUDED
+
+#include "yog/yog.h"
+
+/* PROTOTYPE_START */
+
+/**
+ * DON'T EDIT THIS AREA. HERE IS GENERATED BY update_prototype.py.
+ */
+/* src/reactor.c */
+void YogReactor_boot(YogEnv*, YogHandle*);
+
+/* PROTOTYPE_END */
+
+#endif
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
@@ -8,6 +8,12 @@
 struct YogRegexp {
     YOGBASICOBJ_HEAD;
     CorgiRegexp* corgi_regexp;
+    /**
+     * The source of corgi_regexp. The code cache rebuilds a Regexp constant
+     * from them.
+     */
+    YogVal pattern;
+    BOOL ignore_case;
 };
 
 typedef struct YogRegexp YogRegexp;
@@ -0,0 +1,56 @@
+#if !defined(YOG_SHAPE_H_INCLUDED)
+#define YOG_SHAPE_H_INCLUDED
+
+#include "yog/yog.h"
+
+/**
+ * A shape describes the layout of instance attributes. Objects which got same
+ * attributes in same order share one shape, and keep their values in a flat
+ * slot array. The value of name is at size - 1 in the slot array.
+ *
+ * index is a symbol table from names to slots of a shape which has more than
+ * SHAPE_INDEX_MIN attributes. It is made with the shape and never changed.
+ */
+struct YogShape {
+    YogVal parent;
+    ID name;
+    uint_t size;
+    YogVal index;
+
+    YogVal children;
+    YogVal next_sibling;
+    uint_t children_num;
+};
+
+typedef struct YogShape YogShape;
+
+/**
+ * An object which gets more attributes than this falls back to a symbol table.
+ */
+#define SHAPE_MAX_ATTRS     64
+/**
+ * Shapes are never freed. An object which needs a new transition from a shape
+ * which already has SHAPE_MAX_CHILDREN ones, or after the VM made
+ * SHAPE_MAX_NUM shapes, falls back to a symbol table too. This keeps objects
+ * with dynamically named attributes off the tree.
+ */
+#define SHAPE_MAX_CHILDREN  16
+#define SHAPE_MAX_NUM       4096
+#define SHAPE_INDEX_MIN     8
+
+/* PROTOTYPE_START */
+
+/**
+ * DON'T EDIT THIS AREA. HERE IS GENERATED BY update_prototype.py.
+ */
+/* src/shape.c */
+YogVal YogShape_add(YogEnv*, YogVal, ID);
+int_t YogShape_find(YogEnv*, YogVal, ID);
+YogVal YogShape_new(YogEnv*);
+
+/* PROTOTYPE_END */
+
+#endif
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
@@ -36,6 +36,11 @@ struct YogThread {
 
     YogHeap* heap;
     BOOL gc_bound;
+    /**
+     * Used by the heap profiler. See src/heap_profiler.c.
+     */
+    size_t bytes_to_sample;
+    struct YogHeapSample* heap_sample;
 
     struct YogJmpBuf* jmp_buf_list;
     YogVal jmp_val;
@@ -52,12 +57,23 @@ struct YogThread {
     uint_t finish_frames_num;
 #define FINISH_FRAMES_MAX 8
     YogVal finish_frames[FINISH_FRAMES_MAX];
+    /**
+     * Stack of script frames which returned. Calls take frames from here in
+     * LIFO order not to allocate a frame in the heap at every call.
+     */
     uint_t script_frames_num;
-#define SCRIPT_FRAMES_MAX 32
+#define SCRIPT_FRAMES_MAX 64
     YogVal script_frames[SCRIPT_FRAMES_MAX];
     uint_t c_frames_num;
 #define C_FRAMES_MAX 32
     YogVal c_frames[C_FRAMES_MAX];
+    /**
+     * Machine stacks of dead coroutines. See "Machine Stacks" in
+     * src/coroutine.c.
+     */
+    uint_t machine_stacks_num;
+#define MACHINE_STACKS_MAX 64
+    void* machine_stacks[MACHINE_STACKS_MAX];
 };
 
 typedef struct YogThread YogThread;
@@ -90,7 +106,7 @@ void YogThread_config_mark_sweep_compact(YogEnv*, YogVal, size_t);
 void YogThread_define_classes(YogEnv*, YogVal);
 YogVal YogThread_get_c_frame(YogEnv*, YogVal);
 YogVal YogThread_get_finish_frame(YogEnv*, YogVal);
-YogVal YogThread_get_script_frame(YogEnv*, YogVal);
+YogVal YogThread_get_script_frame(YogEnv*, YogVal, uint_t);
 void YogThread_init(YogEnv*, YogVal, YogVal);
 void YogThread_issue_object_id(YogEnv*, YogVal, YogVal);
 YogVal YogThread_new(YogEnv*);
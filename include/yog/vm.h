@@ -8,6 +8,8 @@
 #include "yog/gc.h"
 #include "yog/yog.h"
 
+#define BOOT_SCRIPTS_MAX    32
+
 struct YogVM {
     BOOL gc_stress;
 
@@ -105,13 +107,67 @@ struct YogVM {
     YogVal encAscii;
     YogVal encUtf8;
     YogVal default_encoding;
+    const char* default_encoding_name;
 
+    /**
+     * Well-known symbols are interned once at YogVM_boot. Operators and
+     * frequently called methods use these IDs not to allocate a String and
+     * not to take sym_lock in hot paths.
+     */
+    ID id_amp;
+    ID id_bar;
+    ID id_call;
+    ID id_caret;
+    ID id_each;
+    ID id_eq;
+    ID id_ge;
+    ID id_gt;
+    ID id_hash;
+    ID id_init;
+    ID id_le;
+    ID id_lshift;
+    ID id_lt;
+    ID id_match;
+    ID id_minus;
+    ID id_minus_self;
+    ID id_ne;
+    ID id_new;
+    ID id_percent;
+    ID id_plus;
+    ID id_plus_self;
+    ID id_rshift;
+    ID id_slash;
+    ID id_slash2;
     ID id_star;
     ID id_star2;
-    ID id_amp;
+    ID id_subscript;
+    ID id_subscript_assign;
+    ID id_tilda_self;
+    ID id_to_s;
+    ID id_ufo;
 
     YogVal finish_code;
 
+    /**
+     * The boot snapshot is compiled code of the builtin scripts (array.yog,
+     * string.yog and so on). It is read at YogVM_boot not to compile them at
+     * every start. boot_codes is valid only in YogVM_boot. See
+     * src/code_cache.c.
+     */
+    const char* boot_snapshot_path;
+    YogVal boot_codes;
+    uint_t boot_hashes[BOOT_SCRIPTS_MAX];
+    uint_t boot_scripts_num;
+    BOOL boot_snapshot_stale;
+
+    /**
+     * Bumped when a class which has subclasses or a module is changed. This
+     * invalidates all inline caches of load_attr at once.
+     */
+    uint_t attr_cache_serial;
+    YogVal root_shape;
+    uint_t shapes_num;
+
     YogVal main_thread;
     YogVal running_threads;
     uint_t next_thread_id;
@@ -119,7 +175,11 @@ struct YogVM {
 
     pthread_mutex_t global_interp_lock;
     BOOL running_gc;
-    BOOL waiting_suspend;
+    /**
+     * Threads poll waiting_suspend at safepoints without the lock. See
+     * YogGC_SAFEPOINT.
+     */
+    volatile BOOL waiting_suspend;
     uint_t suspend_counter;
     pthread_cond_t threads_suspend_cond;
     pthread_cond_t gc_finish_cond;
@@ -129,6 +189,28 @@ struct YogVM {
     uint_t gc_id;
     struct YogLocalsAnchor* locals;
     struct YogHandles* handles;
+    /**
+     * Number of threads marking objects in major GC. The mark-sweep-compact GC
+     * starts markers when gc_threads_num is more than one. See "Parallel
+     * Marking" in src/gc/mark-sweep-compact.c.
+     */
+    uint_t gc_threads_num;
+    struct YogMarkers* markers;
+    /**
+     * Living objects in all heaps as of their last sweeps. Markers are started
+     * only after this reaches PARALLEL_MARK_THRESHOLD.
+     */
+    uint_t live_objects_num;
+    /**
+     * Free arenas are unmapped when they exceed this percentage of living
+     * objects. See "Releasing Arenas" in src/gc/mark-sweep-compact.c.
+     */
+    uint_t heap_headroom;
+    YogGCStats gc_stats;
+    /**
+     * NULL unless --heap-profile is given. See src/heap_profiler.c.
+     */
+    struct YogHeapProfiler* heap_profiler;
 #if defined(GC_GENERATIONAL)
     /**
      * Generational GC needs kind of global variables. The following two
@@ -136,12 +218,22 @@ struct YogVM {
      */
     BOOL major_gc_flag;
     BOOL compaction_flag;
+    /**
+     * Young generations are resized so that a minor GC pauses threads for
+     * less than this (in microseconds).
+     */
+    uint_t gc_pause_target;
 #endif
 
     struct YogIndirectPointer* indirect_ptr;
     pthread_mutex_t indirect_ptr_lock;
 
     BOOL debug_import;
+    /**
+     * When this is TRUE, imported packages are compiled via foo.yogc next to
+     * foo.yog. See src/code_cache.c.
+     */
+    BOOL use_code_cache;
     YogVal path_separator;
 };
 
@@ -174,6 +266,8 @@ ID YogVM_intern(YogEnv*, YogVM*, const char*);
 ID YogVM_intern2(YogEnv*, YogVM*, YogVal);
 uint_t YogVM_issue_thread_id(YogEnv*, YogVM*);
 void YogVM_keep_children(YogEnv*, void*, ObjectKeeper, void*);
+void YogVM_keep_local_roots(YogEnv*, YogVM*, ObjectKeeper, YogHeap*);
+BOOL YogVM_lookup_name(YogEnv*, YogVM*, ID, YogVal*);
 void YogVM_register_args(YogEnv*, YogVM*, YogHandle*);
 void YogVM_register_executable(YogEnv*, YogVM*, YogHandle*);
 void YogVM_register_package(YogEnv*, YogVM*, YogHandle*, YogHandle*);
@@ -53,23 +53,11 @@ YogArray_size(YogEnv* env, YogVal array)
     return PTR_AS(YogArray, array)->size;
 }
 
-static void
-YogValArray_keep_children(YogEnv* env, void* ptr, ObjectKeeper keeper, void* heap)
-{
-    YogValArray* array = PTR_AS(YogValArray, ptr);
-
-    uint_t size = array->size;
-    uint_t i = 0;
-    for (i = 0; i < size; i++) {
-        YogGC_KEEP(env, array, items[i], keeper, heap);
-    }
-}
-
 YogVal
 YogValArray_new(YogEnv* env, uint_t size)
 {
     YogGC_check_multiply_overflow(env, size, sizeof(YogVal));
-    YogVal array = ALLOC_OBJ_ITEM(env, YogValArray_keep_children, NULL, YogValArray, size, YogVal);
+    YogVal array = ALLOC_OBJ_ITEM(env, YogGC_keep_slots, NULL, YogValArray, size, YogVal);
     PTR_AS(YogValArray, array)->size = size;
     uint_t i;
     for (i = 0; i < size; i++) {
@@ -21,6 +21,7 @@
 #include "yog/ffi.h"
 #include "yog/file.h"
 #include "yog/frame.h"
+#include "yog/gc.h"
 #include "yog/get_args.h"
 #include "yog/misc.h"
 #include "yog/module.h"
@@ -46,7 +47,7 @@ raise_exception(YogEnv* env, YogVal self, YogVal pkg, YogVal args, YogVal kw, Yo
     YogGetArgs_parse_args(env, "raise_exception", params, args, kw);
 
     if (!YogVal_is_subclass_of(env, exc, env->vm->eException)) {
-        exc = YogEval_call_method1(env, env->vm->eException, "new", exc);
+        exc = YogEval_call_method_id1(env, env->vm->eException, env->vm->id_new, exc);
     }
 
     YogEval_pop_frame(env);
@@ -183,13 +184,84 @@ static YogVal
 major_gc(YogEnv* env, YogHandle* self, YogHandle* pkg)
 {
 #if defined(GC_GENERATIONAL)
-    YogGC_perform_minor(env);
+    YogGC_perform_major(env);
     return YNIL;
 #else
     return minor_gc(env, self, pkg);
 #endif
 }
 
+static void
+set_stat(YogEnv* env, YogHandle* dict, const char* name, YogVal val)
+{
+    YogHandle* h = VAL2HDL(env, val);
+    ID id = YogVM_intern(env, env->vm, name);
+    YogDict_set(env, HDL2VAL(dict), ID2VAL(id), HDL2VAL(h));
+}
+
+static YogVal
+times2dict(YogEnv* env, YogGCTimes* times)
+{
+    YogHandle* dict = VAL2HDL(env, YogDict_new(env));
+    set_stat(env, dict, "num", YogVal_from_unsigned_int(env, times->num));
+    set_stat(env, dict, "total", YogVal_from_unsigned_long_long(env, times->total));
+    set_stat(env, dict, "max", YogVal_from_unsigned_long_long(env, times->max));
+
+    YogHandle* histogram = VAL2HDL(env, YogArray_new(env));
+    uint_t i;
+    for (i = 0; i < YogGC_HISTOGRAM_SIZE; i++) {
+        YogVal n = YogVal_from_unsigned_int(env, times->histogram[i]);
+        YogArray_push(env, HDL2VAL(histogram), n);
+    }
+    set_stat(env, dict, "histogram", HDL2VAL(histogram));
+
+    return HDL2VAL(dict);
+}
+
+static YogVal
+threads_stats(YogEnv* env)
+{
+    uint_t num = YogGC_get_threads_stats(env, NULL, NULL, 0);
+    uint_t* ids = (uint_t*)YogSysdeps_alloca(sizeof(uint_t) * num);
+    uint64_t* sizes = (uint64_t*)YogSysdeps_alloca(sizeof(uint64_t) * num);
+    uint_t n = YogGC_get_threads_stats(env, ids, sizes, num);
+
+    YogHandle* dict = VAL2HDL(env, YogDict_new(env));
+    uint_t i;
+    for (i = 0; (i < n) && (i < num); i++) {
+        YogHandle* size = VAL2HDL(env, YogVal_from_unsigned_long_long(env, sizes[i]));
+        YogVal id = YogVal_from_unsigned_int(env, ids[i]);
+        YogDict_set(env, HDL2VAL(dict), id, HDL2VAL(size));
+    }
+    return HDL2VAL(dict);
+}
+
+static YogVal
+gc_stats(YogEnv* env, YogHandle* self, YogHandle* pkg)
+{
+    YogGCStats stats;
+    size_t heap_size = YogGC_get_stats(env, &stats);
+
+    YogHandle* dict = VAL2HDL(env, YogDict_new(env));
+    set_stat(env, dict, "minor_gc", times2dict(env, &stats.minor_gc));
+    set_stat(env, dict, "major_gc", times2dict(env, &stats.major_gc));
+    set_stat(env, dict, "time_to_safepoint", times2dict(env, &stats.time_to_safepoint));
+#define SET_INT(name)   do { \
+    set_stat(env, dict, #name, YogVal_from_unsigned_long_long(env, stats.name)); \
+} while (0)
+    SET_INT(local_gc_num);
+    SET_INT(parallel_mark_num);
+    SET_INT(allocated_size);
+    SET_INT(promoted_size);
+    SET_INT(remembered_set_size);
+    SET_INT(max_remembered_set_size);
+#undef SET_INT
+    set_stat(env, dict, "heap_size", YogVal_from_unsigned_long_long(env, heap_size));
+    set_stat(env, dict, "threads", threads_stats(env));
+
+    return HDL2VAL(dict);
+}
+
 static YogVal
 print(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* args)
 {
@@ -348,6 +420,15 @@ create_stdio(YogEnv* env, FILE* fp)
     return file;
 }
 
+/**
+ * Defines functions of the gc package, which tells statistics of GC.
+ */
+void
+YogBuiltins_boot_gc(YogEnv* env, YogHandle* pkg)
+{
+    YogPackage_define_function2(env, pkg, "stats", gc_stats, NULL);
+}
+
 void
 YogBuiltins_boot(YogEnv* env, YogHandle* builtins)
 {
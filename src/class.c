@@ -182,10 +182,30 @@ YogClass_init(YogEnv* env, YogVal self, type_t type, YogVal klass)
     PTR_AS(YogClass, self)->exec_set_descr = NULL;
     PTR_AS(YogClass, self)->call = NULL;
     PTR_AS(YogClass, self)->exec = NULL;
+    PTR_AS(YogClass, self)->version = 0;
+    PTR_AS(YogClass, self)->has_subclass = FALSE;
 
     RETURN_VOID(env);
 }
 
+void
+YogClass_set_super(YogEnv* env, YogVal self, YogVal super)
+{
+    YogGC_UPDATE_PTR(env, PTR_AS(YogClass, self), super, super);
+    if (IS_PTR(super) && ((BASIC_OBJ_FLAGS(super) & FLAG_CLASS) != 0)) {
+        PTR_AS(YogClass, super)->has_subclass = TRUE;
+    }
+}
+
+void
+YogClass_invalidate_attr_caches(YogEnv* env, YogVal self)
+{
+    PTR_AS(YogClass, self)->version++;
+    if (PTR_AS(YogClass, self)->has_subclass) {
+        env->vm->attr_cache_serial++;
+    }
+}
+
 YogVal
 YogClass_alloc(YogEnv* env, YogVal klass)
 {
@@ -207,7 +227,7 @@ YogClass_new(YogEnv* env, const char* name, YogVal super)
     PUSH_LOCAL(env, obj);
 
     obj = YogClass_alloc(env, env->vm->cClass);
-    YogGC_UPDATE_PTR(env, PTR_AS(YogClass, obj), super, super);
+    YogClass_set_super(env, obj, super);
     ID id = name == NULL ? INVALID_ID : YogVM_intern(env, env->vm, name);
     PTR_AS(YogClass, obj)->name = id;
 
@@ -243,10 +263,10 @@ new_(YogEnv* env, YogVal self, YogVal pkg, YogVal args, YogVal kw, YogVal block)
     }
     PUSH_LOCALSX(env, argc, arg);
     if (IS_PTR(block)) {
-        YogEval_call_method2(env, obj, "init", argc, arg, block);
+        YogEval_call_method_id2(env, obj, env->vm->id_init, argc, arg, block);
     }
     else {
-        YogEval_call_method(env, obj, "init", argc, arg);
+        YogEval_call_method_id(env, obj, env->vm->id_init, argc, arg);
     }
 
     RETURN(env, obj);
@@ -450,6 +470,7 @@ YogClass_include_module(YogEnv* env, YogVal self, YogVal module)
     YogGC_UPDATE_PTR(env, PTR_AS(YogObj, module_class), attrs, PTR_AS(YogObj, module)->attrs);
     YogGC_UPDATE_PTR(env, PTR_AS(ModuleClass, module_class), super, PTR_AS(YogClass, self)->super);
     YogGC_UPDATE_PTR(env, PTR_AS(YogClass, self), super, module_class);
+    YogClass_invalidate_attr_caches(env, self);
 
     RETURN_VOID(env);
 }
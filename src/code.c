@@ -9,6 +9,7 @@
 #include "yog/inst.h"
 #include "yog/object.h"
 #include "yog/opcodes.h"
+#include "yog/shape.h"
 #include "yog/string.h"
 #include "yog/vm.h"
 #include "yog/yog.h"
@@ -143,6 +144,13 @@ YogCode_dump(YogEnv* env, YogVal code)
                 printf(" %d", index);
             }
             break;
+        case OP(LOAD_LOCAL_INDEX2):
+            {
+                uint8_t index1 = OPERAND(uint8_t, 0);
+                uint8_t index2 = OPERAND(uint8_t, 1);
+                printf(" %d %d", index1, index2);
+            }
+            break;
         case OP(STORE_NONLOCAL_NAME):
         case OP(LOAD_NONLOCAL_NAME):
             {
@@ -170,6 +178,16 @@ YogCode_dump(YogEnv* env, YogVal code)
                 printf(")");
             }
             break;
+        case OP(ADD_CONST_INT):
+            {
+                uint_t index = OPERAND(uint_t, 0);
+                printf(" %zd (", index);
+                YogVal consts = PTR_AS(YogCode, code)->consts;
+                YogVal c = PTR_AS(YogValArray, consts)->items[index];
+                print_val(env, c);
+                printf(")");
+            }
+            break;
         case OP(CALL_FUNCTION):
             {
                 uint_t offset = 0;
@@ -199,6 +217,7 @@ YogCode_dump(YogEnv* env, YogVal code)
         case OP(JUMP_IF_TRUE):
         case OP(JUMP_IF_FALSE):
         case OP(JUMP):
+        case OP(LESS_JUMP_IF_FALSE):
             {
                 uint_t to = OPERAND(uint_t, 0);
                 printf(" %zd", to);
@@ -227,7 +246,11 @@ keep_children(YogEnv* env, void* ptr, ObjectKeeper keeper, void* heap)
     YogGC_KEEP(env, code, arg_info, keeper, heap);
 
 #define KEEP_MEMBER(member)     do { \
-    code->member = PTR_AS(ID, (*keeper)(env, (void*)code->member, heap)); \
+    ID* ids = PTR_AS(ID, (*keeper)(env, (void*)code->member, heap)); \
+    if (ids == NULL) { \
+        break; \
+    } \
+    YogGC_UPDATE_PTR(env, code, member, ids); \
 } while (0)
     KEEP_MEMBER(local_vars_names);
 #undef KEEP_MEMBER
@@ -238,7 +261,131 @@ keep_children(YogEnv* env, void* ptr, ObjectKeeper keeper, void* heap)
     KEEP(consts);
     KEEP(exc_tbl);
     KEEP(filename);
+    KEEP(attr_caches);
+#undef KEEP
+}
+
+static void
+keep_attr_caches_children(YogEnv* env, void* ptr, ObjectKeeper keeper, void* heap)
+{
+    YogAttrCacheArray* array = PTR_AS(YogAttrCacheArray, ptr);
+    uint_t size = array->size;
+    uint_t i;
+    for (i = 0; i < size; i++) {
+        uint_t j;
+        for (j = 0; j < ATTR_CACHE_WAYS; j++) {
+#define KEEP(member) \
+    YogGC_KEEP(env, array, items[i].entries[j].member, keeper, heap)
+            KEEP(klass);
+            KEEP(attr);
+            KEEP(defining_class);
 #undef KEEP
+        }
+        YogGC_KEEP(env, array, items[i].shape, keeper, heap);
+    }
+}
+
+YogVal
+YogCode_alloc_attr_caches(YogEnv* env, uint_t size)
+{
+    YogVal array = ALLOC_OBJ_ITEM(env, keep_attr_caches_children, NULL, YogAttrCacheArray, size, YogAttrCache);
+    PTR_AS(YogAttrCacheArray, array)->size = size;
+    uint_t i;
+    for (i = 0; i < size; i++) {
+        uint_t j;
+        for (j = 0; j < ATTR_CACHE_WAYS; j++) {
+            YogAttrCacheEntry* entry = &PTR_AS(YogAttrCacheArray, array)->items[i].entries[j];
+            entry->klass = YUNDEF;
+            entry->version = 0;
+            entry->serial = 0;
+            entry->attr = YUNDEF;
+            entry->defining_class = YUNDEF;
+        }
+        PTR_AS(YogAttrCacheArray, array)->items[i].shape = YUNDEF;
+        PTR_AS(YogAttrCacheArray, array)->items[i].slot = -1;
+    }
+
+    return array;
+}
+
+int_t
+YogCode_find_slot(YogEnv* env, YogVal self, uint_t index, YogVal shape, ID name)
+{
+    YogVal caches = PTR_AS(YogCode, self)->attr_caches;
+    YogAttrCache* cache = &PTR_AS(YogAttrCacheArray, caches)->items[index];
+    if (VAL2PTR(cache->shape) == VAL2PTR(shape)) {
+        return cache->slot;
+    }
+
+    int_t slot = YogShape_find(env, shape, name);
+    cache->shape = YUNDEF;
+    cache->slot = slot;
+    YogGC_UPDATE_PTR(env, PTR_AS(YogAttrCacheArray, caches), items[index].shape, shape);
+
+    return slot;
+}
+
+YogVal
+YogCode_lookup_attr_cache(YogEnv* env, YogVal self, uint_t index, YogVal klass, YogVal* defining_class)
+{
+    YogVal caches = PTR_AS(YogCode, self)->attr_caches;
+    YogAttrCache* cache = &PTR_AS(YogAttrCacheArray, caches)->items[index];
+    uint_t version = PTR_AS(YogClass, klass)->version;
+    uint_t serial = env->vm->attr_cache_serial;
+    uint_t i;
+    for (i = 0; i < ATTR_CACHE_WAYS; i++) {
+        YogAttrCacheEntry* entry = &cache->entries[i];
+        if (VAL2PTR(entry->klass) != VAL2PTR(klass)) {
+            continue;
+        }
+        if ((entry->version != version) || (entry->serial != serial)) {
+            return YUNDEF;
+        }
+        if (defining_class != NULL) {
+            *defining_class = entry->defining_class;
+        }
+        return entry->attr;
+    }
+
+    return YUNDEF;
+}
+
+void
+YogCode_update_attr_cache(YogEnv* env, YogVal self, uint_t index, YogVal klass, YogVal attr, YogVal defining_class)
+{
+    YogVal caches = PTR_AS(YogCode, self)->attr_caches;
+    YogAttrCache* cache = &PTR_AS(YogAttrCacheArray, caches)->items[index];
+
+    /**
+     * An entry of the receiver's class is overwritten. Otherwise the oldest
+     * entry is dropped, and the new one is stored in the first way, which is
+     * checked at first.
+     */
+    uint_t n = ATTR_CACHE_WAYS - 1;
+    uint_t i;
+    for (i = 0; i < ATTR_CACHE_WAYS - 1; i++) {
+        if (VAL2PTR(cache->entries[i].klass) == VAL2PTR(klass)) {
+            n = i;
+            break;
+        }
+    }
+    for (i = n; 0 < i; i--) {
+        YogAttrCacheEntry* dest = &cache->entries[i];
+        YogAttrCacheEntry* src = &cache->entries[i - 1];
+        YogGC_UPDATE_PTR(env, PTR_AS(YogAttrCacheArray, caches), items[index].entries[i].klass, src->klass);
+        dest->version = src->version;
+        dest->serial = src->serial;
+        YogGC_UPDATE_PTR(env, PTR_AS(YogAttrCacheArray, caches), items[index].entries[i].attr, src->attr);
+        YogGC_UPDATE_PTR(env, PTR_AS(YogAttrCacheArray, caches), items[index].entries[i].defining_class, src->defining_class);
+    }
+
+    YogAttrCacheEntry* entry = &cache->entries[0];
+    entry->klass = YUNDEF;
+    entry->version = PTR_AS(YogClass, klass)->version;
+    entry->serial = env->vm->attr_cache_serial;
+    YogGC_UPDATE_PTR(env, PTR_AS(YogAttrCacheArray, caches), items[index].entries[0].attr, attr);
+    YogGC_UPDATE_PTR(env, PTR_AS(YogAttrCacheArray, caches), items[index].entries[0].defining_class, defining_class);
+    YogGC_UPDATE_PTR(env, PTR_AS(YogAttrCacheArray, caches), items[index].entries[0].klass, klass);
 }
 
 static void
@@ -296,6 +443,7 @@ YogCode_new(YogEnv* env)
     CODE(code)->filename = YUNDEF;
     CODE(code)->class_name = INVALID_ID;
     CODE(code)->func_name = INVALID_ID;
+    CODE(code)->attr_caches = YUNDEF;
 
     RETURN(env, code);
 }
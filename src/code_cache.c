@@ -0,0 +1,1047 @@
+#include "yog/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#if defined(YOG_HAVE_UNISTD_H)
+#   include <unistd.h>
+#endif
+#include "yog/arg.h"
+#include "yog/array.h"
+#include "yog/bignum.h"
+#include "yog/binary.h"
+#include "yog/code.h"
+#include "yog/code_cache.h"
+#include "yog/compile.h"
+#include "yog/error.h"
+#include "yog/float.h"
+#include "yog/gc.h"
+#include "yog/handle.h"
+#include "yog/inst.h"
+#include "yog/opcodes.h"
+#include "yog/parser.h"
+#include "yog/regexp.h"
+#include "yog/string.h"
+#include "yog/sysdeps.h"
+#include "yog/vm.h"
+#include "yog/yog.h"
+
+/**
+ * A cache file is a Header followed by a serialized package code. Values are
+ * written in the native byte order and word size, so a cache file is not
+ * portable. layout rejects files written by builds of other word sizes.
+ *
+ * Strings are kept as decoded YogChars. A source without a coding comment is
+ * decoded in the default encoding, which comes from LANG, so a cache is used
+ * only in the same default encoding as the one it was written in.
+ */
+#define CACHE_MAGIC     "YOGC"
+#define BOOT_MAGIC      "YOGB"
+#define CACHE_VERSION   2
+
+#define CACHE_LAYOUT    (sizeof(uint_t) | (sizeof(ID) << 8) \
+                        | (sizeof(pc_t) << 16) | (sizeof(YogChar) << 24))
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t opcodes_digest;
+    uint32_t layout;
+    uint64_t source_mtime;
+    uint64_t source_size;
+    uint64_t cached_at;
+    uint32_t source_hash;
+    uint32_t padding;
+    char source_encoding[16];
+};
+
+typedef struct Header Header;
+
+/* Tags of constants */
+#define TAG_NIL         'n'
+#define TAG_TRUE        't'
+#define TAG_FALSE       'f'
+#define TAG_UNDEF       'u'
+#define TAG_FIXNUM      'i'
+#define TAG_FLOAT       'd'
+#define TAG_BIGNUM      'b'
+#define TAG_STRING      's'
+#define TAG_FILENAME    'F'
+#define TAG_SYMBOL      'y'
+#define TAG_CODE        'c'
+#define TAG_OBJECT      'O'
+#define TAG_REGEXP      'r'
+
+#define NO_NAME         ((uint_t)-1)
+
+struct Writer {
+    char* buf;
+    uint_t size;
+    uint_t capacity;
+};
+
+typedef struct Writer Writer;
+
+struct Reader {
+    const char* pc;
+    const char* end;
+    BOOL error;
+};
+
+typedef struct Reader Reader;
+
+static void
+write_bytes(YogEnv* env, Writer* w, const void* p, uint_t size)
+{
+    if (w->capacity < w->size + size) {
+        uint_t capacity = 2 * (w->size + size);
+        char* buf = (char*)realloc(w->buf, capacity);
+        YOG_ASSERT(env, buf != NULL, "Can't realloc");
+        w->buf = buf;
+        w->capacity = capacity;
+    }
+    memcpy(w->buf + w->size, p, size);
+    w->size += size;
+}
+
+static void
+write_uint(YogEnv* env, Writer* w, uint_t n)
+{
+    write_bytes(env, w, &n, sizeof(n));
+}
+
+static void
+write_tag(YogEnv* env, Writer* w, char tag)
+{
+    write_bytes(env, w, &tag, sizeof(tag));
+}
+
+static void
+write_chars(YogEnv* env, Writer* w, YogVal s)
+{
+    uint_t size = STRING_SIZE(s);
+    write_uint(env, w, size);
+    if (size == 0) {
+        return;
+    }
+    write_bytes(env, w, STRING_CHARS(s), sizeof(YogChar) * size);
+}
+
+/**
+ * IDs are written as their names because they are different in each process.
+ * Returns FALSE for an ID which has no name. The code is not cached then.
+ */
+static BOOL
+write_id(YogEnv* env, Writer* w, ID id)
+{
+    if (id == INVALID_ID) {
+        write_uint(env, w, NO_NAME);
+        return TRUE;
+    }
+    SAVE_LOCALS(env);
+    YogVal name = YUNDEF;
+    PUSH_LOCAL(env, name);
+    if (!YogVM_lookup_name(env, env->vm, id, &name)) {
+        RETURN(env, FALSE);
+    }
+    write_chars(env, w, name);
+    RETURN(env, TRUE);
+}
+
+static BOOL
+write_ids(YogEnv* env, Writer* w, YogVal ids, uint_t size)
+{
+    SAVE_ARG(env, ids);
+
+    uint_t i;
+    for (i = 0; i < size; i++) {
+        if (!write_id(env, w, PTR_AS(ID, ids)[i])) {
+            RETURN(env, FALSE);
+        }
+    }
+
+    RETURN(env, TRUE);
+}
+
+static BOOL write_code(YogEnv*, Writer*, YogVal);
+
+static BOOL
+write_const(YogEnv* env, Writer* w, YogVal val)
+{
+    SAVE_ARG(env, val);
+    YogVal klass = YUNDEF;
+    YogVal s = YUNDEF;
+    PUSH_LOCALS2(env, klass, s);
+
+    if (IS_NIL(val)) {
+        write_tag(env, w, TAG_NIL);
+        RETURN(env, TRUE);
+    }
+    if (IS_BOOL(val)) {
+        write_tag(env, w, VAL2BOOL(val) ? TAG_TRUE : TAG_FALSE);
+        RETURN(env, TRUE);
+    }
+    if (IS_UNDEF(val)) {
+        write_tag(env, w, TAG_UNDEF);
+        RETURN(env, TRUE);
+    }
+    if (IS_FIXNUM(val)) {
+        write_tag(env, w, TAG_FIXNUM);
+        int_t n = VAL2INT(val);
+        write_bytes(env, w, &n, sizeof(n));
+        RETURN(env, TRUE);
+    }
+    if (IS_SYMBOL(val)) {
+        write_tag(env, w, TAG_SYMBOL);
+        RETURN(env, write_id(env, w, VAL2ID(val)));
+    }
+    if (!IS_PTR(val)) {
+        RETURN(env, FALSE);
+    }
+
+    YogVM* vm = env->vm;
+    if (VAL2PTR(val) == VAL2PTR(vm->cObject)) {
+        write_tag(env, w, TAG_OBJECT);
+        RETURN(env, TRUE);
+    }
+    klass = YogVal_get_class(env, val);
+    if (VAL2PTR(klass) == VAL2PTR(vm->cString)) {
+        write_tag(env, w, TAG_STRING);
+        write_chars(env, w, val);
+        RETURN(env, TRUE);
+    }
+    if (VAL2PTR(klass) == VAL2PTR(vm->cPath)) {
+        /**
+         * A Path in constants comes only from __FILE__. It is replaced with
+         * the name of the source when the cache is loaded.
+         */
+        write_tag(env, w, TAG_FILENAME);
+        RETURN(env, TRUE);
+    }
+    if (VAL2PTR(klass) == VAL2PTR(vm->cFloat)) {
+        write_tag(env, w, TAG_FLOAT);
+        double f = FLOAT_NUM(val);
+        write_bytes(env, w, &f, sizeof(f));
+        RETURN(env, TRUE);
+    }
+    if (VAL2PTR(klass) == VAL2PTR(vm->cBignum)) {
+        s = YogBignum_to_s(env, val);
+        write_tag(env, w, TAG_BIGNUM);
+        write_chars(env, w, s);
+        RETURN(env, TRUE);
+    }
+    if (VAL2PTR(klass) == VAL2PTR(vm->cCode)) {
+        write_tag(env, w, TAG_CODE);
+        RETURN(env, write_code(env, w, val));
+    }
+    if (VAL2PTR(klass) == VAL2PTR(vm->cRegexp)) {
+        write_tag(env, w, TAG_REGEXP);
+        write_chars(env, w, PTR_AS(YogRegexp, val)->pattern);
+        write_uint(env, w, PTR_AS(YogRegexp, val)->ignore_case);
+        RETURN(env, TRUE);
+    }
+
+    RETURN(env, FALSE);
+}
+
+static BOOL
+write_id_operands(YogEnv* env, Writer* w, YogVal code)
+{
+    SAVE_ARG(env, code);
+
+    uint_t size = YogByteArray_size(env, CODE(code)->insts);
+    pc_t pc = 0;
+    while (pc < size) {
+        uint8_t* insts = (uint8_t*)PTR_AS(YogByteArray, CODE(code)->insts)->items;
+        OpCode op = (OpCode)insts[pc];
+        uint_t offset = Yog_get_inst_id_offset(op);
+        if (0 < offset) {
+            ID id;
+            memcpy(&id, &insts[pc + offset], sizeof(id));
+            if (!write_id(env, w, id)) {
+                RETURN(env, FALSE);
+            }
+        }
+        pc += Yog_get_inst_size(op);
+    }
+
+    RETURN(env, TRUE);
+}
+
+static BOOL
+write_code(YogEnv* env, Writer* w, YogVal code)
+{
+    SAVE_ARG(env, code);
+    YogVal consts = YUNDEF;
+    YogVal val = YUNDEF;
+    YogVal arg_info = YUNDEF;
+    PUSH_LOCALS3(env, consts, val, arg_info);
+
+    write_uint(env, w, CODE(code)->stack_size);
+    write_uint(env, w, CODE(code)->outer_size);
+    uint_t local_vars_count = CODE(code)->local_vars_count;
+    write_uint(env, w, local_vars_count);
+    if (0 < local_vars_count) {
+        val = PTR2VAL(CODE(code)->local_vars_names);
+        if (!write_ids(env, w, val, local_vars_count)) {
+            RETURN(env, FALSE);
+        }
+    }
+
+    consts = CODE(code)->consts;
+    uint_t consts_size = IS_PTR(consts) ? YogValArray_size(env, consts) : 0;
+    write_uint(env, w, consts_size);
+    uint_t i;
+    for (i = 0; i < consts_size; i++) {
+        val = YogValArray_at(env, consts, i);
+        if (!write_const(env, w, val)) {
+            RETURN(env, FALSE);
+        }
+    }
+
+    val = CODE(code)->insts;
+    uint_t insts_size = YogByteArray_size(env, val);
+    write_uint(env, w, insts_size);
+    write_bytes(env, w, PTR_AS(YogByteArray, val)->items, insts_size);
+    if (!write_id_operands(env, w, code)) {
+        RETURN(env, FALSE);
+    }
+
+    uint_t exc_tbl_size = CODE(code)->exc_tbl_size;
+    write_uint(env, w, exc_tbl_size);
+    if (0 < exc_tbl_size) {
+        YogExceptionTable* exc_tbl = PTR_AS(YogExceptionTable, CODE(code)->exc_tbl);
+        write_bytes(env, w, exc_tbl->items, sizeof(YogExceptionTableEntry) * exc_tbl_size);
+    }
+    uint_t lineno_tbl_size = CODE(code)->lineno_tbl_size;
+    write_uint(env, w, lineno_tbl_size);
+    if (0 < lineno_tbl_size) {
+        YogLinenoTableEntry* lineno_tbl = PTR_AS(YogLinenoTableEntry, CODE(code)->lineno_tbl);
+        write_bytes(env, w, lineno_tbl, sizeof(YogLinenoTableEntry) * lineno_tbl_size);
+    }
+
+    if (!write_id(env, w, CODE(code)->class_name)) {
+        RETURN(env, FALSE);
+    }
+    if (!write_id(env, w, CODE(code)->func_name)) {
+        RETURN(env, FALSE);
+    }
+
+    arg_info = CODE(code)->arg_info;
+    write_uint(env, w, IS_PTR(arg_info) ? 1 : 0);
+    if (IS_PTR(arg_info)) {
+        write_uint(env, w, ARG_INFO(arg_info)->argc);
+        write_uint(env, w, ARG_INFO(arg_info)->varargc);
+        write_uint(env, w, ARG_INFO(arg_info)->kwargc);
+        write_uint(env, w, ARG_INFO(arg_info)->blockargc);
+        write_uint(env, w, ARG_INFO(arg_info)->required_argc);
+        if (!write_ids(env, w, ARG_INFO(arg_info)->argnames, ARG_INFO(arg_info)->argc)) {
+            RETURN(env, FALSE);
+        }
+    }
+
+    val = CODE(code)->attr_caches;
+    write_uint(env, w, IS_PTR(val) ? PTR_AS(YogAttrCacheArray, val)->size : 0);
+
+    RETURN(env, TRUE);
+}
+
+static void
+read_bytes(Reader* r, void* p, uint_t size)
+{
+    if ((uint_t)(r->end - r->pc) < size) {
+        r->error = TRUE;
+        memset(p, 0, size);
+        return;
+    }
+    memcpy(p, r->pc, size);
+    r->pc += size;
+}
+
+static uint_t
+read_uint(Reader* r)
+{
+    uint_t n;
+    read_bytes(r, &n, sizeof(n));
+    return n;
+}
+
+/**
+ * Checks that the rest of the file has size items at least. This keeps a
+ * broken file from making a huge allocation.
+ */
+static BOOL
+check_size(Reader* r, uint_t size, uint_t item_size)
+{
+    if ((uint_t)(r->end - r->pc) / item_size < size) {
+        r->error = TRUE;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static YogVal
+read_chars(YogEnv* env, Reader* r, uint_t size)
+{
+    if (!check_size(r, size, sizeof(YogChar))) {
+        return YUNDEF;
+    }
+    if (size == 0) {
+        return YogString_new(env);
+    }
+    YogVal s = YogString_of_size(env, size);
+    read_bytes(r, STRING_CHARS(s), sizeof(YogChar) * size);
+    STRING_SIZE(s) = size;
+    return s;
+}
+
+static ID
+read_id(YogEnv* env, Reader* r)
+{
+    uint_t size = read_uint(r);
+    if (size == NO_NAME) {
+        return INVALID_ID;
+    }
+    YogVal s = read_chars(env, r, size);
+    if (r->error) {
+        return INVALID_ID;
+    }
+    return YogVM_intern2(env, env->vm, s);
+}
+
+static YogVal
+read_ids(YogEnv* env, Reader* r, uint_t size)
+{
+    if (!check_size(r, size, sizeof(uint_t))) {
+        return YUNDEF;
+    }
+    SAVE_LOCALS(env);
+    YogVal ids = YUNDEF;
+    PUSH_LOCAL(env, ids);
+
+    ids = ALLOC_OBJ_SIZE(env, NULL, NULL, sizeof(ID) * size);
+    uint_t i;
+    for (i = 0; i < size; i++) {
+        ID id = read_id(env, r);
+        PTR_AS(ID, ids)[i] = id;
+    }
+
+    RETURN(env, ids);
+}
+
+static YogVal read_code(YogEnv*, Reader*, YogHandle*);
+
+static YogVal
+read_const(YogEnv* env, Reader* r, YogHandle* filename)
+{
+    char tag;
+    read_bytes(r, &tag, sizeof(tag));
+    if (r->error) {
+        return YUNDEF;
+    }
+
+    switch (tag) {
+    case TAG_NIL:
+        return YNIL;
+    case TAG_TRUE:
+        return YTRUE;
+    case TAG_FALSE:
+        return YFALSE;
+    case TAG_UNDEF:
+        return YUNDEF;
+    case TAG_FIXNUM:
+        {
+            int_t n;
+            read_bytes(r, &n, sizeof(n));
+            return INT2VAL(n);
+        }
+    case TAG_FLOAT:
+        {
+            double f;
+            read_bytes(r, &f, sizeof(f));
+            return YogFloat_from_float(env, f);
+        }
+    case TAG_BIGNUM:
+        {
+            YogVal s = read_chars(env, r, read_uint(r));
+            if (r->error) {
+                return YUNDEF;
+            }
+            return YogBignum_from_str(env, s, 10);
+        }
+    case TAG_STRING:
+        return read_chars(env, r, read_uint(r));
+    case TAG_FILENAME:
+        return HDL2VAL(filename);
+    case TAG_SYMBOL:
+        return ID2VAL(read_id(env, r));
+    case TAG_CODE:
+        return read_code(env, r, filename);
+    case TAG_OBJECT:
+        return env->vm->cObject;
+    case TAG_REGEXP:
+        {
+            YogVal pattern = read_chars(env, r, read_uint(r));
+            BOOL ignore_case = read_uint(r);
+            if (r->error) {
+                return YUNDEF;
+            }
+            return YogRegexp_new(env, pattern, ignore_case);
+        }
+    default:
+        r->error = TRUE;
+        return YUNDEF;
+    }
+}
+
+static void
+read_id_operands(YogEnv* env, Reader* r, YogVal code)
+{
+    SAVE_ARG(env, code);
+
+    uint_t size = YogByteArray_size(env, CODE(code)->insts);
+    pc_t pc = 0;
+    while (pc < size) {
+        uint8_t* insts = (uint8_t*)PTR_AS(YogByteArray, CODE(code)->insts)->items;
+        OpCode op = (OpCode)insts[pc];
+        if ((OPCODES_NUM <= op) || (size - pc < Yog_get_inst_size(op))) {
+            r->error = TRUE;
+            RETURN_VOID(env);
+        }
+        uint_t offset = Yog_get_inst_id_offset(op);
+        if (0 < offset) {
+            ID id = read_id(env, r);
+            insts = (uint8_t*)PTR_AS(YogByteArray, CODE(code)->insts)->items;
+            memcpy(&insts[pc + offset], &id, sizeof(id));
+        }
+        pc += Yog_get_inst_size(op);
+    }
+
+    RETURN_VOID(env);
+}
+
+static YogVal
+read_code(YogEnv* env, Reader* r, YogHandle* filename)
+{
+    SAVE_LOCALS(env);
+    YogVal code = YUNDEF;
+    YogVal obj = YUNDEF;
+    YogVal val = YUNDEF;
+    YogVal arg_info = YUNDEF;
+    PUSH_LOCALS4(env, code, obj, val, arg_info);
+
+    code = YogCode_new(env);
+    CODE(code)->stack_size = read_uint(r);
+    CODE(code)->outer_size = read_uint(r);
+    uint_t local_vars_count = read_uint(r);
+    obj = read_ids(env, r, local_vars_count);
+    if (r->error) {
+        RETURN(env, YUNDEF);
+    }
+    CODE(code)->local_vars_count = local_vars_count;
+    YogGC_UPDATE_PTR(env, CODE(code), local_vars_names, PTR_AS(ID, obj));
+
+    uint_t consts_size = read_uint(r);
+    if (!check_size(r, consts_size, sizeof(char))) {
+        RETURN(env, YUNDEF);
+    }
+    if (0 < consts_size) {
+        obj = YogValArray_new(env, consts_size);
+        uint_t i;
+        for (i = 0; i < consts_size; i++) {
+            val = read_const(env, r, filename);
+            if (r->error) {
+                RETURN(env, YUNDEF);
+            }
+            YogGC_UPDATE_PTR(env, PTR_AS(YogValArray, obj), items[i], val);
+        }
+        YogGC_UPDATE_PTR(env, CODE(code), consts, obj);
+    }
+    else {
+        CODE(code)->consts = YNIL;
+    }
+
+    uint_t insts_size = read_uint(r);
+    if (!check_size(r, insts_size, sizeof(uint8_t))) {
+        RETURN(env, YUNDEF);
+    }
+    obj = YogByteArray_new(env, insts_size);
+    read_bytes(r, PTR_AS(YogByteArray, obj)->items, insts_size);
+    YogGC_UPDATE_PTR(env, CODE(code), insts, obj);
+    read_id_operands(env, r, code);
+
+    uint_t exc_tbl_size = read_uint(r);
+    if (!check_size(r, exc_tbl_size, sizeof(YogExceptionTableEntry))) {
+        RETURN(env, YUNDEF);
+    }
+    if (0 < exc_tbl_size) {
+        obj = ALLOC_OBJ_ITEM(env, NULL, NULL, YogExceptionTable, exc_tbl_size, YogExceptionTableEntry);
+        read_bytes(r, PTR_AS(YogExceptionTable, obj)->items, sizeof(YogExceptionTableEntry) * exc_tbl_size);
+        YogGC_UPDATE_PTR(env, CODE(code), exc_tbl, obj);
+    }
+    else {
+        CODE(code)->exc_tbl = YNIL;
+    }
+    CODE(code)->exc_tbl_size = exc_tbl_size;
+
+    uint_t lineno_tbl_size = read_uint(r);
+    if (!check_size(r, lineno_tbl_size, sizeof(YogLinenoTableEntry))) {
+        RETURN(env, YUNDEF);
+    }
+    obj = ALLOC_OBJ_SIZE(env, NULL, NULL, sizeof(YogLinenoTableEntry) * lineno_tbl_size);
+    read_bytes(r, PTR_AS(YogLinenoTableEntry, obj), sizeof(YogLinenoTableEntry) * lineno_tbl_size);
+    YogGC_UPDATE_PTR(env, CODE(code), lineno_tbl, obj);
+    CODE(code)->lineno_tbl_size = lineno_tbl_size;
+
+    YogGC_UPDATE_PTR(env, CODE(code), filename, HDL2VAL(filename));
+    ID class_name = read_id(env, r);
+    CODE(code)->class_name = class_name;
+    ID func_name = read_id(env, r);
+    CODE(code)->func_name = func_name;
+
+    if (read_uint(r) == 1) {
+        arg_info = YogArgInfo_new(env);
+        uint_t argc = read_uint(r);
+        ARG_INFO(arg_info)->argc = argc;
+        ARG_INFO(arg_info)->varargc = read_uint(r);
+        ARG_INFO(arg_info)->kwargc = read_uint(r);
+        ARG_INFO(arg_info)->blockargc = read_uint(r);
+        ARG_INFO(arg_info)->required_argc = read_uint(r);
+        obj = 0 < argc ? read_ids(env, r, argc) : YNIL;
+        YogGC_UPDATE_PTR(env, ARG_INFO(arg_info), argnames, obj);
+        YogGC_UPDATE_PTR(env, CODE(code), arg_info, arg_info);
+    }
+
+    uint_t attr_caches_num = read_uint(r);
+    if (insts_size < attr_caches_num) {
+        r->error = TRUE;
+        RETURN(env, YUNDEF);
+    }
+    if (0 < attr_caches_num) {
+        obj = YogCode_alloc_attr_caches(env, attr_caches_num);
+        YogGC_UPDATE_PTR(env, CODE(code), attr_caches, obj);
+    }
+
+    if (r->error) {
+        RETURN(env, YUNDEF);
+    }
+
+    RETURN(env, code);
+}
+
+#define FNV_OFFSET_BASIS    2166136261U
+
+/**
+ * 32-bit FNV-1a
+ */
+static uint32_t
+hash_bytes(uint32_t hash, const char* p, uint_t size)
+{
+    uint_t i;
+    for (i = 0; i < size; i++) {
+        hash = (hash ^ (uint8_t)p[i]) * 16777619U;
+    }
+    return hash;
+}
+
+static void
+hash_source(FILE* fp, YogSourceStamp* stamp)
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+    char buf[4096];
+    size_t size;
+    rewind(fp);
+    while (0 < (size = fread(buf, sizeof(char), array_sizeof(buf), fp))) {
+        hash = hash_bytes(hash, buf, size);
+    }
+    rewind(fp);
+
+    stamp->hash = hash;
+    stamp->hashed = TRUE;
+}
+
+static void
+init_header(Header* header, const char* magic)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, magic, sizeof(header->magic));
+    header->version = CACHE_VERSION;
+    header->opcodes_digest = OPCODES_DIGEST;
+    header->layout = CACHE_LAYOUT;
+    header->cached_at = time(NULL);
+}
+
+/**
+ * Tells whether a file was written by a build which has the same format.
+ */
+static BOOL
+is_compatible(const Header* header, const char* magic)
+{
+    if (memcmp(header->magic, magic, sizeof(header->magic)) != 0) {
+        return FALSE;
+    }
+    if (header->version != CACHE_VERSION) {
+        return FALSE;
+    }
+    if (header->opcodes_digest != OPCODES_DIGEST) {
+        return FALSE;
+    }
+    return header->layout == CACHE_LAYOUT;
+}
+
+static BOOL
+is_fresh(YogEnv* env, const Header* header, FILE* fp, YogSourceStamp* stamp)
+{
+    if (!is_compatible(header, CACHE_MAGIC)) {
+        return FALSE;
+    }
+    const char* encoding = env->vm->default_encoding_name;
+    if (strncmp(header->source_encoding, encoding, sizeof(header->source_encoding)) != 0) {
+        return FALSE;
+    }
+    if (header->source_size != stamp->size) {
+        return FALSE;
+    }
+    /**
+     * mtime has only one-second resolution. A source which was changed in the
+     * second when its cache was written can't be told by mtime, so it is
+     * compared by hash.
+     */
+    if ((header->source_mtime == stamp->mtime) && (stamp->mtime < header->cached_at)) {
+        return TRUE;
+    }
+    hash_source(fp, stamp);
+    return header->source_hash == stamp->hash;
+}
+
+static YogHandle*
+get_cache_path(YogEnv* env, YogHandle* filename)
+{
+    YogHandle* path = VAL2HDL(env, YogString_clone(env, HDL2VAL(filename)));
+    YogString_append_string(env, HDL2VAL(path), "c");
+    return path;
+}
+
+static char*
+read_file(const char* path, uint_t* size)
+{
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+    struct stat st;
+    if ((fstat(fileno(fp), &st) != 0) || (st.st_size < (off_t)sizeof(Header))) {
+        fclose(fp);
+        return NULL;
+    }
+    char* buf = (char*)malloc(st.st_size);
+    if (buf == NULL) {
+        fclose(fp);
+        return NULL;
+    }
+    if (fread(buf, sizeof(char), st.st_size, fp) != (size_t)st.st_size) {
+        free(buf);
+        fclose(fp);
+        return NULL;
+    }
+    fclose(fp);
+
+    *size = st.st_size;
+    return buf;
+}
+
+static char*
+read_cache(YogEnv* env, YogHandle* filename, uint_t* size)
+{
+    YogHandle* path = get_cache_path(env, filename);
+    YogVal bin = YogString_to_bin_in_default_encoding(env, path);
+    return read_file(BINARY_CSTR(bin), size);
+}
+
+/**
+ * Tells whether the directory of path is writable. This avoids serializing
+ * code every time for a cache which can't be written.
+ */
+static BOOL
+can_write(const char* path)
+{
+    char dir[strlen(path) + 2];
+    strcpy(dir, path);
+    char* pc = strrchr(dir, PATH_SEPARATOR);
+    if (pc == NULL) {
+        strcpy(dir, ".");
+    }
+    else if (pc == dir) {
+        pc[1] = '\0';
+    }
+    else {
+        *pc = '\0';
+    }
+    return access(dir, W_OK) == 0;
+}
+
+/**
+ * Makes the directories of path like "mkdir -p". Errors are ignored, and
+ * can_write tells whether the last one exists.
+ */
+static void
+make_parent_dirs(const char* path)
+{
+    char dir[strlen(path) + 1];
+    strcpy(dir, path);
+    char* pc;
+    for (pc = dir + 1; *pc != '\0'; pc++) {
+        if (*pc != PATH_SEPARATOR) {
+            continue;
+        }
+        *pc = '\0';
+        YogSysdeps_mkdir(dir);
+        *pc = PATH_SEPARATOR;
+    }
+}
+
+/**
+ * Writes into a temporary file at first, and then renames it, so other
+ * processes never read a half-written file. Failures are ignored because
+ * caches are optional.
+ */
+static void
+write_file(const char* path, Writer* w)
+{
+    uint_t len = strlen(path) + 32;
+    char tmp[len];
+    YogSysdeps_snprintf(tmp, len, "%s.%d.tmp", path, (int)getpid());
+    FILE* fp = fopen(tmp, "wb");
+    if (fp == NULL) {
+        return;
+    }
+    BOOL written = fwrite(w->buf, sizeof(char), w->size, fp) == w->size;
+    if ((fclose(fp) != 0) || !written || (rename(tmp, path) != 0)) {
+        unlink(tmp);
+    }
+}
+
+/**
+ * Returns the code of a package from its cache file, or YUNDEF when the cache
+ * is missing or stale. stamp is set up for YogCodeCache_store in both cases.
+ */
+YogVal
+YogCodeCache_load(YogEnv* env, YogHandle* filename, FILE* fp, YogSourceStamp* stamp)
+{
+    stamp->valid = stamp->hashed = FALSE;
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0) {
+        return YUNDEF;
+    }
+    stamp->valid = TRUE;
+    stamp->mtime = st.st_mtime;
+    stamp->size = st.st_size;
+
+    uint_t size;
+    char* buf = read_cache(env, filename, &size);
+    if (buf == NULL) {
+        hash_source(fp, stamp);
+        return YUNDEF;
+    }
+    Header header;
+    memcpy(&header, buf, sizeof(header));
+    if (!is_fresh(env, &header, fp, stamp)) {
+        free(buf);
+        if (!stamp->hashed) {
+            hash_source(fp, stamp);
+        }
+        return YUNDEF;
+    }
+
+    Reader r;
+    r.pc = buf + sizeof(Header);
+    r.end = buf + size;
+    r.error = FALSE;
+    YogVal code = read_code(env, &r, filename);
+    free(buf);
+    if (r.error || (r.pc != r.end)) {
+        if (!stamp->hashed) {
+            hash_source(fp, stamp);
+        }
+        return YUNDEF;
+    }
+
+    return code;
+}
+
+/**
+ * Writes code into the cache file of the source.
+ */
+void
+YogCodeCache_store(YogEnv* env, YogHandle* filename, YogSourceStamp* stamp, YogHandle* code)
+{
+    if (!stamp->valid || !stamp->hashed) {
+        return;
+    }
+
+    Header header;
+    init_header(&header, CACHE_MAGIC);
+    header.source_mtime = stamp->mtime;
+    header.source_size = stamp->size;
+    header.source_hash = stamp->hash;
+    const char* encoding = env->vm->default_encoding_name;
+    if (sizeof(header.source_encoding) <= strlen(encoding)) {
+        return;
+    }
+    strcpy(header.source_encoding, encoding);
+
+    YogHandle* cache = get_cache_path(env, filename);
+    YogVal bin = YogString_to_bin_in_default_encoding(env, cache);
+    char path[strlen(BINARY_CSTR(bin)) + 1];
+    strcpy(path, BINARY_CSTR(bin));
+    if (!can_write(path)) {
+        return;
+    }
+
+    Writer w;
+    w.buf = NULL;
+    w.size = w.capacity = 0;
+    write_bytes(env, &w, &header, sizeof(header));
+    if (write_code(env, &w, HDL2VAL(code))) {
+        write_file(path, &w);
+    }
+    free(w.buf);
+}
+
+static YogVal
+get_boot_filename(YogEnv* env)
+{
+    return YogString_from_string(env, "builtins");
+}
+
+/**
+ * Reads the boot snapshot, which is compiled code of the builtin scripts
+ * (array.yog, string.yog and so on). YogVM_boot calls this before evaluating
+ * them.
+ */
+void
+YogCodeCache_load_boot_snapshot(YogEnv* env, YogVM* vm)
+{
+    vm->boot_scripts_num = 0;
+    vm->boot_snapshot_stale = FALSE;
+    vm->boot_codes = YogValArray_new(env, BOOT_SCRIPTS_MAX);
+    if (vm->boot_snapshot_path == NULL) {
+        return;
+    }
+
+    uint_t size;
+    char* buf = read_file(vm->boot_snapshot_path, &size);
+    if (buf == NULL) {
+        vm->boot_snapshot_stale = TRUE;
+        return;
+    }
+    Header header;
+    memcpy(&header, buf, sizeof(header));
+    if (!is_compatible(&header, BOOT_MAGIC)) {
+        free(buf);
+        vm->boot_snapshot_stale = TRUE;
+        return;
+    }
+
+    YogHandle* filename = VAL2HDL(env, get_boot_filename(env));
+    Reader r;
+    r.pc = buf + sizeof(Header);
+    r.end = buf + size;
+    r.error = FALSE;
+    uint_t num = read_uint(&r);
+    uint_t i;
+    for (i = 0; (i < num) && (i < BOOT_SCRIPTS_MAX) && !r.error; i++) {
+        vm->boot_hashes[i] = read_uint(&r);
+        YogVal code = read_code(env, &r, filename);
+        YogGC_UPDATE_PTR(env, PTR_AS(YogValArray, vm->boot_codes), items[i], code);
+    }
+    free(buf);
+    if (r.error || (r.pc != r.end)) {
+        vm->boot_codes = YogValArray_new(env, BOOT_SCRIPTS_MAX);
+        vm->boot_snapshot_stale = TRUE;
+    }
+}
+
+static YogVal
+compile_builtin_script(YogEnv* env, const char* src)
+{
+    YogHandle* name = VAL2HDL(env, get_boot_filename(env));
+    YogVal s = YogString_from_string(env, src);
+    YogVal stmts = YogParser_parse(env, s);
+    return YogCompiler_compile_package(env, name, stmts);
+}
+
+/**
+ * Returns code of a builtin script. Scripts are identified by the order of
+ * evaluation, and the snapshotted code is used only when the source has the
+ * same hash.
+ */
+YogVal
+YogCodeCache_get_boot_code(YogEnv* env, YogVM* vm, const char* src)
+{
+    uint_t index = vm->boot_scripts_num;
+    if (!IS_PTR(vm->boot_codes) || (BOOT_SCRIPTS_MAX <= index)) {
+        return compile_builtin_script(env, src);
+    }
+    vm->boot_scripts_num++;
+
+    uint32_t hash = hash_bytes(FNV_OFFSET_BASIS, src, strlen(src));
+    YogVal code = YogValArray_at(env, vm->boot_codes, index);
+    if (IS_PTR(code) && (vm->boot_hashes[index] == hash)) {
+        return code;
+    }
+
+    code = compile_builtin_script(env, src);
+    YogGC_UPDATE_PTR(env, PTR_AS(YogValArray, vm->boot_codes), items[index], code);
+    vm->boot_hashes[index] = hash;
+    vm->boot_snapshot_stale = TRUE;
+    return code;
+}
+
+/**
+ * Writes the boot snapshot when some builtin scripts were compiled in this
+ * boot, and releases codes of the snapshot.
+ */
+void
+YogCodeCache_store_boot_snapshot(YogEnv* env, YogVM* vm)
+{
+    const char* path = vm->boot_snapshot_path;
+    if (!vm->boot_snapshot_stale || (path == NULL)) {
+        vm->boot_codes = YUNDEF;
+        return;
+    }
+    /* The default snapshot is in ~/.cache/yog/VERSION, which may be new. */
+    make_parent_dirs(path);
+    if (!can_write(path)) {
+        vm->boot_codes = YUNDEF;
+        return;
+    }
+
+    Header header;
+    init_header(&header, BOOT_MAGIC);
+
+    Writer w;
+    w.buf = NULL;
+    w.size = w.capacity = 0;
+    write_bytes(env, &w, &header, sizeof(header));
+    uint_t num = vm->boot_scripts_num;
+    write_uint(env, &w, num);
+    BOOL written = TRUE;
+    uint_t i;
+    for (i = 0; (i < num) && written; i++) {
+        write_uint(env, &w, vm->boot_hashes[i]);
+        YogVal code = YogValArray_at(env, vm->boot_codes, i);
+        written = write_code(env, &w, code);
+    }
+    if (written) {
+        write_file(path, &w);
+    }
+    free(w.buf);
+    vm->boot_codes = YUNDEF;
+}
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
@@ -14,7 +14,7 @@ cmp(YogEnv* env, YogVal self, YogVal x)
     YogVal retval = YUNDEF;
     PUSH_LOCAL(env, retval);
 
-    retval = YogEval_call_method1(env, self, "<=>", x);
+    retval = YogEval_call_method_id1(env, self, env->vm->id_ufo, x);
 
     RETURN(env, retval);
 }
@@ -176,6 +176,8 @@ struct CompileData {
     BOOL interactive;
     int_t outer_depth;
     YogVal outer_data;
+
+    uint_t attr_caches_num;
 };
 
 typedef struct CompileData CompileData;
@@ -242,6 +244,9 @@ YogInst_keep_children(YogEnv* env, void* ptr, ObjectKeeper keeper, void* heap)
     case OP(JUMP_IF_DEFINED):
         YogGC_KEEP(env, INST(inst), u.jump_if_defined.dest, keeper, heap);
         break;
+    case OP(LESS_JUMP_IF_FALSE):
+        YogGC_KEEP(env, INST(inst), u.less_jump_if_false.dest, keeper, heap);
+        break;
     default:
         break;
     }
@@ -1035,7 +1040,7 @@ scan_var_visit_import(YogEnv* env, AstVisitor* visitor, YogVal node, YogVal data
         YOG_ASSERT(env, IS_NIL(as), "invalid \"as\" (0x%08x)", as);
         name = YogArray_at(env, NODE(node)->u.import.name, 0);
     }
-    register_var_as_assigned(env, data, name);
+    register_var_as_assigned(env, data, VAL2ID(name));
 
     RETURN_VOID(env);
 }
@@ -1714,6 +1719,14 @@ CompileData_get_outer_context(YogEnv* env, YogVal data, uint_t level)
     RETURN(env, VAR_TABLE(tbl)->ctx);
 }
 
+static void
+append_load_attr(YogEnv* env, YogVal data, uint_t lineno, ID name)
+{
+    uint_t cache = COMPILE_DATA(data)->attr_caches_num;
+    COMPILE_DATA(data)->attr_caches_num++;
+    CompileData_add_load_attr(env, data, lineno, name, cache);
+}
+
 static void
 append_store(YogEnv* env, YogVal data, uint_t lineno, ID name)
 {
@@ -1787,8 +1800,8 @@ compile_assign(YogEnv* env, AstVisitor* visitor, YogVal node, YogVal data)
     case NODE_SUBSCRIPT:
         visit_node(env, visitor, NODE(node)->u.subscript.index, data);
         visit_node(env, visitor, NODE(node)->u.subscript.prefix, data);
-        name = YogVM_intern(env, env->vm, "[]=");
-        CompileData_add_load_attr(env, data, lineno, name);
+        name = env->vm->id_subscript_assign;
+        append_load_attr(env, data, lineno, name);
 
         CompileData_add_call_function(env, data, lineno, 2, 0, 0, 0, 0, 1, 0, 0);
         break;
@@ -2328,6 +2341,79 @@ calc_pc(YogVal inst)
     }
 }
 
+static BOOL
+is_fusable(YogVal inst, YogVal next)
+{
+    if (!IS_PTR(next) || (INST(next)->type != INST_OP)) {
+        return FALSE;
+    }
+    return INST(inst)->lineno == INST(next)->lineno;
+}
+
+static void
+remove_next_inst(YogEnv* env, YogVal inst)
+{
+    YogVal next = INST(inst)->next;
+    YogGC_UPDATE_PTR(env, INST(inst), next, INST(next)->next);
+}
+
+/**
+ * Peephole pass which fuses frequent sequences of instructions into
+ * superinstructions. Instructions are fused only when no label is between
+ * them (nobody jumps into the middle of a superinstruction) and they are on
+ * same line (the line number table keeps its granularity). This pass never
+ * allocates objects.
+ */
+static void
+fuse_insts(YogEnv* env, YogVal inst, YogVal consts)
+{
+    while (IS_PTR(inst)) {
+        YogVal next = INST(inst)->next;
+        if ((INST(inst)->type != INST_OP) || !is_fusable(inst, next)) {
+            inst = next;
+            continue;
+        }
+
+        switch (INST(inst)->opcode) {
+        case OP(LOAD_LOCAL_INDEX):
+            if (INST(next)->opcode == OP(LOAD_LOCAL_INDEX)) {
+                uint8_t index1 = INST(inst)->u.load_local_index.index;
+                uint8_t index2 = INST(next)->u.load_local_index.index;
+                INST(inst)->opcode = OP(LOAD_LOCAL_INDEX2);
+                INST(inst)->u.load_local_index2.index1 = index1;
+                INST(inst)->u.load_local_index2.index2 = index2;
+                remove_next_inst(env, inst);
+            }
+            break;
+        case OP(PUSH_CONST):
+            if (INST(next)->opcode == OP(ADD)) {
+                uint_t index = INST(inst)->u.push_const.index;
+                if (IS_FIXNUM(YogValArray_at(env, consts, index))) {
+                    INST(inst)->opcode = OP(ADD_CONST_INT);
+                    INST(inst)->u.add_const_int.index = index;
+                    remove_next_inst(env, inst);
+                }
+            }
+            break;
+        case OP(LESS):
+            if (INST(next)->opcode == OP(JUMP_IF_FALSE)) {
+                /**
+                 * jump_if_false is left as it is. less_jump_if_false uses it
+                 * when the comparison is not of Fixnums.
+                 */
+                YogVal dest = INST(next)->u.jump_if_false.dest;
+                INST(inst)->opcode = OP(LESS_JUMP_IF_FALSE);
+                YogGC_UPDATE_PTR(env, INST(inst), u.less_jump_if_false.dest, dest);
+            }
+            break;
+        default:
+            break;
+        }
+
+        inst = INST(inst)->next;
+    }
+}
+
 static void
 CompileData_add_ret_nil(YogEnv* env, YogVal data, uint_t lineno)
 {
@@ -2398,6 +2484,7 @@ CompileData_new(YogEnv* env, YogVal vars, YogVal anchor, YogVal exc_tbl_ent, Yog
     COMPILE_DATA(data)->interactive = interactive;
     COMPILE_DATA(data)->outer_depth = 0;
     YogGC_UPDATE_PTR(env, COMPILE_DATA(data), outer_data, outer_data);
+    COMPILE_DATA(data)->attr_caches_num = 0;
 
     RETURN(env, data);
 }
@@ -2574,8 +2661,11 @@ compile_stmts(YogEnv* env, AstVisitor* visitor, YogVal filename, ID class_name,
 
     YogVal bin = YUNDEF;
     YogVal code = YUNDEF;
-    PUSH_LOCALS2(env, bin, code);
+    YogVal consts = YUNDEF;
+    PUSH_LOCALS3(env, bin, code, consts);
 
+    consts = table2array(env, COMPILE_DATA(data)->const2index);
+    fuse_insts(env, anchor, consts);
     calc_pc(anchor);
     bin = insts2bin(env, anchor);
     YogBinary_shrink(env, bin);
@@ -2584,9 +2674,8 @@ compile_stmts(YogEnv* env, AstVisitor* visitor, YogVal filename, ID class_name,
     uint_t local_vars_count = count_locals(env, vars);
     CODE(code)->local_vars_count = local_vars_count;
     ID* local_vars_names = alloc_local_vars_table(env, vars, local_vars_count);
-    CODE(code)->local_vars_names = local_vars_names;
+    YogGC_UPDATE_PTR(env, CODE(code), local_vars_names, local_vars_names);
     CODE(code)->stack_size = count_stack_size(env, anchor);
-    YogVal consts = table2array(env, COMPILE_DATA(data)->const2index);
     YogGC_UPDATE_PTR(env, CODE(code), consts, consts);
     YogGC_UPDATE_PTR(env, CODE(code), insts, PTR_AS(YogBinary, bin)->body);
     int_t outer_depth = get_max_outer_level(env, vars);
@@ -2600,6 +2689,12 @@ compile_stmts(YogEnv* env, AstVisitor* visitor, YogVal filename, ID class_name,
     CODE(code)->class_name = class_name;
     CODE(code)->func_name = func_name;
 
+    uint_t attr_caches_num = COMPILE_DATA(data)->attr_caches_num;
+    if (0 < attr_caches_num) {
+        YogVal caches = YogCode_alloc_attr_caches(env, attr_caches_num);
+        YogGC_UPDATE_PTR(env, CODE(code), attr_caches, caches);
+    }
+
     RETURN(env, code);
 }
 
@@ -3653,7 +3748,7 @@ compile_load_pkg_attr(YogEnv* env, YogVal data, uint_t lineno, YogVal name)
     uint_t i;
     for (i = 1; i < size; i++) {
         attr = YogArray_at(env, name, i);
-        CompileData_add_load_attr(env, data, lineno, VAL2ID(attr));
+        append_load_attr(env, data, lineno, VAL2ID(attr));
     }
 
     RETURN_VOID(env);
@@ -3670,7 +3765,7 @@ compile_store_pkg_attr(YogEnv* env, YogVal data, uint_t lineno, YogVal attrs, ui
     attr = YogArray_at(env, attrs, index);
     YOG_ASSERT(env, NODE(attr)->type == NODE_IMPORTED_ATTR, "invalid node type (0x%x)", NODE(attr)->type);
     ID name = NODE(attr)->u.imported_attr.name;
-    CompileData_add_load_attr(env, data, lineno, name);
+    append_load_attr(env, data, lineno, name);
     as = NODE(attr)->u.imported_attr.as;
     if (IS_NIL(as)) {
         append_store(env, data, lineno, name);
@@ -3743,7 +3838,7 @@ compile_visit_attr(YogEnv* env, AstVisitor* visitor, YogVal node, YogVal data)
 
     uint_t lineno = NODE(node)->lineno;
     ID name = NODE(node)->u.attr.name;
-    CompileData_add_load_attr(env, data, lineno, name);
+    append_load_attr(env, data, lineno, name);
 
     RETURN_VOID(env);
 }
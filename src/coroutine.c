@@ -1,12 +1,19 @@
 #include "yog/config.h"
+#include <errno.h>
 #include <stdlib.h>
 #include <strings.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#if defined(YOG_HAVE_UNISTD_H)
+#   include <unistd.h>
+#endif
 #include "yog/array.h"
 #include "yog/callable.h"
 #include "yog/class.h"
 #include "yog/error.h"
 #include "yog/frame.h"
 #include "yog/get_args.h"
+#include "yog/handle.h"
 #include "yog/object.h"
 #include "yog/sysdeps.h"
 #include "yog/thread.h"
@@ -99,6 +106,8 @@ struct Coroutine {
      * |          | |
      * +----------+ v
      *              stack bottom (higher address)
+     *
+     * A guard page is just above the stack top. See "Machine Stacks".
      */
     void* machine_stack;
 
@@ -146,6 +155,28 @@ typedef struct Coroutine Coroutine;
     } \
 } while (0)
 
+/**
+ * = Machine Stacks
+ *
+ * A machine stack is mapped with mmap(2) with one guard page at its top (the
+ * lower address). A coroutine which overflows its stack gets SIGSEGV at the
+ * guard page instead of breaking other memory. Pages of a stack are not
+ * committed until they are touched.
+ *
+ * When a coroutine of the default stack size dies, its stack is pushed to
+ * YogThread::machine_stacks of the thread which resumed it, and a next
+ * coroutine in the thread takes it without mmap(2). The YogLocalsAnchor and
+ * the YogHandles at the bottom of a pooled stack stay registered in the VM, so
+ * reusing a stack does not take the global interpreter lock for
+ * YogVM_add_locals and YogVM_add_handles. Pages above the bottom
+ * MACHINE_STACK_HOT_SIZE bytes are given back with madvise(2) at pooling.
+ *
+ * A stack of a coroutine which never dies is unmapped by its finalizer. Pooled
+ * stacks are unmapped when their thread finishes.
+ */
+#define DEFAULT_MACHINE_STACK_SIZE  (2048 * 4096)
+#define MACHINE_STACK_HOT_SIZE      (16 * 4096)
+
 static YogLocalsAnchor*
 machine_stack2locals(YogEnv* env, void* stack, uint_t size)
 {
@@ -309,19 +340,117 @@ coroutine_main(YogEnv* env, YogVal self)
     yield_coroutine(&coroutine_env, self, STATUS_DEAD);
 }
 
+static size_t
+get_page_size()
+{
+    return sysconf(_SC_PAGESIZE);
+}
+
+static void*
+map_machine_stack(YogEnv* env, uint_t size)
+{
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#   define MAP_ANONYMOUS MAP_ANON
+#endif
+#if !defined(MAP_NORESERVE)
+#   define MAP_NORESERVE 0
+#endif
+    size_t page_size = get_page_size();
+    int prot = PROT_READ | PROT_WRITE;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+    void* ptr = mmap(NULL, page_size + size, prot, flags, -1, 0);
+    if (ptr == MAP_FAILED) {
+        YogError_raise_sys_err(env, errno, YNIL);
+    }
+    if (mprotect(ptr, page_size, PROT_NONE) != 0) {
+        int errno_ = errno;
+        munmap(ptr, page_size + size);
+        YogError_raise_sys_err(env, errno_, YNIL);
+    }
+
+    void* machine_stack = (char*)ptr + page_size;
+    YogLocalsAnchor* locals = machine_stack2locals(env, machine_stack, size);
+    register_locals(env, locals);
+    YogHandles* handles = machine_stack2handles(env, machine_stack, size);
+    register_handles(env, handles);
+
+    return machine_stack;
+}
+
+static void
+unmap_machine_stack(YogEnv* env, void* machine_stack, uint_t size)
+{
+    YogLocalsAnchor* locals = machine_stack2locals(env, machine_stack, size);
+    YogVM_remove_locals(env, env->vm, locals);
+    YogHandles* handles = machine_stack2handles(env, machine_stack, size);
+    YogVM_remove_handles(env, env->vm, handles);
+    YogHandles_finalize(handles);
+
+    size_t page_size = get_page_size();
+    munmap((char*)machine_stack - page_size, page_size + size);
+}
+
+static void*
+take_machine_stack(YogEnv* env, uint_t size)
+{
+    YogThread* thread = PTR_AS(YogThread, env->thread);
+    if ((size != DEFAULT_MACHINE_STACK_SIZE) || (thread->machine_stacks_num == 0)) {
+        return map_machine_stack(env, size);
+    }
+
+    thread->machine_stacks_num--;
+    void* machine_stack = thread->machine_stacks[thread->machine_stacks_num];
+    YogLocalsAnchor* locals = machine_stack2locals(env, machine_stack, size);
+    locals->body = NULL;
+    locals->heap = thread->heap;
+    YogHandles* handles = machine_stack2handles(env, machine_stack, size);
+    handles->used_num = 0;
+    handles->scope = NULL;
+    handles->heap = thread->heap;
+
+    return machine_stack;
+}
+
+static void
+release_machine_stack(YogEnv* env, YogVal self)
+{
+    void* machine_stack = PTR_AS(Coroutine, self)->machine_stack;
+    uint_t size = PTR_AS(Coroutine, self)->machine_stack_size;
+    PTR_AS(Coroutine, self)->machine_stack = NULL;
+
+    YogThread* thread = PTR_AS(YogThread, env->thread);
+    uint_t n = thread->machine_stacks_num;
+    if ((size != DEFAULT_MACHINE_STACK_SIZE) || (MACHINE_STACKS_MAX <= n)) {
+        unmap_machine_stack(env, machine_stack, size);
+        return;
+    }
+    madvise(machine_stack, size - MACHINE_STACK_HOT_SIZE, MADV_DONTNEED);
+    thread->machine_stacks[n] = machine_stack;
+    thread->machine_stacks_num++;
+}
+
+void
+YogCoroutine_unmap_machine_stacks(YogEnv* env, YogVal thread)
+{
+    while (0 < PTR_AS(YogThread, thread)->machine_stacks_num) {
+        PTR_AS(YogThread, thread)->machine_stacks_num--;
+        uint_t n = PTR_AS(YogThread, thread)->machine_stacks_num;
+        void* machine_stack = PTR_AS(YogThread, thread)->machine_stacks[n];
+        unmap_machine_stack(env, machine_stack, DEFAULT_MACHINE_STACK_SIZE);
+    }
+}
+
 static void
 alloc_machine_stack(YogEnv* env, YogVal self)
 {
     SAVE_ARG(env, self);
-    int_t machine_stack_size = PTR_AS(Coroutine, self)->machine_stack_size;
+    size_t page_size = get_page_size();
+    int_t size = PTR_AS(Coroutine, self)->machine_stack_size;
+    size = (size + page_size - 1) & ~(page_size - 1);
 
-    void* machine_stack = malloc(machine_stack_size);
-    YOG_ASSERT(env, machine_stack != NULL, "malloc failed");
-    YogLocalsAnchor* locals = machine_stack2locals(env, machine_stack, machine_stack_size);
-    register_locals(env, locals);
-    YogHandles* handles = machine_stack2handles(env, machine_stack, machine_stack_size);
-    register_handles(env, handles);
+    void* machine_stack = take_machine_stack(env, size);
     PTR_AS(Coroutine, self)->machine_stack = machine_stack;
+    PTR_AS(Coroutine, self)->machine_stack_size = size;
 
     RETURN_VOID(env);
 }
@@ -336,7 +465,7 @@ Coroutine_init(YogEnv* env, YogVal self, YogVal klass)
     SwitchContext_init(env, &PTR_AS(Coroutine, self)->ctx_to_resume);
     SwitchContext_init(env, &PTR_AS(Coroutine, self)->ctx_to_yield);
 
-    PTR_AS(Coroutine, self)->machine_stack_size = 2048 * 4096;
+    PTR_AS(Coroutine, self)->machine_stack_size = DEFAULT_MACHINE_STACK_SIZE;
     PTR_AS(Coroutine, self)->boundary_frame = YUNDEF;
     PTR_AS(Coroutine, self)->block = YUNDEF;
     PTR_AS(Coroutine, self)->status = STATUS_SUSPENDED;
@@ -431,10 +560,6 @@ resume(YogEnv* env, YogVal self, YogVal pkg, YogVal args, YogVal kw, YogVal bloc
         YogError_raise_CoroutineError(env, "dead coroutine called");
     }
 
-    YogGC_UPDATE_PTR(env, PTR_AS(Coroutine, self), boundary_frame, env->frame);
-    PTR_AS(Coroutine, self)->status = STATUS_RUNNING;
-    YogGC_UPDATE_PTR(env, PTR_AS(Coroutine, self), args, a);
-
     if (CTX_IP(PTR_AS(Coroutine, self)->ctx_to_resume) == NULL) {
         alloc_machine_stack(env, self);
         void* stack = PTR_AS(Coroutine, self)->machine_stack;
@@ -482,6 +607,9 @@ resume(YogEnv* env, YogVal self, YogVal pkg, YogVal args, YogVal kw, YogVal bloc
 #endif
         CTX_IP(PTR_AS(Coroutine, self)->ctx_to_resume) = ip;
     }
+    YogGC_UPDATE_PTR(env, PTR_AS(Coroutine, self), boundary_frame, env->frame);
+    PTR_AS(Coroutine, self)->status = STATUS_RUNNING;
+    YogGC_UPDATE_PTR(env, PTR_AS(Coroutine, self), args, a);
 
     SwitchContext* to = &PTR_AS(Coroutine, self)->ctx_to_resume;
     SwitchContext* cont = &PTR_AS(Coroutine, self)->ctx_to_yield;
@@ -490,6 +618,9 @@ resume(YogEnv* env, YogVal self, YogVal pkg, YogVal args, YogVal kw, YogVal bloc
     PTR_AS(Coroutine, self)->prev_jmp_buf = prev_jmp_buf;
     switch_context(env, to, cont);
     PTR_AS(YogThread, env->thread)->jmp_buf_list = prev_jmp_buf;
+    if (PTR_AS(Coroutine, self)->status == STATUS_DEAD) {
+        release_machine_stack(env, self);
+    }
 
     return_args(env, PTR_AS(Coroutine, self)->args);
     RETURN(env, YUNDEF);
@@ -545,12 +676,7 @@ finalize(YogEnv* env, void* ptr)
 
     void* machine_stack = coro->machine_stack;
     if (machine_stack != NULL) {
-        YogLocalsAnchor* locals = machine_stack2locals(env, machine_stack, coro->machine_stack_size);
-        YogVM_remove_locals(env, env->vm, locals);
-        YogHandles* handles = machine_stack2handles(env, machine_stack, coro->machine_stack_size);
-        YogVM_remove_handles(env, env->vm, handles);
-        YogHandles_finalize(handles);
-        free(machine_stack);
+        unmap_machine_stack(env, machine_stack, coro->machine_stack_size);
     }
 }
 
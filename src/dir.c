@@ -1,6 +1,7 @@
 #include "yog/config.h"
 #include <dirent.h>
 #include <errno.h>
+#include <string.h>
 #include <sys/types.h>
 #include "yog/binary.h"
 #include "yog/callable.h"
@@ -12,6 +13,7 @@
 #include "yog/misc.h"
 #include "yog/object.h"
 #include "yog/string.h"
+#include "yog/sysdeps.h"
 #include "yog/thread.h"
 #include "yog/vm.h"
 
@@ -51,7 +53,9 @@ do_close(YogEnv* env, YogHandle* self)
 {
     DIR* dir = HDL_AS(Dir, self)->dir;
     HDL_AS(Dir, self)->dir = NULL;
-    if (closedir(dir) != 0) {
+    int retval;
+    YogGC_BLOCKING_REGION(env, retval = closedir(dir));
+    if (retval != 0) {
         YogError_raise_sys_err(env, errno, YNIL);
     }
 }
@@ -62,7 +66,10 @@ open_(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* path, YogHandle*
     YogMisc_check_String(env, path, "path");
     YogHandle* dir = VAL2HDL(env, alloc(env, HDL2VAL(self)));
     YogVal s = YogString_to_bin_in_default_encoding(env, path);
-    DIR* dirp = opendir(BINARY_CSTR(s));
+    char* name = (char*)YogSysdeps_alloca(strlen(BINARY_CSTR(s)) + 1);
+    strcpy(name, BINARY_CSTR(s));
+    DIR* dirp;
+    YogGC_BLOCKING_REGION(env, dirp = opendir(name));
     if (dirp == NULL) {
         YogError_raise_sys_err(env, errno, HDL2VAL(path));
     }
@@ -95,8 +102,13 @@ open_(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* path, YogHandle*
 static YogVal
 each(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* block)
 {
-    struct dirent* de;
-    while ((de = readdir(HDL_AS(Dir, self)->dir)) != NULL) {
+    while (TRUE) {
+        DIR* dir = HDL_AS(Dir, self)->dir;
+        struct dirent* de;
+        YogGC_BLOCKING_REGION(env, de = readdir(dir));
+        if (de == NULL) {
+            break;
+        }
         YogVal name = YogString_from_string(env, de->d_name);
         YogCallable_call1(env, HDL2VAL(block), name);
     }
@@ -156,7 +156,7 @@ raise_error(YogEnv* env, YogVal klass, YogVal msg)
     YogVal exc = YUNDEF;
     PUSH_LOCAL(env, exc);
 
-    exc = YogEval_call_method1(env, klass, "new", msg);
+    exc = YogEval_call_method_id1(env, klass, env->vm->id_new, msg);
 
     RESTORE_LOCALS(env);
     YogError_raise(env, exc);
@@ -231,7 +231,7 @@ YogError_print_stacktrace(YogEnv* env)
     name = ID2BIN(id);
 #undef ID2BIN
     YogVal msg = PTR_AS(YogException, exc)->message;
-    YogHandle* h = VAL2HDL(env, YogEval_call_method0(env, msg, "to_s"));
+    YogHandle* h = VAL2HDL(env, YogEval_call_method_id0(env, msg, env->vm->id_to_s));
     YogVal bin = YogString_to_bin_in_default_encoding(env, h);
     fprintf(stderr, "%s: %s\n", BINARY_CSTR(name), BINARY_CSTR(bin));
 
@@ -364,7 +364,7 @@ raise_sys_err(YogEnv* env, YogVal klass, int_t errno_, YogVal opt)
     args[0] = YogVal_from_int(env, errno_);
     args[1] = opt;
     uint_t argc = IS_UNDEF(opt) ? 1 : array_sizeof(args);
-    exc = YogEval_call_method(env, klass, "new", argc, args);
+    exc = YogEval_call_method_id(env, klass, env->vm->id_new, argc, args);
 
     RESTORE_LOCALS(env);
     YogError_raise(env, exc);
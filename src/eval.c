@@ -3,6 +3,7 @@
 #   include <malloc.h>
 #endif
 #include <setjmp.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "yog/bignum.h"
@@ -32,6 +33,114 @@
 /* TODO: Remove this */
 #define CUR_FRAME   env->frame
 
+/**
+ * YogEval_mainloop jumps from an instruction to the next one directly through
+ * a table of label addresses (labels as values, an extension of GCC). Define
+ * YOG_DISABLE_THREADED_CODE to use switch-based dispatch instead.
+ */
+#if defined(__GNUC__) && !defined(YOG_DISABLE_THREADED_CODE)
+#   define USE_THREADED_CODE
+#endif
+
+#if defined(PROFILE_INSTS)
+/**
+ * Build with PROFILE_INSTS to count bigrams and trigrams of executed opcodes.
+ * They tell which sequences are worth being fused into superinstructions. An
+ * n-gram never spans two frames. The counters are not locked, so counts of
+ * multi-threaded scripts are approximate.
+ */
+static uint_t inst_bigrams[OPCODES_NUM][OPCODES_NUM];
+static uint_t inst_trigrams[OPCODES_NUM][OPCODES_NUM][OPCODES_NUM];
+
+struct InstNgram {
+    uint_t count;
+    OpCode ops[3];
+};
+
+typedef struct InstNgram InstNgram;
+
+static void
+count_inst(uint_t* prev_ops, OpCode op)
+{
+    uint_t op1 = prev_ops[0];
+    uint_t op2 = prev_ops[1];
+    if (op1 < OPCODES_NUM) {
+        inst_bigrams[op1][op]++;
+        if (op2 < OPCODES_NUM) {
+            inst_trigrams[op2][op1][op]++;
+        }
+    }
+    prev_ops[1] = op1;
+    prev_ops[0] = op;
+}
+
+static int
+compare_inst_ngrams(const void* a, const void* b)
+{
+    uint_t x = ((const InstNgram*)a)->count;
+    uint_t y = ((const InstNgram*)b)->count;
+    return x < y ? 1 : (x == y ? 0 : -1);
+}
+
+static void
+print_inst_ngrams(InstNgram* ngrams, uint_t size, uint_t n)
+{
+    qsort(ngrams, size, sizeof(InstNgram), compare_inst_ngrams);
+    uint_t i;
+    for (i = 0; (i < size) && (i < 32) && (0 < ngrams[i].count); i++) {
+        fprintf(stderr, "%12zu", ngrams[i].count);
+        uint_t j;
+        for (j = 0; j < n; j++) {
+            fprintf(stderr, " %s", YogCode_get_op_name(ngrams[i].ops[j]));
+        }
+        fprintf(stderr, "\n");
+    }
+}
+
+void
+YogEval_print_inst_profile(YogEnv* env)
+{
+    uint_t size = OPCODES_NUM * OPCODES_NUM;
+    InstNgram* ngrams = (InstNgram*)YogGC_malloc(env, sizeof(InstNgram) * size);
+    uint_t n = 0;
+    uint_t i;
+    uint_t j;
+    for (i = 0; i < OPCODES_NUM; i++) {
+        for (j = 0; j < OPCODES_NUM; j++) {
+            InstNgram* ngram = &ngrams[n++];
+            ngram->count = inst_bigrams[i][j];
+            ngram->ops[0] = i;
+            ngram->ops[1] = j;
+        }
+    }
+    fprintf(stderr, "=== Bigrams of instructions ===\n");
+    print_inst_ngrams(ngrams, n, 2);
+
+    /* Too many trigrams to sort all of them. Sort top of each bigram. */
+    n = 0;
+    for (i = 0; i < OPCODES_NUM; i++) {
+        for (j = 0; j < OPCODES_NUM; j++) {
+            uint_t k;
+            uint_t max = 0;
+            for (k = 1; k < OPCODES_NUM; k++) {
+                if (inst_trigrams[i][j][max] < inst_trigrams[i][j][k]) {
+                    max = k;
+                }
+            }
+            InstNgram* ngram = &ngrams[n++];
+            ngram->count = inst_trigrams[i][j][max];
+            ngram->ops[0] = i;
+            ngram->ops[1] = j;
+            ngram->ops[2] = max;
+        }
+    }
+    fprintf(stderr, "=== Trigrams of instructions ===\n");
+    print_inst_ngrams(ngrams, n, 3);
+
+    YogGC_free(env, ngrams, sizeof(InstNgram) * size);
+}
+#endif
+
 void
 YogEval_pop_frame(YogEnv* env)
 {
@@ -74,14 +183,13 @@ exec_call(YogEnv* env, YogHandle* callee, uint_t left, uint_t middle, uint_t rig
 }
 
 static void
-exec_binop(YogEnv* env, const char* op, YogVal left, YogVal right)
+exec_binop(YogEnv* env, ID op, YogVal left, YogVal right)
 {
     YogHandle* h_left = YogHandle_REGISTER(env, left);
     YogHandle* h_right = YogHandle_REGISTER(env, right);
-    ID name = YogVM_intern(env, env->vm, op);
-    YogVal attr = YogVal_get_attr(env, HDL2VAL(h_left), name);
+    YogVal attr = YogVal_get_attr(env, HDL2VAL(h_left), op);
     if (IS_UNDEF(attr)) {
-        YogError_raise_AttributeError(env, "%C object doesn't have an attribute of %s", HDL2VAL(h_left), op);
+        YogError_raise_AttributeError(env, "%C object doesn't have an attribute of %I", HDL2VAL(h_left), op);
         /* NOTREACHED */
     }
     YogHandle* h_attr = YogHandle_REGISTER(env, attr);
@@ -91,127 +199,127 @@ exec_binop(YogEnv* env, const char* op, YogVal left, YogVal right)
 static void
 exec_xor(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, "^", left, right);
+    exec_binop(env, env->vm->id_caret, left, right);
 }
 
 static void
 exec_or(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, "|", left, right);
+    exec_binop(env, env->vm->id_bar, left, right);
 }
 
 static void
 exec_and(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, "&", left, right);
+    exec_binop(env, env->vm->id_amp, left, right);
 }
 
 static void
 exec_power(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, "**", left, right);
+    exec_binop(env, env->vm->id_star2, left, right);
 }
 
 static void
 exec_modulo(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, "%", left, right);
+    exec_binop(env, env->vm->id_percent, left, right);
 }
 
 static void
 exec_rshift(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, ">>", left, right);
+    exec_binop(env, env->vm->id_rshift, left, right);
 }
 
 static void
 exec_lshift(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, "<<", left, right);
+    exec_binop(env, env->vm->id_lshift, left, right);
 }
 
 static void
 exec_search(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, "=~", left, right);
+    exec_binop(env, env->vm->id_match, left, right);
 }
 
 static void
 exec_floor_divide(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, "//", left, right);
+    exec_binop(env, env->vm->id_slash2, left, right);
 }
 
 static void
 exec_divide(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, "/", left, right);
+    exec_binop(env, env->vm->id_slash, left, right);
 }
 
 static void
 exec_multiply(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, "*", left, right);
+    exec_binop(env, env->vm->id_star, left, right);
 }
 
 static void
 exec_subtract(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, "-", left, right);
+    exec_binop(env, env->vm->id_minus, left, right);
 }
 
 static void
 exec_add(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, "+", left, right);
+    exec_binop(env, env->vm->id_plus, left, right);
 }
 
 static void
 exec_greater_equal(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, ">=", left, right);
+    exec_binop(env, env->vm->id_ge, left, right);
 }
 
 static void
 exec_less_equal(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, "<=", left, right);
+    exec_binop(env, env->vm->id_le, left, right);
 }
 
 static void
 exec_greater(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, ">", left, right);
+    exec_binop(env, env->vm->id_gt, left, right);
 }
 
 static void
 exec_less(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, "<", left, right);
+    exec_binop(env, env->vm->id_lt, left, right);
 }
 
 static void
 exec_not_equal(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, "!=", left, right);
+    exec_binop(env, env->vm->id_ne, left, right);
 }
 
 static void
 exec_equal(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, "==", left, right);
+    exec_binop(env, env->vm->id_eq, left, right);
 }
 
 static void
 exec_ufo(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, "<=>", left, right);
+    exec_binop(env, env->vm->id_ufo, left, right);
 }
 
 static void
 exec_subscript(YogEnv* env, YogVal left, YogVal right)
 {
-    exec_binop(env, "[]", left, right);
+    exec_binop(env, env->vm->id_subscript, left, right);
 }
 
 static void
@@ -494,16 +602,8 @@ push_jmp_val(YogEnv* env)
 }
 
 static void
-exec_get_attr(YogEnv* env, YogVal obj, ID name)
+push_attr(YogEnv* env, YogVal obj, ID name, YogVal class_of_obj, YogVal attr)
 {
-    YogVal attr = YUNDEF;
-    if (IS_PTR(obj) && ((PTR_AS(YogBasicObj, obj)->flags & HAS_ATTRS) != 0)) {
-        attr = YogObj_get_attr(env, obj, name);
-    }
-    YogVal class_of_obj = YogVal_get_class(env, obj);
-    if (IS_UNDEF(attr)) {
-        attr = YogClass_get_attr(env, class_of_obj, name);
-    }
     if (IS_UNDEF(attr)) {
         YogError_raise_AttributeError(env, "%C object has no attribute \"%I\"", obj, name);
     }
@@ -516,6 +616,40 @@ exec_get_attr(YogEnv* env, YogVal obj, ID name)
     exec(env, attr, obj, class_of_obj);
 }
 
+static void
+exec_get_attr_with_cache(YogEnv* env, YogVal obj, ID name, uint_t cache)
+{
+    YogVal code = SCRIPT_FRAME(CUR_FRAME)->code;
+    YogVal attr = YUNDEF;
+    if (IS_PTR(obj) && ((PTR_AS(YogBasicObj, obj)->flags & HAS_ATTRS) != 0)) {
+        YogVal shape = PTR_AS(YogObj, obj)->shape;
+        if (IS_PTR(shape)) {
+            int_t slot = YogCode_find_slot(env, code, cache, shape, name);
+            if (0 <= slot) {
+                attr = PTR_AS(YogValArray, PTR_AS(YogObj, obj)->attrs)->items[slot];
+            }
+        }
+        else {
+            attr = YogObj_get_attr(env, obj, name);
+        }
+    }
+    YogVal class_of_obj = YogVal_get_class(env, obj);
+    if (!IS_UNDEF(attr)) {
+        push_attr(env, obj, name, class_of_obj, attr);
+        return;
+    }
+
+    attr = YogCode_lookup_attr_cache(env, code, cache, class_of_obj, NULL);
+    if (IS_UNDEF(attr)) {
+        YogVal defining_class;
+        attr = YogClass_get_attr_and_defining_class(env, class_of_obj, name, &defining_class);
+        if (!IS_UNDEF(attr)) {
+            YogCode_update_attr_cache(env, code, cache, class_of_obj, attr, defining_class);
+        }
+    }
+    push_attr(env, obj, name, class_of_obj, attr);
+}
+
 static YogVal
 get_outer_frame(YogEnv* env, uint_t level)
 {
@@ -538,7 +672,7 @@ YogEval_call_method(YogEnv* env, YogVal receiver, const char* method, uint_t arg
 }
 
 YogVal
-YogEval_call_method1(YogEnv* env, YogVal receiver, const char* method, YogVal arg)
+YogEval_call_method_id1(YogEnv* env, YogVal receiver, ID method, YogVal arg)
 {
     SAVE_ARG(env, receiver);
     YogVal retval = YUNDEF;
@@ -546,23 +680,34 @@ YogEval_call_method1(YogEnv* env, YogVal receiver, const char* method, YogVal ar
     YogVal args[] = { arg };
     PUSH_LOCALSX(env, 1, args);
 
-    retval = YogEval_call_method(env, receiver, method, 1, args);
+    retval = YogEval_call_method_id(env, receiver, method, 1, args);
 
     RETURN(env, retval);
 }
 
 YogVal
-YogEval_call_method0(YogEnv* env, YogVal receiver, const char* method)
+YogEval_call_method1(YogEnv* env, YogVal receiver, const char* method, YogVal arg)
 {
-    SAVE_ARG(env, receiver);
-    YogVal retval = YUNDEF;
-    PUSH_LOCAL(env, retval);
+    SAVE_ARGS2(env, receiver, arg);
 
-    retval = YogEval_call_method(env, receiver, method, 0, NULL);
+    ID id = YogVM_intern(env, env->vm, method);
+    YogVal retval = YogEval_call_method_id1(env, receiver, id, arg);
 
     RETURN(env, retval);
 }
 
+YogVal
+YogEval_call_method_id0(YogEnv* env, YogVal receiver, ID method)
+{
+    return YogEval_call_method_id(env, receiver, method, 0, NULL);
+}
+
+YogVal
+YogEval_call_method0(YogEnv* env, YogVal receiver, const char* method)
+{
+    return YogEval_call_method(env, receiver, method, 0, NULL);
+}
+
 YogVal
 YogEval_call_method2(YogEnv* env, YogVal receiver, const char* method, uint_t argc, YogVal* args, YogVal blockarg)
 {
@@ -633,6 +778,14 @@ raise_LocalJumpError(YogEnv* env, const char* what_to_do)
     YogError_raise_LocalJumpError(env, "frame to %s is lost", what_to_do);
 }
 
+static void
+raise_UnboundLocalError(YogEnv* env, uint_t index)
+{
+    YogVal code = SCRIPT_FRAME(env->frame)->code;
+    ID name = PTR_AS(YogCode, code)->local_vars_names[index];
+    YogError_raise_UnboundLocalError(env, "Local variable \"%I\" referenced before assignment", name);
+}
+
 static void
 detect_orphan(YogEnv* env, int status, YogVal target_frame)
 {
@@ -802,12 +955,49 @@ rollback_frames(YogEnv* env, YogVal frame)
 YogVal
 YogEval_mainloop(YogEnv* env)
 {
-#define PC          (SCRIPT_FRAME(CUR_FRAME)->pc)
+#define PC          pc
 #undef CODE
 #define CODE        PTR_AS(YogCode, SCRIPT_FRAME(CUR_FRAME)->code)
+#define INSTS_BYTES PTR_AS(YogByteArray, HDL2VAL(h_insts))->items
+#define INSTS_SIZE  PTR_AS(YogByteArray, HDL2VAL(h_insts))->size
+#define SAVE_PC()   SCRIPT_FRAME(CUR_FRAME)->pc = pc
+#if defined(PROFILE_INSTS)
+#   define COUNT_INST(op)      count_inst(prev_ops, (op))
+#   define RESET_INST_COUNT()  prev_ops[0] = prev_ops[1] = OPCODES_NUM
+#else
+#   define COUNT_INST(op)
+#   define RESET_INST_COUNT()
+#endif
+#define LOAD_FRAME() do { \
+    RESET_INST_COUNT(); \
+    h_frame->val = CUR_FRAME; \
+    h_insts->val = CODE->insts; \
+    h_consts->val = CODE->consts; \
+    pc = SCRIPT_FRAME(CUR_FRAME)->pc; \
+} while (0)
+#define SYNC_FRAME() do { \
+    if (HDL2VAL(h_frame) != CUR_FRAME) { \
+        LOAD_FRAME(); \
+    } \
+} while (0)
     YogHandleScope outer_scope;
     YogHandleScope_OPEN(env, &outer_scope);
 
+    /**
+     * pc, instructions and constants of the current frame are cached here.
+     * pc is written back to the frame before an instruction body which may
+     * call a function or raise an exception. All of them are reloaded when an
+     * instruction changes the current frame. The handles are registered with
+     * nil because VAL2HDL returns NULL for undef.
+     */
+    YogHandle* h_frame = VAL2HDL(env, YNIL);
+    YogHandle* h_insts = VAL2HDL(env, YNIL);
+    YogHandle* h_consts = VAL2HDL(env, YNIL);
+    pc_t pc = 0;
+#if defined(PROFILE_INSTS)
+    uint_t prev_ops[2];
+#endif
+
     YogHandleScope inner_scope;
     YogJmpBuf jmpbuf;
     int_t status = setjmp(jmpbuf.buf);
@@ -843,7 +1033,6 @@ YogEval_mainloop(YogEnv* env)
                             YogVal thread = env->thread;
                             if (frame == PTR_AS(YogThread, thread)->frame_to_long_jump) {
                                 CUR_FRAME = frame;
-                                PC = SCRIPT_FRAME(CUR_FRAME)->pc;
                                 push_jmp_val(env);
                                 found = TRUE;
                             }
@@ -882,11 +1071,94 @@ YogEval_mainloop(YogEnv* env)
             break;
         }
     }
-
-    while (PC < PTR_AS(YogByteArray, CODE->insts)->size) {
-        YogHandleScope_OPEN(env, &inner_scope);
-#define CONSTS(index)   (YogValArray_at(env, CODE->consts, index))
-#define JUMP(m)         PC = m;
+    /**
+     * All instructions share inner_scope. Handles which an instruction
+     * registered are released at the end of the instruction by
+     * YogHandleScope_reset. A long jump closes inner_scope, so it is opened
+     * again here.
+     */
+    YogHandleScope_OPEN(env, &inner_scope);
+    LOAD_FRAME();
+
+#define CONSTS(index)   (YogValArray_at(env, HDL2VAL(h_consts), index))
+/**
+ * A backward jump is a safepoint, so that a loop without allocation does not
+ * keep other threads waiting for GC.
+ */
+#define JUMP(m)         do { \
+    pc_t dest_ = (m); \
+    if (dest_ < PC) { \
+        YogGC_SAFEPOINT(env); \
+    } \
+    PC = dest_; \
+} while (0)
+#define IS_FLOAT(v)     (IS_PTR(v) && (BASIC_OBJ_TYPE(v) == TYPE_FLOAT))
+/**
+ * Rewrites opcode of the current instruction. This works only in instructions
+ * without operands.
+ */
+#define QUICKEN(op)     INSTS_BYTES[PC - sizeof(uint8_t)] = OP(op)
+#define ADD_BODY() do { \
+    if (IS_FIXNUM(left) && IS_FIXNUM(right)) { \
+        int_t n = VAL2INT(left) + VAL2INT(right); \
+        push(env, FIXABLE(n) ? INT2VAL(n) : YogBignum_from_int(env, n)); \
+    } \
+    else if (IS_FIXNUM(left)) { \
+        YogHandle* h = YogHandle_REGISTER(env, right); \
+        push(env, YogFixnum_binop_add(env, left, h)); \
+    } \
+    else if (IS_PTR(left)) { \
+        if (BASIC_OBJ_TYPE(left) == TYPE_STRING) { \
+            YogHandle* x = YogHandle_REGISTER(env, left); \
+            YogHandle* y = YogHandle_REGISTER(env, right); \
+            push(env, YogString_binop_add(env, x, y)); \
+        } \
+        else if (BASIC_OBJ_TYPE(left) == TYPE_BIGNUM) { \
+            YogHandle* x = YogHandle_REGISTER(env, left); \
+            YogHandle* y = YogHandle_REGISTER(env, right); \
+            push(env, YogBignum_binop_add(env, x, y)); \
+        } \
+        else if (BASIC_OBJ_TYPE(left) == TYPE_FLOAT) { \
+            YogHandle* x = YogHandle_REGISTER(env, left); \
+            YogHandle* y = YogHandle_REGISTER(env, right); \
+            push(env, YogFloat_binop_add(env, x, y)); \
+        } \
+        else { \
+            exec_add(env, left, right); \
+        } \
+    } \
+    else { \
+        exec_add(env, left, right); \
+    } \
+} while (0)
+#define SUBTRACT_BODY() do { \
+    if (IS_FIXNUM(left) && IS_FIXNUM(right)) { \
+        int_t n = VAL2INT(left) - VAL2INT(right); \
+        push(env, FIXABLE(n) ? INT2VAL(n) : YogBignum_from_int(env, n)); \
+    } \
+    else if (IS_FIXNUM(left)) { \
+        YogHandle* h = YogHandle_REGISTER(env, right); \
+        push(env, YogFixnum_binop_subtract(env, left, h)); \
+    } \
+    else if (IS_PTR(left)) { \
+        if (BASIC_OBJ_TYPE(left) == TYPE_BIGNUM) { \
+            YogHandle* x = YogHandle_REGISTER(env, left); \
+            YogHandle* y = YogHandle_REGISTER(env, right); \
+            push(env, YogBignum_binop_subtract(env, x, y)); \
+        } \
+        else if (BASIC_OBJ_TYPE(left) == TYPE_FLOAT) { \
+            YogHandle* x = YogHandle_REGISTER(env, left); \
+            YogHandle* y = YogHandle_REGISTER(env, right); \
+            push(env, YogFloat_binop_subtract(env, x, y)); \
+        } \
+        else { \
+            exec_subtract(env, left, right); \
+        } \
+    } \
+    else { \
+        exec_subtract(env, left, right); \
+    } \
+} while (0)
 #define CMP_BODY(do_, exec) do { \
     if (IS_FIXNUM(left)) { \
         YogVal n = YogFixnum_binop_ufo(env, left, right); \
@@ -943,7 +1215,38 @@ YogEval_mainloop(YogEnv* env)
         exec(env, left, right); \
     } \
 } while (0)
-        OpCode op = (OpCode)PTR_AS(YogByteArray, CODE->insts)->items[PC];
+#if defined(USE_THREADED_CODE)
+#   define INST_LABEL(name)    L_##name
+#   define INST_BEGIN(name)    INST_LABEL(name):
+#   define DISPATCH()          do { \
+    YOG_ASSERT(env, pc < INSTS_SIZE, "pc is over code length."); \
+    OpCode op = (OpCode)INSTS_BYTES[pc]; \
+    YOG_ASSERT(env, op < array_sizeof(labels), "Unknown instruction (0x%08x)", op); \
+    COUNT_INST(op); \
+    pc += sizeof(uint8_t); \
+    goto *labels[op]; \
+} while (0)
+#   define INST_END            do { \
+    YogHandleScope_reset(env); \
+    SYNC_FRAME(); \
+    DISPATCH(); \
+} while (0)
+    static const void* labels[] = {
+#   include "eval_labels.inc"
+    };
+
+    DISPATCH();
+#   include "eval.inc"
+#   undef INST_END
+#   undef DISPATCH
+#   undef INST_BEGIN
+#   undef INST_LABEL
+#else
+#   define INST_BEGIN(name)    case OP(name):
+#   define INST_END            break
+    while (PC < INSTS_SIZE) {
+        OpCode op = (OpCode)INSTS_BYTES[PC];
+        COUNT_INST(op);
 
 #if 0
         do {
@@ -1001,17 +1304,32 @@ YogEval_mainloop(YogEnv* env)
 
         PC += sizeof(uint8_t);
         switch (op) {
-#include "eval.inc"
+#   include "eval.inc"
         default:
             YOG_BUG(env, "Unknown instruction (0x%08x)", op);
             break;
         }
+        YogHandleScope_reset(env);
+        SYNC_FRAME();
+    }
+#   undef INST_END
+#   undef INST_BEGIN
+#endif
 #undef EQUAL_BODY
 #undef CMP_BODY
+#undef ADD_BODY
+#undef SUBTRACT_BODY
+#undef QUICKEN
+#undef IS_FLOAT
 #undef JUMP
 #undef CONSTS
-        YogHandleScope_close(env);
-    }
+#undef SYNC_FRAME
+#undef LOAD_FRAME
+#undef RESET_INST_COUNT
+#undef COUNT_INST
+#undef SAVE_PC
+#undef INSTS_SIZE
+#undef INSTS_BYTES
 #undef CODE
 #undef PC
     YOG_BUG(env, "Exited mainloop");
@@ -1066,10 +1384,9 @@ YogEval_eval_package(YogEnv* env, YogHandle* pkg, YogVal code)
     RETURN_VOID(env);
 }
 
-static YogVal
-eval_stmts(YogEnv* env, YogHandle* filename, YogHandle* pkg_name, YogVal stmts)
+YogVal
+YogEval_eval_code(YogEnv* env, YogHandle* pkg_name, YogVal code)
 {
-    YogVal code = YogCompiler_compile_package(env, filename, stmts);
     YogHandle* h = VAL2HDL(env, code);
 
     YogHandle* pkg = VAL2HDL(env, YogPackage_new(env));
@@ -1078,6 +1395,13 @@ eval_stmts(YogEnv* env, YogHandle* filename, YogHandle* pkg_name, YogVal stmts)
     return HDL2VAL(pkg);
 }
 
+static YogVal
+eval_stmts(YogEnv* env, YogHandle* filename, YogHandle* pkg_name, YogVal stmts)
+{
+    YogVal code = YogCompiler_compile_package(env, filename, stmts);
+    return YogEval_eval_code(env, pkg_name, code);
+}
+
 YogVal
 YogEval_eval_stdin(YogEnv* env, YogHandle* filename, YogHandle* pkg_name)
 {
@@ -301,7 +301,7 @@ to_s(YogEnv* env, YogVal self, YogVal pkg, YogVal args, YogVal kw, YogVal block)
     YogGetArgs_parse_args(env, "to_s", params, args, kw);
 
     msg = PTR_AS(YogException, self)->message;
-    retval = YogEval_call_method(env, msg, "to_s", 0, NULL);
+    retval = YogEval_call_method_id(env, msg, env->vm->id_to_s, 0, NULL);
 
     RETURN(env, retval);
 }
@@ -39,10 +39,57 @@ typedef struct Lib Lib;
 
 #define TYPE_LIB TO_TYPE(Lib_alloc)
 
+typedef void (*DataWriter)(YogEnv*, void*, YogVal);
+typedef YogVal (*RvalueReader)(YogEnv*, YogHandle*, void*);
+
+enum ArgKind {
+    ARG_BUFFER,
+    ARG_DATA,
+    ARG_INT_P,
+    ARG_POINTER,
+    ARG_POINTER_P,
+    ARG_STRING,
+    ARG_STRUCT,
+};
+
+typedef enum ArgKind ArgKind;
+
+/**
+ * How to pass one argument. Plans are made once in load_func, so that
+ * LibFunc_do does not look up types at every call. offset is of the value in
+ * the argument block. int_p and pointer_p also have a place to be referred in
+ * the block at refered_offset.
+ */
+struct ArgPlan {
+    ArgKind kind;
+    DataWriter writer;
+    uint_t offset;
+    uint_t refered_offset;
+};
+
+typedef struct ArgPlan ArgPlan;
+
 struct LibFunc {
     struct YogBasicObj base;
     ffi_cif cif;
     void* f;
+    ArgPlan* plans;
+    /**
+     * Size of the argument block which is allocated on the stack at each call.
+     * It includes a place for the returned value at rvalue_offset.
+     */
+    uint_t block_size;
+    uint_t rvalue_offset;
+    RvalueReader read_rvalue;
+    /**
+     * TRUE when some arguments (int_p or pointer_p) are written back after a
+     * call.
+     */
+    BOOL read_back;
+    /**
+     * When TRUE, the function is called free from GC. See LibFunc_do.
+     */
+    BOOL blocking;
     YogVal rtype;
     uint_t nargs;
     YogVal nodes[0];
@@ -720,7 +767,7 @@ init_struct(YogEnv* env, YogVal obj, YogVal klass, ID name)
 
     PTR_AS(StructClass, obj)->size = 0;
     PTR_AS(StructClass, obj)->type = NULL;
-    YogGC_UPDATE_PTR(env, PTR_AS(YogClass, obj), super, env->vm->cStructBase);
+    YogClass_set_super(env, obj, env->vm->cStructBase);
 }
 
 static void
@@ -1819,6 +1866,7 @@ LibFunc_finalize(YogEnv* env, void* ptr)
 {
     LibFunc* f = (LibFunc*)ptr;
     YogGC_free(env, f->cif.arg_types, sizeof(*f->cif.arg_types) * f->nargs);
+    YogGC_free(env, f->plans, sizeof(ArgPlan) * f->nargs);
 }
 
 static void
@@ -1846,7 +1894,13 @@ LibFunc_new(YogEnv* env, uint_t nargs)
     obj = ALLOC_OBJ_ITEM(env, LibFunc_keep_children, LibFunc_finalize, LibFunc, nargs, YogVal);
     YogBasicObj_init(env, obj, TYPE_LIB_FUNC, 0, env->vm->cLibFunc);
     PTR_AS(LibFunc, obj)->f = NULL;
+    PTR_AS(LibFunc, obj)->blocking = FALSE;
     PTR_AS(LibFunc, obj)->cif.arg_types = NULL;
+    PTR_AS(LibFunc, obj)->plans = NULL;
+    PTR_AS(LibFunc, obj)->block_size = 0;
+    PTR_AS(LibFunc, obj)->rvalue_offset = 0;
+    PTR_AS(LibFunc, obj)->read_rvalue = NULL;
+    PTR_AS(LibFunc, obj)->read_back = FALSE;
     PTR_AS(LibFunc, obj)->rtype = YUNDEF;
     PTR_AS(LibFunc, obj)->nargs = nargs;
     uint_t i;
@@ -1930,6 +1984,8 @@ rtype2node(YogEnv* env, YogVal rtype)
     RETURN(env, parse_type(env, rtype));
 }
 
+static void plan_call(YogEnv*, YogVal);
+
 static YogVal
 load_func(YogEnv* env, YogVal self, YogVal pkg, YogVal args, YogVal kw, YogVal block)
 {
@@ -1940,12 +1996,14 @@ load_func(YogEnv* env, YogVal self, YogVal pkg, YogVal args, YogVal kw, YogVal b
     YogVal rtype = YNIL;
     YogVal arg_type = YUNDEF;
     YogVal node = YUNDEF;
-    PUSH_LOCALS6(env, f, name, arg_types, rtype, arg_type, node);
+    YogVal blocking = YFALSE;
+    PUSH_LOCALS7(env, f, name, arg_types, rtype, arg_type, node, blocking);
     YogCArg params[] = {
         { "name", &name },
         { "|", NULL },
         { "arg_types", &arg_types },
         { "rtype", &rtype },
+        { "blocking", &blocking },
         { NULL, NULL } };
     YogGetArgs_parse_args(env, "load_func", params, args, kw);
     if (!IS_PTR(self) || (BASIC_OBJ_TYPE(self) != TYPE_LIB)) {
@@ -1987,6 +2045,8 @@ load_func(YogEnv* env, YogVal self, YogVal pkg, YogVal args, YogVal kw, YogVal b
         YogError_raise_FFIError(env, "Can't find address of %S", name);
     }
     PTR_AS(LibFunc, f)->f = p;
+    PTR_AS(LibFunc, f)->blocking = YOG_TEST(blocking);
+    plan_call(env, f);
 
     RETURN(env, f);
 }
@@ -2609,80 +2669,89 @@ write_int(YogEnv* env, void* dest, YogVal val)
     RETURN_VOID(env);
 }
 
-static BOOL
-write_data(YogEnv* env, void* dest, ID type, YogVal val)
+static DataWriter
+find_data_writer(YogEnv* env, ID type)
 {
-    SAVE_ARG(env, val);
     const char* s = BINARY_CSTR(YogVM_id2bin(env, env->vm, type));
     if (strcmp(s, "uint8") == 0) {
-        write_uint8(env, dest, val);
+        return write_uint8;
     }
-    else if (strcmp(s, "int8") == 0) {
-        write_int8(env, dest, val);
+    if (strcmp(s, "int8") == 0) {
+        return write_int8;
     }
-    else if (strcmp(s, "uint16") == 0) {
-        write_uint16(env, dest, val);
+    if (strcmp(s, "uint16") == 0) {
+        return write_uint16;
     }
-    else if (strcmp(s, "int16") == 0) {
-        write_int16(env, dest, val);
+    if (strcmp(s, "int16") == 0) {
+        return write_int16;
     }
-    else if (strcmp(s, "uint32") == 0) {
-        write_uint32(env, dest, val);
+    if (strcmp(s, "uint32") == 0) {
+        return write_uint32;
     }
-    else if (strcmp(s, "int32") == 0) {
-        write_int32(env, dest, val);
+    if (strcmp(s, "int32") == 0) {
+        return write_int32;
     }
-    else if (strcmp(s, "uint64") == 0) {
-        write_uint64(env, dest, val);
+    if (strcmp(s, "uint64") == 0) {
+        return write_uint64;
     }
-    else if (strcmp(s, "int64") == 0) {
-        write_int64(env, dest, val);
+    if (strcmp(s, "int64") == 0) {
+        return write_int64;
     }
-    else if (strcmp(s, "float") == 0) {
-        write_float(env, dest, val);
+    if (strcmp(s, "float") == 0) {
+        return write_float;
     }
-    else if (strcmp(s, "double") == 0) {
-        write_double(env, dest, val);
+    if (strcmp(s, "double") == 0) {
+        return write_double;
     }
-    else if (strcmp(s, "uchar") == 0) {
-        write_uchar(env, dest, val);
+    if (strcmp(s, "uchar") == 0) {
+        return write_uchar;
     }
-    else if (strcmp(s, "char") == 0) {
-        write_char(env, dest, val);
+    if (strcmp(s, "char") == 0) {
+        return write_char;
     }
-    else if (strcmp(s, "ushort") == 0) {
-        write_ushort(env, dest, val);
+    if (strcmp(s, "ushort") == 0) {
+        return write_ushort;
     }
-    else if (strcmp(s, "short") == 0) {
-        write_short(env, dest, val);
+    if (strcmp(s, "short") == 0) {
+        return write_short;
     }
-    else if (strcmp(s, "uint") == 0) {
-        write_uint(env, dest, val);
+    if (strcmp(s, "uint") == 0) {
+        return write_uint;
     }
-    else if (strcmp(s, "int") == 0) {
-        write_int(env, dest, val);
+    if (strcmp(s, "int") == 0) {
+        return write_int;
     }
-    else if (strcmp(s, "ulong") == 0) {
-        write_ulong(env, dest, val);
+    if (strcmp(s, "ulong") == 0) {
+        return write_ulong;
     }
-    else if (strcmp(s, "long") == 0) {
-        write_long(env, dest, val);
+    if (strcmp(s, "long") == 0) {
+        return write_long;
     }
-    else if (strcmp(s, "ulonglong") == 0) {
-        write_ulonglong(env, dest, val);
+    if (strcmp(s, "ulonglong") == 0) {
+        return write_ulonglong;
     }
-    else if (strcmp(s, "longlong") == 0) {
-        write_longlong(env, dest, val);
+    if (strcmp(s, "longlong") == 0) {
+        return write_longlong;
     }
-    else if (strcmp(s, "longdouble") == 0) {
-        write_long_double(env, dest, val);
+    if (strcmp(s, "longdouble") == 0) {
+        return write_long_double;
     }
-    else if (strcmp(s, "pointer") == 0) {
-        write_pointer(env, dest, val);
+    if (strcmp(s, "pointer") == 0) {
+        return write_pointer;
     }
-    else {
+
+    return NULL;
+}
+
+static BOOL
+write_data(YogEnv* env, void* dest, ID type, YogVal val)
+{
+    SAVE_ARG(env, val);
+    DataWriter writer = find_data_writer(env, type);
+    if (writer == NULL) {
         RETURN(env, FALSE);
     }
+    writer(env, dest, val);
     RETURN(env, TRUE);
 }
 
@@ -2735,54 +2804,6 @@ write_argument_struct(YogEnv* env, void* pvalue, YogVal klass, YogVal val)
     memcpy(pvalue, data, PTR_AS(StructClass, klass)->size);
 }
 
-static void
-write_argument(YogEnv* env, void* pvalue, void* refered, YogVal node, YogVal val)
-{
-    SAVE_ARGS2(env, node, val);
-    YogVal encoding;
-    YogVal klass;
-    switch (PTR_AS(Node, node)->type) {
-    case NODE_ATOM:
-        break;
-    case NODE_BUFFER:
-        write_argument_Buffer(env, pvalue, val);
-        RETURN_VOID(env);
-    case NODE_POINTER:
-        klass = PTR_AS(Node, node)->u.pointer.klass;
-        write_argument_pointer(env, pvalue, klass, val);
-        RETURN_VOID(env);
-    case NODE_STRING:
-        encoding = PTR_AS(Node, node)->u.string.encoding;
-        write_argument_string(env, pvalue, refered, encoding, val);
-        RETURN_VOID(env);
-    case NODE_STRUCT:
-        klass = PTR_AS(Node, node)->u.struct_.klass;
-        write_argument_struct(env, pvalue, klass, val);
-        RETURN_VOID(env);
-    case NODE_ARRAY:
-    case NODE_FIELD:
-    default:
-        YOG_BUG(env, "Invalid Node type (%u)", PTR_AS(Node, node)->type);
-    }
-
-    ID name = PTR_AS(Node, node)->u.atom.type;
-    if (write_data(env, pvalue, name, val)) {
-        RETURN_VOID(env);
-    }
-    const char* s = BINARY_CSTR(YogVM_id2bin(env, env->vm, name));
-    if (strcmp(s, "int_p") == 0) {
-        Int_write(env, val, (int*)refered);
-    }
-    else if (strcmp(s, "pointer_p") == 0) {
-        Pointer_write(env, val, (void**)refered);
-    }
-    else {
-        YogError_raise_ValueError(env, "Unknown argument type - %I", name);
-    }
-    *((void**)pvalue) = refered;
-    RETURN_VOID(env);
-}
-
 static uint_t
 type2refered_size_of_string(YogEnv* env, YogVal node, YogVal arg)
 {
@@ -2794,35 +2815,6 @@ type2refered_size_of_string(YogEnv* env, YogVal node, YogVal arg)
     return PTR_AS(YogEncoding, enc)->max_size * STRING_SIZE(arg) + 1;
 }
 
-static uint_t
-type2refered_size(YogEnv* env, YogVal node, YogVal arg)
-{
-    switch (PTR_AS(Node, node)->type) {
-    case NODE_ATOM:
-        break;
-    case NODE_BUFFER:
-    case NODE_POINTER:
-    case NODE_STRUCT:
-        return 0;
-    case NODE_STRING:
-        return type2refered_size_of_string(env, node, arg);
-    case NODE_ARRAY:
-    case NODE_FIELD:
-    default:
-        YOG_BUG(env, "Invalid Node type (%u)", PTR_AS(Node, node)->type);
-    }
-
-    ID name = PTR_AS(Node, node)->u.atom.type;
-    const char* s = BINARY_CSTR(YogVM_id2bin(env, env->vm, name));
-    if (strcmp(s, "int_p") == 0) {
-        return sizeof(int);
-    }
-    if (strcmp(s, "pointer_p") == 0) {
-        return sizeof(void*);
-    }
-    return 0;
-}
-
 static void
 read_argument_pointer(YogEnv* env, YogVal obj, void* ptr)
 {
@@ -2845,41 +2837,6 @@ read_argument_int(YogEnv* env, YogVal obj, int n)
     RETURN_VOID(env);
 }
 
-static void
-read_argument(YogEnv* env, YogVal obj, YogVal node, void* p)
-{
-    SAVE_ARGS2(env, obj, node);
-    if (p == NULL) {
-        RETURN_VOID(env);
-    }
-    switch (PTR_AS(Node, node)->type) {
-    case NODE_ATOM:
-        break;
-    case NODE_BUFFER:
-    case NODE_POINTER:
-    case NODE_STRING:
-        RETURN_VOID(env);
-    case NODE_ARRAY:
-    case NODE_FIELD:
-    case NODE_STRUCT:
-    default:
-        YOG_BUG(env, "Invalid Node type (%u)", PTR_AS(Node, node)->type);
-    }
-
-    ID name = PTR_AS(Node, node)->u.atom.type;
-    YogVal s = YogVM_id2bin(env, env->vm, name);
-    if (strcmp(BINARY_CSTR(s), "int_p") == 0) {
-        read_argument_int(env, obj, *((int*)p));
-        RETURN_VOID(env);
-    }
-    if (strcmp(BINARY_CSTR(s), "pointer_p") == 0) {
-        read_argument_pointer(env, obj, *((void**)p));
-        RETURN_VOID(env);
-    }
-    YogError_raise_ValueError(env, "Unknown type - %I", name);
-    RETURN_VOID(env);
-}
-
 static const char*
 NodeType_to_s(YogEnv* env, NodeType type)
 {
@@ -2973,107 +2930,341 @@ get_posarg_at(YogEnv* env, uint_t i, uint8_t posargc, YogHandle* posargs[], YogH
     return YogArray_at(env, HDL2VAL(vararg), i - posargc);
 }
 
+#define DEFINE_RVALUE_READER(name, type, conv) \
+    static YogVal \
+    name(YogEnv* env, YogHandle* callee, void* rvalue) \
+    { \
+        return conv(env, *((type*)rvalue)); \
+    }
+
+DEFINE_RVALUE_READER(read_rvalue_uint8, uint8_t, YogVal_from_unsigned_int)
+DEFINE_RVALUE_READER(read_rvalue_sint8, int8_t, YogVal_from_int)
+DEFINE_RVALUE_READER(read_rvalue_uint16, uint16_t, YogVal_from_unsigned_int)
+DEFINE_RVALUE_READER(read_rvalue_sint16, int16_t, YogVal_from_int)
+DEFINE_RVALUE_READER(read_rvalue_uint32, uint32_t, YogVal_from_unsigned_int)
+DEFINE_RVALUE_READER(read_rvalue_sint32, int32_t, YogVal_from_int)
+DEFINE_RVALUE_READER(read_rvalue_uint64, uint64_t, YogVal_from_unsigned_long_long)
+DEFINE_RVALUE_READER(read_rvalue_sint64, int64_t, YogVal_from_long_long)
+DEFINE_RVALUE_READER(read_rvalue_float, float, YogFloat_from_float)
+DEFINE_RVALUE_READER(read_rvalue_double, double, YogFloat_from_float)
+DEFINE_RVALUE_READER(read_rvalue_uchar, unsigned char, YogVal_from_unsigned_int)
+DEFINE_RVALUE_READER(read_rvalue_schar, signed char, YogVal_from_int)
+DEFINE_RVALUE_READER(read_rvalue_ushort, unsigned short, YogVal_from_unsigned_int)
+DEFINE_RVALUE_READER(read_rvalue_sshort, short, YogVal_from_int)
+DEFINE_RVALUE_READER(read_rvalue_uint, unsigned int, YogVal_from_unsigned_int)
+DEFINE_RVALUE_READER(read_rvalue_sint, int, YogVal_from_int)
+DEFINE_RVALUE_READER(read_rvalue_ulong, unsigned long, YogVal_from_unsigned_int)
+DEFINE_RVALUE_READER(read_rvalue_slong, long, YogVal_from_int)
+DEFINE_RVALUE_READER(read_rvalue_longdouble, long double, YogFloat_from_float)
+
+#undef DEFINE_RVALUE_READER
+
 static YogVal
-LibFunc_do(YogEnv* env, YogHandle* callee, uint8_t posargc, YogHandle* posargs[], uint8_t kwargc, YogHandle* kwargs[], YogHandle* vararg, YogHandle* varkwarg, YogHandle* blockarg)
+read_rvalue_pointer(YogEnv* env, YogHandle* callee, void* rvalue)
 {
-    uint_t nargs = HDL_AS(LibFunc, callee)->nargs;
-    if (compute_args_num(env, posargc, vararg) != nargs) {
-        const char* fmt = "%u positional argument(s) required, not %u";
-        YogError_raise_ValueError(env, fmt, nargs, posargc);
-        /* NOTREACHED */
-    }
-    void** values = (void**)YogSysdeps_alloca(sizeof(void*) * nargs);
-    void** refereds = (void**)YogSysdeps_alloca(sizeof(void*) * nargs);
-    ffi_type** arg_types = HDL_AS(LibFunc, callee)->cif.arg_types;
-    uint_t i;
-    for (i = 0; i < nargs; i++) {
-        ffi_type* ffi_arg_type = arg_types[i];
-        YogVal val = get_posarg_at(env, i, posargc, posargs, vararg);
-        YogHandle* h_val = VAL2HDL(env, val);
-        YogVal node = HDL_AS(LibFunc, callee)->nodes[i];
-        YogHandle* h_node = VAL2HDL(env, node);
-        uint_t size = type2size(env, ffi_arg_type, node);
-        void* pvalue = YogSysdeps_alloca(size);
-        uint_t refered_size = type2refered_size(env, node, val);
-        void* refered = 0 < refered_size ? YogSysdeps_alloca(refered_size): NULL;
-        write_argument(env, pvalue, refered, HDL2VAL(h_node), HDL2VAL(h_val));
-        values[i] = pvalue;
-        refereds[i] = refered;
-    }
-
-    ffi_type* rtype = HDL_AS(LibFunc, callee)->cif.rtype;
-    void* rvalue = rtype != &ffi_type_void ? YogSysdeps_alloca(type2size(env, rtype, PTR_AS(LibFunc, callee)->rtype)) : NULL;
-
-    ffi_call(&HDL_AS(LibFunc, callee)->cif, HDL_AS(LibFunc, callee)->f, rvalue, values);
+    return create_ptr_retval(env, callee, *((void**)rvalue));
+}
 
-    for (i = 0; i < nargs; i++) {
-        YogVal node = HDL_AS(LibFunc, callee)->nodes[i];
-        YogVal val = get_posarg_at(env, i, posargc, posargs, vararg);
-        read_argument(env, val, node, refereds[i]);
-    }
+static YogVal
+read_rvalue_void(YogEnv* env, YogHandle* callee, void* rvalue)
+{
+    return YNIL;
+}
 
+static RvalueReader
+find_rvalue_reader(YogEnv* env, ffi_type* rtype)
+{
     if (rtype == &ffi_type_uint8) {
-        return YogVal_from_unsigned_int(env, *((uint8_t*)rvalue));
+        return read_rvalue_uint8;
     }
     if (rtype == &ffi_type_sint8) {
-        return YogVal_from_int(env, *((int8_t*)rvalue));
+        return read_rvalue_sint8;
     }
     if (rtype == &ffi_type_uint16) {
-        return YogVal_from_unsigned_int(env, *((uint16_t*)rvalue));
+        return read_rvalue_uint16;
     }
     if (rtype == &ffi_type_sint16) {
-        return YogVal_from_int(env, *((int16_t*)rvalue));
+        return read_rvalue_sint16;
     }
     if (rtype == &ffi_type_uint32) {
-        return YogVal_from_unsigned_int(env, *((uint32_t*)rvalue));
+        return read_rvalue_uint32;
     }
     if (rtype == &ffi_type_sint32) {
-        return YogVal_from_int(env, *((int32_t*)rvalue));
+        return read_rvalue_sint32;
     }
     if (rtype == &ffi_type_uint64) {
-        return YogVal_from_unsigned_long_long(env, *((uint64_t*)rvalue));
+        return read_rvalue_uint64;
     }
     if (rtype == &ffi_type_sint64) {
-        return YogVal_from_long_long(env, *((int64_t*)rvalue));
+        return read_rvalue_sint64;
     }
     if (rtype == &ffi_type_float) {
-        return YogFloat_from_float(env, *((float*)rvalue));
+        return read_rvalue_float;
     }
     if (rtype == &ffi_type_double) {
-        return YogFloat_from_float(env, *((double*)rvalue));
+        return read_rvalue_double;
     }
     if (rtype == &ffi_type_uchar) {
-        return YogVal_from_unsigned_int(env, *((unsigned char*)rvalue));
+        return read_rvalue_uchar;
     }
     if (rtype == &ffi_type_schar) {
-        return YogVal_from_int(env, *((signed char*)rvalue));
+        return read_rvalue_schar;
     }
     if (rtype == &ffi_type_ushort) {
-        return YogVal_from_unsigned_int(env, *((unsigned short*)rvalue));
+        return read_rvalue_ushort;
     }
     if (rtype == &ffi_type_sshort) {
-        return YogVal_from_int(env, *((short*)rvalue));
+        return read_rvalue_sshort;
     }
     if (rtype == &ffi_type_uint) {
-        return YogVal_from_unsigned_int(env, *((unsigned int*)rvalue));
+        return read_rvalue_uint;
     }
     if (rtype == &ffi_type_sint) {
-        return YogVal_from_int(env, *((int*)rvalue));
+        return read_rvalue_sint;
     }
     if (rtype == &ffi_type_ulong) {
-        return YogVal_from_unsigned_int(env, *((unsigned long*)rvalue));
+        return read_rvalue_ulong;
     }
     if (rtype == &ffi_type_slong) {
-        return YogVal_from_int(env, *((long*)rvalue));
+        return read_rvalue_slong;
     }
     if (rtype == &ffi_type_longdouble) {
-        return YogFloat_from_float(env, *((long double*)rvalue));
+        return read_rvalue_longdouble;
     }
     if (rtype == &ffi_type_pointer) {
-        return create_ptr_retval(env, callee, *((void**)rvalue));
+        return read_rvalue_pointer;
     }
+    return read_rvalue_void;
+}
 
-    return YNIL;
+/**
+ * Every place in the argument block is aligned to this not to break
+ * alignment of long double and structs.
+ */
+#define ARG_BLOCK_ALIGNMENT 16
+
+static uint_t
+reserve_in_block(uint_t* block_size, uint_t size)
+{
+    uint_t offset = *block_size;
+    uint_t n = ARG_BLOCK_ALIGNMENT;
+    *block_size = (offset + size + n - 1) / n * n;
+    return offset;
+}
+
+static void
+plan_atom(YogEnv* env, ArgPlan* plan, YogVal node, uint_t* block_size)
+{
+    ID type = PTR_AS(Node, node)->u.atom.type;
+    DataWriter writer = find_data_writer(env, type);
+    if (writer != NULL) {
+        plan->kind = ARG_DATA;
+        plan->writer = writer;
+        return;
+    }
+    const char* s = BINARY_CSTR(YogVM_id2bin(env, env->vm, type));
+    if (strcmp(s, "int_p") == 0) {
+        plan->kind = ARG_INT_P;
+        plan->refered_offset = reserve_in_block(block_size, sizeof(int));
+        return;
+    }
+    if (strcmp(s, "pointer_p") == 0) {
+        plan->kind = ARG_POINTER_P;
+        plan->refered_offset = reserve_in_block(block_size, sizeof(void*));
+        return;
+    }
+    YogError_raise_ValueError(env, "Unknown argument type - %I", type);
+}
+
+static ArgKind
+node2kind(YogEnv* env, YogVal node)
+{
+    switch (PTR_AS(Node, node)->type) {
+    case NODE_BUFFER:
+        return ARG_BUFFER;
+    case NODE_POINTER:
+        return ARG_POINTER;
+    case NODE_STRING:
+        return ARG_STRING;
+    case NODE_STRUCT:
+        return ARG_STRUCT;
+    case NODE_ATOM:
+    case NODE_ARRAY:
+    case NODE_FIELD:
+    default:
+        YOG_BUG(env, "Invalid Node type (%u)", PTR_AS(Node, node)->type);
+    }
+
+    return ARG_DATA;
+}
+
+static void
+plan_call(YogEnv* env, YogVal f)
+{
+    SAVE_ARG(env, f);
+    YogVal node = YUNDEF;
+    PUSH_LOCAL(env, node);
+
+    uint_t nargs = PTR_AS(LibFunc, f)->nargs;
+    ArgPlan* plans = (ArgPlan*)YogGC_malloc(env, sizeof(ArgPlan) * nargs);
+    PTR_AS(LibFunc, f)->plans = plans;
+    ffi_type** arg_types = PTR_AS(LibFunc, f)->cif.arg_types;
+    uint_t block_size = 0;
+    BOOL read_back = FALSE;
+    uint_t i;
+    for (i = 0; i < nargs; i++) {
+        ArgPlan* plan = &plans[i];
+        node = PTR_AS(LibFunc, f)->nodes[i];
+        uint_t size = type2size(env, arg_types[i], node);
+        plan->offset = reserve_in_block(&block_size, size);
+        plan->writer = NULL;
+        plan->refered_offset = 0;
+        if (PTR_AS(Node, node)->type == NODE_ATOM) {
+            plan_atom(env, plan, node, &block_size);
+        }
+        else {
+            plan->kind = node2kind(env, node);
+        }
+        if ((plan->kind == ARG_INT_P) || (plan->kind == ARG_POINTER_P)) {
+            read_back = TRUE;
+        }
+    }
+
+    ffi_type* rtype = PTR_AS(LibFunc, f)->cif.rtype;
+    if (rtype != &ffi_type_void) {
+        node = PTR_AS(LibFunc, f)->rtype;
+        /**
+         * libffi writes a returned integer as a whole ffi_arg even if it is
+         * narrower.
+         */
+        uint_t size = type2size(env, rtype, node);
+        size = size < sizeof(ffi_arg) ? sizeof(ffi_arg) : size;
+        PTR_AS(LibFunc, f)->rvalue_offset = reserve_in_block(&block_size, size);
+    }
+    PTR_AS(LibFunc, f)->block_size = block_size;
+    PTR_AS(LibFunc, f)->read_rvalue = find_rvalue_reader(env, rtype);
+    PTR_AS(LibFunc, f)->read_back = read_back;
+
+    RETURN_VOID(env);
+}
+
+static void
+write_planned_argument(YogEnv* env, ArgPlan* plan, void* pvalue, void* refered, YogVal node, YogVal val)
+{
+    SAVE_ARGS2(env, node, val);
+    YogVal encoding;
+    YogVal klass;
+    switch (plan->kind) {
+    case ARG_DATA:
+        plan->writer(env, pvalue, val);
+        break;
+    case ARG_INT_P:
+        Int_write(env, val, (int*)refered);
+        *((void**)pvalue) = refered;
+        break;
+    case ARG_POINTER_P:
+        Pointer_write(env, val, (void**)refered);
+        *((void**)pvalue) = refered;
+        break;
+    case ARG_BUFFER:
+        write_argument_Buffer(env, pvalue, val);
+        break;
+    case ARG_POINTER:
+        klass = PTR_AS(Node, node)->u.pointer.klass;
+        write_argument_pointer(env, pvalue, klass, val);
+        break;
+    case ARG_STRING:
+        encoding = PTR_AS(Node, node)->u.string.encoding;
+        write_argument_string(env, pvalue, refered, encoding, val);
+        break;
+    case ARG_STRUCT:
+        klass = PTR_AS(Node, node)->u.struct_.klass;
+        write_argument_struct(env, pvalue, klass, val);
+        break;
+    default:
+        YOG_BUG(env, "Invalid argument kind (%u)", plan->kind);
+        break;
+    }
+    RETURN_VOID(env);
+}
+
+static void
+read_back_arguments(YogEnv* env, YogHandle* callee, char* block, uint8_t posargc, YogHandle* posargs[], YogHandle* vararg)
+{
+    ArgPlan* plans = HDL_AS(LibFunc, callee)->plans;
+    uint_t nargs = HDL_AS(LibFunc, callee)->nargs;
+    uint_t i;
+    for (i = 0; i < nargs; i++) {
+        ArgPlan* plan = &plans[i];
+        void* refered = block + plan->refered_offset;
+        YogVal val;
+        switch (plan->kind) {
+        case ARG_INT_P:
+            val = get_posarg_at(env, i, posargc, posargs, vararg);
+            read_argument_int(env, val, *((int*)refered));
+            break;
+        case ARG_POINTER_P:
+            val = get_posarg_at(env, i, posargc, posargs, vararg);
+            read_argument_pointer(env, val, *((void**)refered));
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static YogVal
+LibFunc_do(YogEnv* env, YogHandle* callee, uint8_t posargc, YogHandle* posargs[], uint8_t kwargc, YogHandle* kwargs[], YogHandle* vararg, YogHandle* varkwarg, YogHandle* blockarg)
+{
+    uint_t nargs = HDL_AS(LibFunc, callee)->nargs;
+    if (compute_args_num(env, posargc, vararg) != nargs) {
+        const char* fmt = "%u positional argument(s) required, not %u";
+        YogError_raise_ValueError(env, fmt, nargs, posargc);
+        /* NOTREACHED */
+    }
+    /**
+     * plans are outside the GC heap, so they never move even if callee moves.
+     */
+    ArgPlan* plans = HDL_AS(LibFunc, callee)->plans;
+    char* block = (char*)YogSysdeps_alloca(HDL_AS(LibFunc, callee)->block_size);
+    void** values = (void**)YogSysdeps_alloca(sizeof(void*) * nargs);
+    uint_t i;
+    for (i = 0; i < nargs; i++) {
+        ArgPlan* plan = &plans[i];
+        YogVal val = get_posarg_at(env, i, posargc, posargs, vararg);
+        YogVal node = HDL_AS(LibFunc, callee)->nodes[i];
+        void* refered = block + plan->refered_offset;
+        if (plan->kind == ARG_STRING) {
+            uint_t size = type2refered_size_of_string(env, node, val);
+            refered = 0 < size ? YogSysdeps_alloca(size) : NULL;
+        }
+        void* pvalue = block + plan->offset;
+        write_planned_argument(env, plan, pvalue, refered, node, val);
+        values[i] = pvalue;
+    }
+
+    void* rvalue = block + HDL_AS(LibFunc, callee)->rvalue_offset;
+
+    if (HDL_AS(LibFunc, callee)->blocking) {
+        /**
+         * All arguments are already outside the GC heap. Strings were copied
+         * to the stack, and Buffer and Struct hold malloc'ed memory. But
+         * LibFunc itself may move while this thread is free from GC, so the
+         * call interface is copied too.
+         */
+        ffi_cif cif = HDL_AS(LibFunc, callee)->cif;
+        void* f = HDL_AS(LibFunc, callee)->f;
+        YogGC_BLOCKING_REGION(env, ffi_call(&cif, f, rvalue, values));
+    }
+    else {
+        ffi_call(&HDL_AS(LibFunc, callee)->cif, HDL_AS(LibFunc, callee)->f, rvalue, values);
+    }
+
+    if (HDL_AS(LibFunc, callee)->read_back) {
+        read_back_arguments(env, callee, block, posargc, posargs, vararg);
+    }
+
+    return HDL_AS(LibFunc, callee)->read_rvalue(env, callee, rvalue);
 }
 
 static YogVal
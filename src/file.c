@@ -16,6 +16,7 @@
 #include "yog/object.h"
 #include "yog/string.h"
 #include "yog/string.h"
+#include "yog/sysdeps.h"
 #include "yog/thread.h"
 #include "yog/vm.h"
 #include "yog/yog.h"
@@ -66,16 +67,28 @@ YogFile_new(YogEnv* env, FILE* fp)
     return file;
 }
 
+/**
+ * Functions in this file call stdio in blocking regions (see
+ * YogGC_BLOCKING_REGION), so that a slow device does not stop GC of other
+ * threads. Data are copied between the GC heap and a buffer on the C stack.
+ */
+
 static void
-write_binary(YogEnv* env, YogHandle* self, YogVal val)
+write_binary(YogEnv* env, YogHandle* self, YogHandle* bin, uint_t size)
 {
     FILE* fp = HDL_AS(YogFile, self)->fp;
-    uint_t rest = BINARY_SIZE(val);
-    const char* p = BINARY_CSTR(val);
-    while (0 < rest) {
-        uint_t size = fwrite(p, 1, rest, fp);
-        rest -= size;
-        p += size;
+    char buffer[4096];
+    uint_t pos = 0;
+    while (pos < size) {
+        uint_t rest = size - pos;
+        uint_t n = rest < array_sizeof(buffer) ? rest : array_sizeof(buffer);
+        memcpy(buffer, &BINARY_CSTR(HDL2VAL(bin))[pos], n);
+        uint_t written;
+        YogGC_BLOCKING_REGION(env, written = fwrite(buffer, 1, n, fp));
+        if ((written < n) && ferror(fp)) {
+            YogError_raise_sys_err(env, errno, YUNDEF);
+        }
+        pos += written;
     }
 }
 
@@ -83,7 +96,8 @@ static uint_t
 read_binary_to_append(YogEnv* env, YogHandle* bin, FILE* fp, size_t size)
 {
     char buffer[size];
-    size_t nbytes = fread(buffer, sizeof(buffer[0]), size, fp);
+    size_t nbytes;
+    YogGC_BLOCKING_REGION(env, nbytes = fread(buffer, sizeof(buffer[0]), size, fp));
     if (ferror(fp)) {
         YogError_raise_sys_err(env, errno, YUNDEF);
     }
@@ -127,20 +141,27 @@ read_binary(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* size)
 }
 
 static void
-do_unlock(YogEnv* env, YogHandle* self)
+do_flock(YogEnv* env, YogHandle* self, int operation)
 {
-    if (flock(fileno(HDL_AS(YogFile, self)->fp), LOCK_UN) != 0) {
+    int fd = fileno(HDL_AS(YogFile, self)->fp);
+    int retval;
+    YogGC_BLOCKING_REGION(env, retval = flock(fd, operation));
+    if (retval != 0) {
         YogError_raise_sys_err(env, errno, YUNDEF);
     }
 }
 
+static void
+do_unlock(YogEnv* env, YogHandle* self)
+{
+    do_flock(env, self, LOCK_UN);
+}
+
 static YogVal
 do_lock(YogEnv* env, YogHandle* self, YogHandle* block, int operation)
 {
     CHECK_SELF_TYPE2(env, self);
-    if (flock(fileno(HDL_AS(YogFile, self)->fp), operation) != 0) {
-        YogError_raise_sys_err(env, errno, YUNDEF);
-    }
+    do_flock(env, self, operation);
 
     YogJmpBuf jmpbuf;
     int_t status = setjmp(jmpbuf.buf);
@@ -177,7 +198,10 @@ static YogVal
 flush(YogEnv* env, YogHandle* self, YogHandle* pkg)
 {
     CHECK_SELF_TYPE2(env, self);
-    if (fflush(HDL_AS(YogFile, self)->fp) != 0) {
+    FILE* fp = HDL_AS(YogFile, self)->fp;
+    int retval;
+    YogGC_BLOCKING_REGION(env, retval = fflush(fp));
+    if (retval != 0) {
         YogError_raise_sys_err(env, errno, YUNDEF);
     }
     return HDL2VAL(self);
@@ -197,7 +221,7 @@ write_(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* data)
         RAISE_TYPE_ERROR;
     }
     if (BASIC_OBJ_TYPE(val) == TYPE_BINARY) {
-        write_binary(env, self, val);
+        write_binary(env, self, data, BINARY_SIZE(val));
         return HDL2VAL(self);
     }
     if (BASIC_OBJ_TYPE(val) != TYPE_STRING) {
@@ -205,8 +229,8 @@ write_(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* data)
     }
 #undef RAISE_TYPE_ERROR
 
-    YogVal bin = YogString_to_bin_in_default_encoding(env, data);
-    fputs(BINARY_CSTR(bin), HDL_AS(YogFile, self)->fp);
+    YogHandle* bin = VAL2HDL(env, YogString_to_bin_in_default_encoding(env, data));
+    write_binary(env, self, bin, strlen(BINARY_CSTR(HDL2VAL(bin))));
 
     return HDL2VAL(self);
 }
@@ -214,14 +238,16 @@ write_(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* data)
 static uint_t
 read_to_append(YogEnv* env, YogVal s, FILE* fp, size_t size)
 {
+    SAVE_ARG(env, s);
     char buffer[size + 1];
-    uint_t nbytes = fread(buffer, sizeof(buffer[0]), size, fp);
+    uint_t nbytes;
+    YogGC_BLOCKING_REGION(env, nbytes = fread(buffer, sizeof(buffer[0]), size, fp));
     if (ferror(fp)) {
         YogError_raise_sys_err(env, errno, YNIL);
     }
     buffer[nbytes] = '\0';
     YogString_append_string(env, s, buffer);
-    return nbytes;
+    RETURN(env, nbytes);
 }
 
 static YogVal
@@ -281,11 +307,16 @@ read_(YogEnv* env, YogVal self, YogVal pkg, YogVal args, YogVal kw, YogVal block
 static void
 do_close(YogEnv* env, YogVal self)
 {
-    if (fclose(PTR_AS(YogFile, self)->fp) == 0) {
+    SAVE_ARG(env, self);
+    FILE* fp = PTR_AS(YogFile, self)->fp;
+    int retval;
+    YogGC_BLOCKING_REGION(env, retval = fclose(fp));
+    if (retval == 0) {
         PTR_AS(YogFile, self)->fp = NULL;
-        return;
+        RETURN_VOID(env);
     }
     YogError_raise_sys_err(env, errno, YUNDEF);
+    RETURN_VOID(env);
 }
 
 static YogVal
@@ -302,6 +333,14 @@ close_(YogEnv* env, YogVal self, YogVal pkg, YogVal args, YogVal kw, YogVal bloc
     RETURN(env, self);
 }
 
+static char*
+do_fgets(YogEnv* env, char* buffer, int size, FILE* fp)
+{
+    char* s;
+    YogGC_BLOCKING_REGION(env, s = fgets(buffer, size, fp));
+    return s;
+}
+
 static YogVal
 readline(YogEnv* env, YogVal self, YogVal pkg, YogVal args, YogVal kw, YogVal block)
 {
@@ -314,7 +353,7 @@ readline(YogEnv* env, YogVal self, YogVal pkg, YogVal args, YogVal kw, YogVal bl
 
     FILE* fp = PTR_AS(YogFile, self)->fp;
     char buffer[4096];
-#define FGETS   fgets(buffer, array_sizeof(buffer), fp)
+#define FGETS   do_fgets(env, buffer, array_sizeof(buffer), fp)
     if (FGETS == NULL) {
         RETURN(env, YNIL);
     }
@@ -396,7 +435,11 @@ open_(YogEnv* env, YogVal self, YogVal pkg, YogVal args, YogVal kw, YogVal block
 
     YogHandle* h = YogHandle_REGISTER(env, path);
     YogHandle* bin = VAL2HDL(env, YogString_to_bin_in_default_encoding(env, h));
-    FILE* fp = fopen(BINARY_CSTR(HDL2VAL(bin)), m);
+    const char* s = BINARY_CSTR(HDL2VAL(bin));
+    char* name = (char*)YogSysdeps_alloca(strlen(s) + 1);
+    strcpy(name, s);
+    FILE* fp;
+    YogGC_BLOCKING_REGION(env, fp = fopen(name, m));
     if (fp == NULL) {
         YogError_raise_sys_err(env, errno, path);
     }
@@ -148,21 +148,30 @@ YogScriptFrame_init(YogEnv* env, YogVal self, YogFrameType type, YogVal code, ui
     RETURN_VOID(env);
 }
 
-YogVal
-YogScriptFrame_new(YogEnv* env, YogFrameType type, YogVal code, uint_t locals_num, uint_t lhs_left_num)
+static YogVal
+alloc_script_frame(YogEnv* env, YogFrameType type, YogVal code, uint_t locals_num, uint_t lhs_left_num, uint_t slots_num)
 {
     SAVE_ARG(env, code);
     YogVal frame = YUNDEF;
     PUSH_LOCAL(env, frame);
 
-    uint_t locals_etc_size = PTR_AS(YogCode, code)->stack_size + locals_num + PTR_AS(YogCode, code)->outer_size;
-    YogGC_check_multiply_overflow(env, locals_etc_size, sizeof(YogVal));
-    frame = ALLOC_OBJ_ITEM(env, YogScriptFrame_keep_children, NULL, YogScriptFrame, locals_etc_size, YogVal);
+    YogGC_check_multiply_overflow(env, slots_num, sizeof(YogVal));
+    frame = ALLOC_OBJ_ITEM(env, YogScriptFrame_keep_children, NULL, YogScriptFrame, slots_num, YogVal);
     YogScriptFrame_init(env, frame, type, code, locals_num, lhs_left_num);
+    uint_t stack_capacity = PTR_AS(YogScriptFrame, frame)->stack_capacity;
+    PTR_AS(YogScriptFrame, frame)->outer_frames_num = slots_num - stack_capacity - locals_num;
+    cleanup_locals(env, frame);
 
     RETURN(env, frame);
 }
 
+YogVal
+YogScriptFrame_new(YogEnv* env, YogFrameType type, YogVal code, uint_t locals_num, uint_t lhs_left_num)
+{
+    uint_t slots_num = PTR_AS(YogCode, code)->stack_size + locals_num + PTR_AS(YogCode, code)->outer_size;
+    return alloc_script_frame(env, type, code, locals_num, lhs_left_num, slots_num);
+}
+
 static void
 YogCFrame_init(YogEnv* env, YogVal frame)
 {
@@ -217,25 +226,39 @@ YogFrame_get_c_frame(YogEnv* env)
     return YogCFrame_new(env);
 }
 
+static uint_t
+round_slots_num(uint_t slots_num)
+{
+    uint_t n = SCRIPT_FRAME_MIN_SLOTS;
+    while ((n < slots_num) && (n < UNSIGNED_MAX / 2)) {
+        n *= 2;
+    }
+    return n < slots_num ? slots_num : n;
+}
+
 YogVal
 YogFrame_get_script_frame(YogEnv* env, YogVal code, uint_t locals_num)
 {
-    YogVal frame = YogThread_get_script_frame(env, env->thread);
+    /**
+     * A script frame is taken from the frame stack of the current thread.
+     * The frame goes back to the stack at ret unless make_block or
+     * make_function captured it (used_by_func). So ordinary calls allocate
+     * nothing in the heap once the stack got deep enough.
+     */
+    uint_t stack_size = PTR_AS(YogCode, code)->stack_size;
+    uint_t needed = stack_size + locals_num + PTR_AS(YogCode, code)->outer_size;
+    YogVal frame = YogThread_get_script_frame(env, env->thread, needed);
     if (IS_PTR(frame)) {
-        uint_t actual = PTR_AS(YogScriptFrame, frame)->stack_capacity + PTR_AS(YogScriptFrame, frame)->locals_num + PTR_AS(YogScriptFrame, frame)->outer_frames_num;
-        uint_t stack_size = PTR_AS(YogCode, code)->stack_size;
-        uint_t needed = stack_size + locals_num + PTR_AS(YogCode, code)->outer_size;
-        if (needed <= actual) {
-            PTR_AS(YogScriptFrame, frame)->stack_capacity = stack_size;
-            PTR_AS(YogScriptFrame, frame)->locals_num = locals_num;
-            uint_t outer_frames_num = actual - stack_size - locals_num;
-            PTR_AS(YogScriptFrame, frame)->outer_frames_num = outer_frames_num;
-            YogGC_UPDATE_PTR(env, PTR_AS(YogScriptFrame, frame), code, code);
-            return frame;
-        }
+        uint_t actual = SCRIPT_FRAME_SLOTS_NUM(frame);
+        PTR_AS(YogScriptFrame, frame)->stack_capacity = stack_size;
+        PTR_AS(YogScriptFrame, frame)->locals_num = locals_num;
+        uint_t outer_frames_num = actual - stack_size - locals_num;
+        PTR_AS(YogScriptFrame, frame)->outer_frames_num = outer_frames_num;
+        YogGC_UPDATE_PTR(env, PTR_AS(YogScriptFrame, frame), code, code);
+        return frame;
     }
 
-    return YogScriptFrame_new(env, FRAME_SCRIPT, code, locals_num, 0);
+    return alloc_script_frame(env, FRAME_SCRIPT, code, locals_num, 0, round_slots_num(needed));
 }
 
 /**
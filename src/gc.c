@@ -1,6 +1,10 @@
+#include "yog/config.h"
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(YOG_HAVE_SYS_TIME_H)
+#   include <sys/time.h>
+#endif
 #include <sys/types.h>
 #include "yog/error.h"
 #include "yog/gc.h"
@@ -15,6 +19,7 @@
 #   include "yog/gc/generational.h"
 #endif
 #include "yog/handle.h"
+#include "yog/heap_profiler.h"
 #include "yog/misc.h"
 #include "yog/sysdeps.h"
 #include "yog/thread.h"
@@ -149,17 +154,29 @@ YogGC_suspend(YogEnv* env)
     DEBUG(TRACE("%p: exit YogGC_suspend", env));
 }
 
-YogVal
-YogGC_alloc(YogEnv* env, ChildrenKeeper keeper, Finalizer finalizer, size_t size)
+/**
+ * Slow path of YogGC_SAFEPOINT. Another thread is waiting for this thread to
+ * stop.
+ */
+void
+YogGC_safepoint(YogEnv* env)
 {
-    DEBUG(TRACE("%p: enter YogGC_alloc: keeper=%p, finalizer=%p, size=%u", env, keeper, finalizer, size));
+    DEBUG(TRACE("%p: enter YogGC_safepoint", env));
+    YogHandle_sync_scope_with_env(env);
     YogVM* vm = env->vm;
+    YogVM_acquire_global_interp_lock(env, vm);
     if (vm->waiting_suspend) {
-        YogHandle_sync_scope_with_env(env);
-        YogVM_acquire_global_interp_lock(env, vm);
         YogGC_suspend(env);
-        YogVM_release_global_interp_lock(env, vm);
     }
+    YogVM_release_global_interp_lock(env, vm);
+    DEBUG(TRACE("%p: exit YogGC_safepoint", env));
+}
+
+YogVal
+YogGC_alloc(YogEnv* env, ChildrenKeeper keeper, Finalizer finalizer, size_t size)
+{
+    DEBUG(TRACE("%p: enter YogGC_alloc: keeper=%p, finalizer=%p, size=%u", env, keeper, finalizer, size));
+    YogGC_SAFEPOINT(env);
 
     YogVal thread = env->thread;
 #if defined(GC_COPYING)
@@ -178,6 +195,10 @@ YogGC_alloc(YogEnv* env, ChildrenKeeper keeper, Finalizer finalizer, size_t size
     if (ptr == NULL) {
         YogError_out_of_memory(env, size);
     }
+    PTR_AS(YogThread, env->thread)->heap->allocated_size += size;
+    if (env->vm->heap_profiler != NULL) {
+        YogHeapProfiler_sample(env, env->vm->heap_profiler, ptr, size);
+    }
 
     return PTR2VAL(ptr);
 }
@@ -221,8 +242,37 @@ count_running_threads(YogEnv* env, YogVM* vm)
     return n;
 }
 
+static uint64_t
+get_usec()
+{
+    struct timeval tv;
+    if (gettimeofday(&tv, NULL) != 0) {
+        return 0;
+    }
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void
+count_time(YogEnv* env, YogGCTimes* times, uint64_t t)
+{
+    times->num++;
+    times->total += t;
+    if (times->max < t) {
+        times->max = t;
+    }
+    uint_t i;
+    uint64_t limit = 10;
+    for (i = 0; i < YogGC_HISTOGRAM_SIZE - 1; i++) {
+        if (t < limit) {
+            break;
+        }
+        limit *= 10;
+    }
+    times->histogram[i]++;
+}
+
 static void
-run_gc(YogEnv* env, GC gc)
+run_gc(YogEnv* env, GC gc, YogGCTimes* times)
 {
     DEBUG(TRACE("%p: enter run_gc: gc=%p", env, gc));
     YogVM* vm = env->vm;
@@ -230,15 +280,19 @@ run_gc(YogEnv* env, GC gc)
     if (0 < threads_num) {
         vm->suspend_counter = threads_num - 1;
         vm->waiting_suspend = TRUE;
+        uint64_t begin = get_usec();
         wait_suspend(env);
+        uint64_t gc_begin = get_usec();
+        count_time(env, &vm->gc_stats.time_to_safepoint, gc_begin - begin);
         (*gc)(env);
+        count_time(env, times, get_usec() - gc_begin);
         vm->waiting_suspend = FALSE;
     }
     DEBUG(TRACE("%p: exit run_gc", env));
 }
 
 static void
-perform(YogEnv* env, GC gc)
+perform(YogEnv* env, GC gc, YogGCTimes* times)
 {
     DEBUG(TRACE("%p: enter perform: gc=%p", env, gc));
     YogHandle_sync_scope_with_env(env);
@@ -249,7 +303,7 @@ perform(YogEnv* env, GC gc)
     }
     else {
         vm->running_gc = TRUE;
-        run_gc(env, gc);
+        run_gc(env, gc, times);
         vm->running_gc = FALSE;
         wakeup_suspend_threads(env);
         vm->gc_id++;
@@ -263,6 +317,9 @@ YogHeap_init(YogEnv* env, YogHeap* heap)
 {
     heap->prev = heap->next = NULL;
     heap->refered = TRUE;
+#if defined(GC_GENERATIONAL)
+    heap->shared = heap->tenure_all = heap->keep_shared = FALSE;
+#endif
 
     uint_t i;
     for (i = 0; i < array_sizeof(heap->marked_objects); i++) {
@@ -272,6 +329,7 @@ YogHeap_init(YogEnv* env, YogHeap* heap)
     }
     heap->cur_marked_objects = &heap->marked_objects[0];
     heap->prev_marked_objects = &heap->marked_objects[1];
+    heap->allocated_size = 0;
 }
 
 void
@@ -330,6 +388,7 @@ delete_heap(YogEnv* env, YogHeap* heap)
         vm->last_heap = heap->prev;
     }
     DELETE_FROM_LIST(env->vm->heaps, heap);
+    vm->gc_stats.allocated_size += heap->allocated_size;
 
     DELETE(env, heap);
 #undef DELETE
@@ -364,6 +423,36 @@ iterate_heaps(YogEnv* env, void (*f)(YogEnv*, YogHeap*))
     }
 }
 
+/**
+ * All threads finished. Every heap is swept at once to run all finalizers and
+ * to be deleted.
+ */
+static void
+unrefer_heaps(YogEnv* env)
+{
+    ITERATE_HEAPS(env->vm, heap->refered = FALSE);
+}
+
+static void
+update_heap_profiler(YogEnv* env, YogSampleForwarder forwarder, BOOL major)
+{
+    struct YogHeapProfiler* prof = env->vm->heap_profiler;
+    if (prof == NULL) {
+        return;
+    }
+    YogHeapProfiler_update(env, prof, forwarder, NULL, major);
+}
+
+static void
+dump_heap_profile(YogEnv* env)
+{
+    struct YogHeapProfiler* prof = env->vm->heap_profiler;
+    if (prof == NULL) {
+        return;
+    }
+    YogHeapProfiler_dump_live(env, prof);
+}
+
 #if defined(GC_COPYING) || defined(GC_MARK_SWEEP) || defined(GC_MARK_SWEEP_COMPACT)
 static void
 prepare(YogEnv* env)
@@ -373,7 +462,7 @@ prepare(YogEnv* env)
 #elif defined(GC_MARK_SWEEP)
 #   define PREPARE(env, heap) YogMarkSweep_prepare(env, heap)
 #elif defined(GC_MARK_SWEEP_COMPACT)
-#   define PREPARE(env, heap)
+#   define PREPARE(env, heap) YogMarkSweepCompact_finish_sweeping(env, heap)
 #endif
     ITERATE_HEAPS(env->vm, PREPARE(env, heap));
 #undef PREPARE
@@ -406,19 +495,52 @@ cheney_scan(YogEnv* env)
 static void
 mark_in_breadth_first(YogEnv* env)
 {
-    iterate_heaps(env, YogMarkSweepCompact_mark_in_breadth_first);
+    YogVM* vm = env->vm;
+    if ((vm->gc_threads_num < 2) || (vm->live_objects_num < PARALLEL_MARK_THRESHOLD)) {
+        iterate_heaps(env, YogMarkSweepCompact_mark_in_breadth_first);
+        return;
+    }
+    if (vm->markers == NULL) {
+        vm->markers = YogMarkSweepCompact_new_markers(env, vm->gc_threads_num);
+    }
+    YogMarkSweepCompact_mark_in_parallel(env, vm->markers);
+    vm->gc_stats.parallel_mark_num++;
 }
 #endif
 
+#if defined(GC_MARK_SWEEP) || defined(GC_MARK_SWEEP_COMPACT)
+/**
+ * Threads sweep their heaps after they resume. See "Lazy Sweeping" in
+ * src/gc/mark-sweep-compact.c. Nobody allocates in the heap of a finished
+ * thread, so such a heap is swept at once to be deleted.
+ */
 static void
-delete_garbage(YogEnv* env)
+start_sweeping(YogEnv* env, YogHeap* heap)
 {
-#if defined(GC_COPYING)
-#   define DELETE   YogCopying_delete_garbage
-#elif defined(GC_MARK_SWEEP)
+#if defined(GC_MARK_SWEEP)
 #   define DELETE   YogMarkSweep_delete_garbage
+#   define START    YogMarkSweep_start_sweeping
 #elif defined(GC_MARK_SWEEP_COMPACT)
 #   define DELETE   YogMarkSweepCompact_delete_garbage
+#   define START    YogMarkSweepCompact_start_sweeping
+#endif
+    if (!heap->refered) {
+        DELETE(env, heap);
+        return;
+    }
+    START(env, heap);
+#undef START
+#undef DELETE
+}
+#endif
+
+static void
+delete_garbage(YogEnv* env)
+{
+#if defined(GC_COPYING)
+#   define DELETE   YogCopying_delete_garbage
+#elif defined(GC_MARK_SWEEP) || defined(GC_MARK_SWEEP_COMPACT)
+#   define DELETE   start_sweeping
 #endif
     iterate_heaps(env, DELETE);
 #undef DELETE
@@ -438,6 +560,18 @@ post_gc(YogEnv* env)
 #undef POST
 }
 
+static void*
+forward_sample(YogEnv* env, void* ptr, void* heap)
+{
+#if defined(GC_COPYING)
+    return YogCopying_get_forwarding_addr(env, NULL, ptr);
+#elif defined(GC_MARK_SWEEP)
+    return YogMarkSweep_is_marked(env, ptr) ? ptr : NULL;
+#elif defined(GC_MARK_SWEEP_COMPACT)
+    return YogMarkSweepCompact_is_marked(env, ptr) ? ptr : NULL;
+#endif
+}
+
 static void
 gc(YogEnv* env)
 {
@@ -452,6 +586,7 @@ gc(YogEnv* env)
     mark_in_breadth_first(env);
 #endif
 
+    update_heap_profiler(env, forward_sample, TRUE);
     delete_garbage(env);
     post_gc(env);
     delete_heaps(env);
@@ -465,16 +600,25 @@ gc(YogEnv* env)
 void
 YogGC_perform(YogEnv* env)
 {
-    perform(env, gc);
+    perform(env, gc, &env->vm->gc_stats.major_gc);
+    dump_heap_profile(env);
 }
 
 void
 YogGC_delete(YogEnv* env)
 {
     prepare(env);
+    unrefer_heaps(env);
     delete_garbage(env);
     post_gc(env);
     delete_heaps(env);
+#if defined(GC_MARK_SWEEP_COMPACT)
+    YogVM* vm = env->vm;
+    if (vm->markers != NULL) {
+        YogMarkSweepCompact_delete_markers(env, vm->markers);
+        vm->markers = NULL;
+    }
+#endif
 }
 #endif
 
@@ -534,6 +678,40 @@ YogGC_add_to_remembered_set(YogEnv* env, void* ptr)
     YogGenerational_add_to_remembered_set(env, heap, ptr);
 }
 
+static BOOL
+is_world_stopped(YogVM* vm)
+{
+    return vm->waiting_suspend && (vm->suspend_counter == 0);
+}
+
+/**
+ * Slow path of YogGC_UPDATE_PTR. val is a young object, and obj is an old
+ * object or a young object of another thread.
+ */
+void
+YogGC_write_barrier(YogEnv* env, void* obj, void* val, uint_t offset)
+{
+    YogHeap* heap = PTR_AS(YogThread, env->thread)->heap;
+    YogHeap* owner = YogGC_OWNER(val);
+    if ((owner != heap) || (obj != VAL2PTR(env->thread))) {
+        owner->shared = TRUE;
+    }
+    if (YogGC_IS_YOUNG(obj)) {
+        return;
+    }
+    YogGenerational_mark_card(env, obj, offset);
+    if (YogGC_IS_REMEMBERED(obj)) {
+        return;
+    }
+    /**
+     * A remembered set is touched only by its owner thread or by the GC which
+     * stops the world. When the owner is another thread, the heap of val is
+     * shared, and every remembered set is traced in the next minor GC.
+     */
+    YogHeap* dest = (owner == heap) || is_world_stopped(env->vm) ? owner : heap;
+    YogGenerational_add_to_remembered_set(env, dest, obj);
+}
+
 static void
 prepare_minor(YogEnv* env)
 {
@@ -599,6 +777,16 @@ count_heaps(YogEnv* env)
     return n;
 }
 
+static void
+count_remembered_set(YogEnv* env, uint_t size)
+{
+    YogGCStats* stats = &env->vm->gc_stats;
+    stats->remembered_set_size = size;
+    if (stats->max_remembered_set_size < size) {
+        stats->max_remembered_set_size = size;
+    }
+}
+
 static void
 minor_gc(YogEnv* env)
 {
@@ -611,14 +799,18 @@ minor_gc(YogEnv* env)
 
     typedef struct RememberedSetWithHeap RememberedSetWithHeap;
 
+    uint64_t begin = get_usec();
     uint_t heaps_num = count_heaps(env);
     RememberedSetWithHeap* r = (RememberedSetWithHeap*)YogSysdeps_alloca(sizeof(RememberedSetWithHeap) * heaps_num);
     uint_t i;
     YogHeap* heap;
+    uint_t remembered_set_size = 0;
     for (i = 0, heap = env->vm->heaps; i < heaps_num; i++, heap = heap->next) {
         r[i].remembered_set = YogGenerational_get_remembered_set(env, heap);
         r[i].heap = heap;
+        remembered_set_size += r[i].remembered_set->pos;
     }
+    count_remembered_set(env, remembered_set_size);
 
     prepare_minor(env);
 
@@ -631,10 +823,14 @@ minor_gc(YogEnv* env)
     minor_keep_vm(env);
 
     minor_traverse(env);
+    update_heap_profiler(env, YogGenerational_forward_minor, FALSE);
     minor_delete_garbage(env);
     minor_post_gc(env);
     delete_heaps(env);
 
+    uint_t pause = get_usec() - begin;
+    ITERATE_HEAPS(env->vm, YogGenerational_resize_young(env, heap, pause));
+
     for (i = 0; i < heaps_num; i++) {
         RememberedSet* remembered_set = r[i].remembered_set;
         uint_t size = SIZEOF_REMEMBERED_SET(remembered_set->size);
@@ -688,6 +884,7 @@ major_gc(YogEnv* env)
     major_keep_vm(env);
 
     major_traverse(env);
+    update_heap_profiler(env, YogGenerational_forward_major, TRUE);
     major_delete_garbage(env);
     major_post_gc(env);
     delete_heaps(env);
@@ -698,17 +895,60 @@ void
 YogGC_delete(YogEnv* env)
 {
     prepare_major(env);
+    unrefer_heaps(env);
     major_delete_garbage(env);
     major_post_gc(env);
     delete_heaps(env);
 }
 
+static BOOL
+collect_locally(YogEnv* env)
+{
+    YogHandle_sync_scope_with_env(env);
+    YogVM* vm = env->vm;
+    YogHeap* heap = PTR_AS(YogThread, env->thread)->heap;
+    YogVM_acquire_global_interp_lock(env, vm);
+    if (vm->waiting_suspend) {
+        /**
+         * Another thread is starting stop-the-world GC. It collects this heap
+         * too.
+         */
+        YogGC_suspend(env);
+        YogVM_release_global_interp_lock(env, vm);
+        return TRUE;
+    }
+    if (!IS_PTR(vm->running_threads)) {
+        /**
+         * The main thread is not registered yet. env->thread is not an object
+         * in the heap, and run_gc does nothing.
+         */
+        YogVM_release_global_interp_lock(env, vm);
+        return FALSE;
+    }
+    if (heap->shared) {
+        YogVM_release_global_interp_lock(env, vm);
+        return FALSE;
+    }
+    YogGCStats* stats = &vm->gc_stats;
+    count_remembered_set(env, YogGenerational_get_remembered_set(env, heap)->pos);
+    uint64_t begin = get_usec();
+    YogGenerational_collect_locally(env, heap);
+    uint64_t pause = get_usec() - begin;
+    count_time(env, &stats->minor_gc, pause);
+    stats->local_gc_num++;
+    YogGenerational_resize_young(env, heap, pause);
+    YogVM_release_global_interp_lock(env, vm);
+    return TRUE;
+}
+
 void
 YogGC_perform_minor(YogEnv* env)
 {
     DEBUG(TRACE("%p: enter YogGC_perform_minor", env));
 
-    perform(env, minor_gc);
+    if (!collect_locally(env)) {
+        perform(env, minor_gc, &env->vm->gc_stats.minor_gc);
+    }
 
     if (env->vm->compaction_flag) {
         YogGC_perform_major(env);
@@ -727,11 +967,138 @@ void
 YogGC_perform_major(YogEnv* env)
 {
     DEBUG(TRACE("%p: enter YogGC_perform_major", env));
-    perform(env, major_gc);
+    perform(env, major_gc, &env->vm->gc_stats.major_gc);
+    dump_heap_profile(env);
     DEBUG(TRACE("%p: exit YogGC_perform_major", env));
 }
 #endif
 
+static size_t
+get_heap_size(YogEnv* env, YogHeap* heap)
+{
+#if defined(GC_COPYING)
+#   define GET_SIZE YogCopying_get_size
+#elif defined(GC_MARK_SWEEP)
+#   define GET_SIZE YogMarkSweep_get_size
+#elif defined(GC_MARK_SWEEP_COMPACT)
+#   define GET_SIZE YogMarkSweepCompact_get_size
+#elif defined(GC_GENERATIONAL)
+#   define GET_SIZE YogGenerational_get_size
+#endif
+    return GET_SIZE(env, heap);
+#undef GET_SIZE
+}
+
+static void
+lock_out_of_gc(YogEnv* env)
+{
+    YogHandle_sync_scope_with_env(env);
+    YogVM* vm = env->vm;
+    YogVM_acquire_global_interp_lock(env, vm);
+    if (vm->waiting_suspend) {
+        YogGC_suspend(env);
+    }
+}
+
+/**
+ * Copies statistics into stats and returns bytes which all heaps take. Bytes
+ * allocated by living heaps are added to stats->allocated_size.
+ */
+size_t
+YogGC_get_stats(YogEnv* env, YogGCStats* stats)
+{
+    YogVM* vm = env->vm;
+    lock_out_of_gc(env);
+    *stats = vm->gc_stats;
+    size_t heap_size = 0;
+    YogHeap* heap;
+    for (heap = vm->heaps; heap != NULL; heap = heap->next) {
+        heap_size += get_heap_size(env, heap);
+        stats->allocated_size += heap->allocated_size;
+    }
+    YogVM_release_global_interp_lock(env, vm);
+    return heap_size;
+}
+
+/**
+ * Stores ids of running threads and bytes which they allocated into ids and
+ * sizes (at most num). Returns the number of the threads.
+ */
+uint_t
+YogGC_get_threads_stats(YogEnv* env, uint_t* ids, uint64_t* sizes, uint_t num)
+{
+    YogVM* vm = env->vm;
+    lock_out_of_gc(env);
+    uint_t n = 0;
+    YogVal thread = vm->running_threads;
+    while (IS_PTR(thread)) {
+        if (n < num) {
+            ids[n] = PTR_AS(YogThread, thread)->thread_id;
+            sizes[n] = PTR_AS(YogThread, thread)->heap->allocated_size;
+        }
+        n++;
+        thread = PTR_AS(YogThread, thread)->next;
+    }
+    YogVM_release_global_interp_lock(env, vm);
+    return n;
+}
+
+static void
+print_times(const char* name, YogGCTimes* times)
+{
+    static const char* labels[] = {
+        "<10us", "<100us", "<1ms", "<10ms", "<100ms", ">=100ms" };
+    unsigned long long n = times->num;
+    fprintf(stderr, "%s: %llu\n", name, n);
+    unsigned long long avg = 0 < n ? times->total / n : 0;
+    fprintf(stderr, "%s (avg): %llu usec\n", name, avg);
+    unsigned long long max = times->max;
+    fprintf(stderr, "%s (max): %llu usec\n", name, max);
+    fprintf(stderr, "%s (histogram):", name);
+    uint_t i;
+    for (i = 0; i < YogGC_HISTOGRAM_SIZE; i++) {
+        unsigned long long m = times->histogram[i];
+        fprintf(stderr, " %s=%llu", labels[i], m);
+    }
+    fprintf(stderr, "\n");
+}
+
+void
+YogGC_print_stats(YogEnv* env)
+{
+    YogGCStats stats;
+    unsigned long long heap_size = YogGC_get_stats(env, &stats);
+    print_times("minor GC", &stats.minor_gc);
+    print_times("major GC", &stats.major_gc);
+    print_times("time to safepoint", &stats.time_to_safepoint);
+#define PRINT(fmt, n)   do { \
+    unsigned long long m = (n); \
+    fprintf(stderr, (fmt), m); \
+} while (0)
+    PRINT("local GC: %llu\n", stats.local_gc_num);
+    PRINT("parallel marks: %llu\n", stats.parallel_mark_num);
+    PRINT("allocated: %llu bytes\n", stats.allocated_size);
+    PRINT("promoted: %llu bytes\n", stats.promoted_size);
+    PRINT("remembered set (last): %llu\n", stats.remembered_set_size);
+    PRINT("remembered set (max): %llu\n", stats.max_remembered_set_size);
+    PRINT("heap size: %llu bytes\n", heap_size);
+#undef PRINT
+}
+
+/**
+ * Tells GC that val may be referred from other threads from now.
+ */
+void
+YogGC_share(YogEnv* env, YogVal val)
+{
+#if defined(GC_GENERATIONAL)
+    if (!IS_PTR(val) || YogGC_IS_OLD(val)) {
+        return;
+    }
+    YogGC_OWNER(val)->shared = TRUE;
+#endif
+}
+
 YogVal
 YogGC_keep(YogEnv* env, YogVal val, ObjectKeeper keeper, void* heap)
 {
@@ -743,6 +1110,20 @@ YogGC_keep(YogEnv* env, YogVal val, ObjectKeeper keeper, void* heap)
     return PTR2VAL(dest);
 }
 
+/**
+ * Keeper of YogSlots objects.
+ */
+void
+YogGC_keep_slots(YogEnv* env, void* ptr, ObjectKeeper keeper, void* heap)
+{
+    YogSlots* slots = (YogSlots*)ptr;
+    uint_t size = slots->size;
+    uint_t i;
+    for (i = 0; i < size; i++) {
+        YogGC_KEEP(env, slots, items[i], keeper, heap);
+    }
+}
+
 void
 YogGC_free_from_gc(YogEnv* env)
 {
@@ -29,6 +29,7 @@ typedef struct Header Header;
 
 struct Space {
     unsigned char* free;
+    uint_t size;
     unsigned char items[0];
 };
 
@@ -37,6 +38,11 @@ typedef struct Space Space;
 struct Copying {
     struct YogHeap base;
 
+    /**
+     * Objects are allocated in the first space_size bytes of from_space.
+     * to_space is never smaller than this, so that all survivors can be
+     * copied into it. See YogCopying_resize.
+     */
     uint_t space_size;
     struct Space* from_space;
     struct Space* to_space;
@@ -51,6 +57,7 @@ Space_new(YogEnv* env, uint_t size)
 {
     Space* space = (Space*)YogGC_malloc(env, sizeof(Space) + size);
     space->free = space->items;
+    space->size = size;
     YogGC_init_memory(env, space->items, size);
     return space;
 }
@@ -81,6 +88,9 @@ YogCopying_copy(YogEnv* env, YogHeap* heap, void* ptr)
     size_t size = header->size;
     const char* fmt = "header=%p, size=%d, &header->size=%p";
     YOG_ASSERT(env, sizeof(*header) <= size, fmt, header, header->size, &header->size);
+    Space* to_space = copying->to_space;
+    size_t rest_size = to_space->items + to_space->size - copying->unscanned;
+    YOG_ASSERT(env, size <= rest_size, "to space overflow (%p, %u)", ptr, size);
     memcpy(dest, header, size);
 
     header->forwarding_addr = (Header*)dest + 1;
@@ -101,7 +111,7 @@ destroy_memory(void* ptr, size_t size)
 static void
 free_space(YogEnv* env, Copying* copying, Space* space)
 {
-    YogGC_free(env, space, sizeof(Space) + copying->space_size);
+    YogGC_free(env, space, sizeof(Space) + space->size);
 }
 
 static void
@@ -282,6 +292,38 @@ YogCopying_alloc(YogEnv* env, YogHeap* heap, ChildrenKeeper keeper, Finalizer fi
     return header + 1;
 }
 
+/**
+ * Changes the size of the allocation area to size bytes. This must be called
+ * just after YogCopying_post_gc, when to_space is empty. size must not be less
+ * than the used size of from_space.
+ */
+void
+YogCopying_resize(YogEnv* env, YogHeap* heap, uint_t size)
+{
+    Copying* copying = (Copying*)heap;
+    Space* from_space = copying->from_space;
+    YOG_ASSERT(env, (uint_t)(from_space->free - from_space->items) <= size, "too small space (%u)", size);
+    if (copying->to_space->size != size) {
+        free_space(env, copying, copying->to_space);
+        copying->to_space = Space_new(env, size);
+    }
+    copying->space_size = size < from_space->size ? size : from_space->size;
+}
+
+size_t
+YogCopying_get_size(YogEnv* env, YogHeap* heap)
+{
+    Copying* copying = (Copying*)heap;
+    return copying->from_space->size + copying->to_space->size;
+}
+
+size_t
+YogCopying_get_used_size(YogEnv* env, YogHeap* heap)
+{
+    Space* from_space = ((Copying*)heap)->from_space;
+    return from_space->free - from_space->items;
+}
+
 BOOL
 YogCopying_is_empty(YogEnv* env, YogHeap* heap)
 {
@@ -317,6 +359,12 @@ YogCopying_delete(YogEnv* env, YogHeap* heap)
     YogGC_free(env, heap, sizeof(Copying));
 }
 
+void*
+YogCopying_get_forwarding_addr(YogEnv* env, YogHeap* heap, void* ptr)
+{
+    return PAYLOAD2HEADER(ptr)->forwarding_addr;
+}
+
 #if defined(GC_GENERATIONAL)
 void
 YogCopying_set_forwarding_addr(YogEnv* env, YogHeap* heap, void* ptr, void* forwarding_addr)
@@ -324,12 +372,6 @@ YogCopying_set_forwarding_addr(YogEnv* env, YogHeap* heap, void* ptr, void* forw
     PAYLOAD2HEADER(ptr)->forwarding_addr = forwarding_addr;
 }
 
-void*
-YogCopying_get_forwarding_addr(YogEnv* env, YogHeap* heap, void* ptr)
-{
-    return PAYLOAD2HEADER(ptr)->forwarding_addr;
-}
-
 ChildrenKeeper
 YogCopying_get_keeper(YogEnv* env, YogHeap* heap, void* ptr)
 {
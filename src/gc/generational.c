@@ -6,6 +6,7 @@
 #include "yog/gc/generational.h"
 #include "yog/gc/internal.h"
 #include "yog/gc/mark-sweep-compact.h"
+#include "yog/heap_profiler.h"
 #include "yog/thread.h"
 #include "yog/vm.h"
 #include "yog/yog.h"
@@ -13,12 +14,30 @@
 #define PAYLOAD2YOUNG_HEADER(ptr)   ((YoungHeader*)(ptr) - 1)
 #define PAYLOAD2OLD_HEADER(ptr)     ((OldHeader*)(ptr) - 1)
 
+#define CARD_SIZE                   (1 << YogGC_CARD_SHIFT)
+/**
+ * YogSlots smaller than this are remembered as a whole.
+ */
+#define MIN_CARDS_NUM               4
+
+/**
+ * Bounds of the young generation sizing. See YogGenerational_resize_young.
+ */
+#define MIN_YOUNG_SIZE              (128 * 1024)
+#define MAX_YOUNG_SIZE              (8 * 1024 * 1024)
+
 struct Generational {
     struct YogHeap base;
     struct YogHeap* young_heap;
     struct YogHeap* old_heap;
     uint_t max_age;
     struct RememberedSet* remembered_set;
+
+    uint_t young_size;
+    uint_t min_young_size;
+    uint_t max_young_size;
+    size_t allocated_size;
+    size_t promoted_size;
 };
 
 typedef struct Generational Generational;
@@ -68,8 +87,9 @@ YogGenerational_add_to_remembered_set(YogEnv* env, YogHeap* heap, void* ptr)
 }
 
 static void
-YoungHeader_init(YogEnv* env, YoungHeader* header)
+YoungHeader_init(YogEnv* env, YoungHeader* header, YogHeap* owner)
 {
+    header->owner = owner;
     header->age = 0;
     header->generation = GENERATION_YOUNG;
 }
@@ -77,10 +97,71 @@ YoungHeader_init(YogEnv* env, YoungHeader* header)
 static void
 OldHeader_init(YogEnv* env, OldHeader* header)
 {
+    header->cards = NULL;
     header->remembered = FALSE;
     header->generation = GENERATION_OLD;
 }
 
+static uint_t
+count_cards(uint_t slots_num)
+{
+    uint_t size = sizeof(YogSlots) + sizeof(YogVal) * slots_num;
+    return (size + CARD_SIZE - 1) / CARD_SIZE;
+}
+
+/**
+ * Marks a card of ptr which has a young object at offset. The card table is
+ * created at the first store into a large YogSlots object.
+ */
+void
+YogGenerational_mark_card(YogEnv* env, void* ptr, uint_t offset)
+{
+    OldHeader* header = PAYLOAD2OLD_HEADER(ptr);
+    if (header->cards == NULL) {
+        ChildrenKeeper keeper = YogMarkSweepCompact_get_children_keeper(env, NULL, ptr);
+        if (keeper != YogGC_keep_slots) {
+            return;
+        }
+        uint_t cards_num = count_cards(((YogSlots*)ptr)->size);
+        if (cards_num < MIN_CARDS_NUM) {
+            return;
+        }
+        unsigned char* cards = (unsigned char*)calloc(cards_num, 1);
+        if (cards == NULL) {
+            return;
+        }
+        if (!__sync_bool_compare_and_swap(&header->cards, NULL, cards)) {
+            free(cards);
+        }
+    }
+    header->cards[offset >> YogGC_CARD_SHIFT] = TRUE;
+}
+
+static void
+keep_dirty_cards(YogEnv* env, void* ptr, ObjectKeeper keeper, void* heap)
+{
+    YogSlots* slots = (YogSlots*)ptr;
+    unsigned char* cards = PAYLOAD2OLD_HEADER(ptr)->cards;
+    uint_t size = slots->size;
+    uint_t cards_num = count_cards(size);
+    uint_t base = sizeof(YogSlots);
+    uint_t i;
+    for (i = 0; i < cards_num; i++) {
+        if (!cards[i]) {
+            continue;
+        }
+        cards[i] = FALSE;
+        uint_t lower = i * CARD_SIZE;
+        uint_t upper = lower + CARD_SIZE;
+        uint_t begin = lower < base ? 0 : (lower - base + sizeof(YogVal) - 1) / sizeof(YogVal);
+        uint_t end = (upper - base + sizeof(YogVal) - 1) / sizeof(YogVal);
+        uint_t j;
+        for (j = begin; (j < end) && (j < size); j++) {
+            YogGC_KEEP(env, slots, items[j], keeper, heap);
+        }
+    }
+}
+
 static void*
 tenure(YogEnv* env, YogHeap* heap, void* ptr)
 {
@@ -96,6 +177,8 @@ tenure(YogEnv* env, YogHeap* heap, void* ptr)
     OldHeader_init(env, PAYLOAD2OLD_HEADER(p));
     memcpy(p, ptr, size);
     YogCopying_set_forwarding_addr(env, young_heap, ptr, p);
+    GENERATIONAL(heap)->promoted_size += size;
+    env->vm->gc_stats.promoted_size += size;
 
     return p;
 }
@@ -111,14 +194,26 @@ copy_young_obj(YogEnv* env, void* ptr, ObjectKeeper obj_keeper, void* heap, Proc
         return forwarding_addr;
     }
 
+    /**
+     * Objects in a shared heap and objects reached from other heaps may be
+     * referred from other threads. They are tenured at once, because a
+     * thread-local GC must not move them. See YogGenerational_collect_locally.
+     */
+    YogHeap* owner = PAYLOAD2YOUNG_HEADER(ptr)->owner;
+    BOOL escaped = owner->tenure_all || (owner != heap);
     PAYLOAD2YOUNG_HEADER(ptr)->age++;
-    if (PAYLOAD2YOUNG_HEADER(ptr)->age < GENERATIONAL_MAX_AGE(heap)) {
+    if (!escaped && (PAYLOAD2YOUNG_HEADER(ptr)->age < GENERATIONAL_MAX_AGE(heap))) {
         return YogCopying_copy(env, young_heap, ptr);
     }
 
     void* p = tenure(env, heap, ptr);
     if (p == NULL) {
-        return YogCopying_copy(env, young_heap, ptr);
+        p = YogCopying_copy(env, young_heap, ptr);
+        PAYLOAD2YOUNG_HEADER(p)->owner = (YogHeap*)heap;
+        if (escaped) {
+            ((YogHeap*)heap)->keep_shared = TRUE;
+        }
+        return p;
     }
     (*proc_for_tenured)(env, p, obj_keeper, heap);
 
@@ -192,9 +287,22 @@ YogGenerational_new(YogEnv* env, uint_t young_heap_size, uint_t old_heap_size, u
     GENERATIONAL_MAX_AGE(heap) = max_age;
     init_remembered_set(env, heap, 1024);
 
+    uint_t space_size = young_heap_size / 2;
+    heap->young_size = space_size;
+    heap->min_young_size = space_size < MIN_YOUNG_SIZE ? space_size : MIN_YOUNG_SIZE;
+    heap->max_young_size = MAX_YOUNG_SIZE < space_size ? space_size : MAX_YOUNG_SIZE;
+    heap->allocated_size = heap->promoted_size = 0;
+
     return (YogHeap*)heap;
 }
 
+size_t
+YogGenerational_get_size(YogEnv* env, YogHeap* heap)
+{
+    size_t young_size = YogCopying_get_size(env, GENERATIONAL_YOUNG_HEAP(heap));
+    return young_size + YogMarkSweepCompact_get_size(env, GENERATIONAL_OLD_HEAP(heap));
+}
+
 void
 YogGenerational_delete(YogEnv* env, YogHeap* heap)
 {
@@ -208,11 +316,19 @@ YogGenerational_delete(YogEnv* env, YogHeap* heap)
 void*
 YogGenerational_alloc(YogEnv* env, YogHeap* heap, ChildrenKeeper keeper, Finalizer finalizer, size_t size)
 {
-    YogHeap* young_heap = GENERATIONAL_YOUNG_HEAP(heap);
-    void* ptr = YogCopying_alloc(env, young_heap, keeper, finalizer, size);
-    if (ptr != NULL) {
-        YoungHeader_init(env, PAYLOAD2YOUNG_HEADER(ptr));
-        return ptr;
+    /**
+     * Large objects go to the old generation at once not to be copied at
+     * every minor GC.
+     */
+    YogMarkSweepCompact_run_finalizers(env, GENERATIONAL_OLD_HEAP(heap));
+    void* ptr;
+    if (size < YogGC_LARGE_OBJECT_SIZE) {
+        YogHeap* young_heap = GENERATIONAL_YOUNG_HEAP(heap);
+        ptr = YogCopying_alloc(env, young_heap, keeper, finalizer, size);
+        if (ptr != NULL) {
+            YoungHeader_init(env, PAYLOAD2YOUNG_HEADER(ptr), heap);
+            return ptr;
+        }
     }
 
     YogHeap* old_heap = GENERATIONAL_OLD_HEAP(heap);
@@ -225,9 +341,26 @@ YogGenerational_alloc(YogEnv* env, YogHeap* heap, ChildrenKeeper keeper, Finaliz
     return NULL;
 }
 
+static void
+prepare_sharing(YogEnv* env, YogHeap* heap)
+{
+    heap->tenure_all = heap->shared;
+    heap->keep_shared = FALSE;
+}
+
+static void
+prepare_sizing(YogEnv* env, YogHeap* heap)
+{
+    YogHeap* young_heap = GENERATIONAL_YOUNG_HEAP(heap);
+    GENERATIONAL(heap)->allocated_size = YogCopying_get_used_size(env, young_heap);
+    GENERATIONAL(heap)->promoted_size = 0;
+}
+
 void
 YogGenerational_prepare_minor(YogEnv* env, YogHeap* heap)
 {
+    prepare_sharing(env, heap);
+    prepare_sizing(env, heap);
     YogCopying_prepare(env, GENERATIONAL_YOUNG_HEAP(heap));
     init_remembered_set(env, GENERATIONAL(heap), GENERATIONAL_REMEMBERED_SET(heap)->size);
 }
@@ -247,7 +380,10 @@ reset_remembered_set(YogEnv* env, YogHeap* heap)
 void
 YogGenerational_prepare_major(YogEnv* env, YogHeap* heap)
 {
+    prepare_sharing(env, heap);
+    prepare_sizing(env, heap);
     YogCopying_prepare(env, GENERATIONAL_YOUNG_HEAP(heap));
+    YogMarkSweepCompact_finish_sweeping(env, GENERATIONAL_OLD_HEAP(heap));
     reset_remembered_set(env, heap);
 }
 
@@ -279,22 +415,39 @@ YogGenerational_minor_delete_garbage(YogEnv* env, YogHeap* heap)
     YogCopying_delete_garbage(env, GENERATIONAL_YOUNG_HEAP(heap));
 }
 
-INTERNAL void
-YogGenerational_trace_remembered_set(YogEnv* env, YogHeap* heap, RememberedSet* remembered_set)
+static void
+trace_remembered_set(YogEnv* env, YogHeap* heap, RememberedSet* remembered_set, ObjectKeeper keeper)
 {
     uint_t pos = remembered_set->pos;
     uint_t i;
     for (i = 0; i < pos; i++) {
         void* ptr = remembered_set->items[i];
         PAYLOAD2OLD_HEADER(ptr)->remembered = FALSE;
-        proc_for_tenured_minor(env, ptr, minor_gc_keep_object, heap);
+        if (PAYLOAD2OLD_HEADER(ptr)->cards != NULL) {
+            keep_dirty_cards(env, ptr, keeper, heap);
+            continue;
+        }
+        proc_for_tenured_minor(env, ptr, keeper, heap);
     }
 }
 
+INTERNAL void
+YogGenerational_trace_remembered_set(YogEnv* env, YogHeap* heap, RememberedSet* remembered_set)
+{
+    trace_remembered_set(env, heap, remembered_set, minor_gc_keep_object);
+}
+
 static void
 post_gc(YogEnv* env, YogHeap* heap)
 {
     YogCopying_post_gc(env, GENERATIONAL_YOUNG_HEAP(heap));
+
+    /**
+     * All escaped objects were tenured. If some of them could not be, this
+     * heap is still shared.
+     */
+    heap->shared = heap->keep_shared;
+    heap->tenure_all = heap->keep_shared = FALSE;
 }
 
 void
@@ -303,6 +456,47 @@ YogGenerational_minor_post_gc(YogEnv* env, YogHeap* heap)
     post_gc(env, heap);
 }
 
+/**
+ * Resizes the young generation after a minor GC which paused the thread for
+ * pause microseconds. Pauses of a copying GC are proportional to survivors, so
+ * the young generation shrinks when a pause is over the target. When pauses
+ * are short, it grows to make GC less frequent if few objects survived or if
+ * many objects were promoted too early. It never becomes smaller than twice
+ * of survivors.
+ */
+void
+YogGenerational_resize_young(YogEnv* env, YogHeap* heap, uint_t pause)
+{
+    Generational* gen = GENERATIONAL(heap);
+    size_t allocated = gen->allocated_size;
+    size_t survived = YogCopying_get_used_size(env, gen->young_heap);
+    uint_t target = env->vm->gc_pause_target;
+    uint_t size = gen->young_size;
+    if (target < pause) {
+        size = size / 4 * 3;
+    }
+    else if ((pause < target / 2) && (size <= allocated)) {
+        BOOL few_survivors = survived < allocated / 8;
+        BOOL early_promotion = allocated / 8 < gen->promoted_size;
+        if (few_survivors || early_promotion) {
+            size *= 2;
+        }
+    }
+    if (size < gen->min_young_size) {
+        size = gen->min_young_size;
+    }
+    if (gen->max_young_size < size) {
+        size = gen->max_young_size;
+    }
+    if (size < 2 * survived) {
+        size = 2 * survived;
+    }
+    size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+
+    gen->young_size = size;
+    YogCopying_resize(env, gen->young_heap, size);
+}
+
 BOOL
 YogGenerational_is_empty(YogEnv* env, YogHeap* heap)
 {
@@ -326,7 +520,12 @@ void
 YogGenerational_major_delete_garbage(YogEnv* env, YogHeap* heap)
 {
     YogCopying_delete_garbage(env, GENERATIONAL_YOUNG_HEAP(heap));
-    YogMarkSweepCompact_delete_garbage(env, GENERATIONAL_OLD_HEAP(heap));
+    YogHeap* old_heap = GENERATIONAL_OLD_HEAP(heap);
+    if (!heap->refered) {
+        YogMarkSweepCompact_delete_garbage(env, old_heap);
+        return;
+    }
+    YogMarkSweepCompact_start_sweeping(env, old_heap);
 }
 
 void
@@ -369,6 +568,112 @@ YogGenerational_major_traverse(YogEnv* env, YogHeap* heap)
     traverse(env, heap, major_gc_keep_object);
 }
 
+/**
+ * Returns the address of ptr after minor GC, or NULL if it died. Thread-local
+ * GC gives its heap, which is the only heap collected.
+ */
+void*
+YogGenerational_forward_minor(YogEnv* env, void* ptr, void* heap)
+{
+    if (YogGC_IS_OLD(ptr)) {
+        return ptr;
+    }
+    if ((heap != NULL) && (PAYLOAD2YOUNG_HEADER(ptr)->owner != heap)) {
+        return ptr;
+    }
+    return YogCopying_get_forwarding_addr(env, NULL, ptr);
+}
+
+void*
+YogGenerational_forward_major(YogEnv* env, void* ptr, void* heap)
+{
+    if (YogGC_IS_YOUNG(ptr)) {
+        return YogCopying_get_forwarding_addr(env, NULL, ptr);
+    }
+    return YogMarkSweepCompact_is_marked(env, ptr) ? ptr : NULL;
+}
+
+static void*
+local_gc_keep_object(YogEnv* env, void* ptr, void* heap)
+{
+    DEBUG(TRACE("local_gc_keep_object(env=%p, ptr=%p, heap=%p)", env, ptr, heap));
+    if (ptr == NULL) {
+        return NULL;
+    }
+    if (YogGC_IS_OLD(ptr)) {
+        return ptr;
+    }
+    /**
+     * Keepers of some objects (Thread) give another heap. The heap being
+     * collected is always one of the current thread.
+     */
+    YogHeap* self = PTR_AS(YogThread, env->thread)->heap;
+    if (PAYLOAD2YOUNG_HEADER(ptr)->owner != self) {
+        return ptr;
+    }
+
+    return copy_young_obj(env, ptr, local_gc_keep_object, self, proc_for_tenured_minor);
+}
+
+static void
+keep_thread(YogEnv* env, YogHeap* heap)
+{
+    /**
+     * The current thread object was allocated by its parent thread. Stores
+     * into it do not make the heap shared (see YogGC_write_barrier), so its
+     * children must be kept here.
+     */
+    void* thread = VAL2PTR(env->thread);
+    ChildrenKeeper keeper;
+    if (YogGC_IS_YOUNG(thread)) {
+        if (PAYLOAD2YOUNG_HEADER(thread)->owner == heap) {
+            return;
+        }
+        keeper = YogCopying_get_keeper(env, GENERATIONAL_YOUNG_HEAP(heap), thread);
+    }
+    else {
+        /**
+         * A remembered thread is traced with the remembered set. Keeping its
+         * children twice copies them again in to-space and leaves the first
+         * copies behind as forwarded objects.
+         */
+        if (YogGC_IS_REMEMBERED(thread)) {
+            return;
+        }
+        keeper = YogMarkSweepCompact_get_children_keeper(env, GENERATIONAL_OLD_HEAP(heap), thread);
+    }
+    (*keeper)(env, thread, local_gc_keep_object, heap);
+}
+
+/**
+ * Collects the young generation of the current thread without stopping other
+ * threads. The caller must hold the global interpreter lock and heap must not
+ * be shared, which means that no other threads refer the young objects.
+ */
+void
+YogGenerational_collect_locally(YogEnv* env, YogHeap* heap)
+{
+    RememberedSet* remembered_set = GENERATIONAL_REMEMBERED_SET(heap);
+    YogGenerational_prepare_minor(env, heap);
+
+    YogHeap_prepare_marking(env, heap);
+    keep_thread(env, heap);
+    trace_remembered_set(env, heap, remembered_set, local_gc_keep_object);
+    YogVM_keep_local_roots(env, env->vm, local_gc_keep_object, heap);
+
+    traverse(env, heap, local_gc_keep_object);
+    YogHeap_prepare_marking(env, heap);
+    struct YogHeapProfiler* prof = env->vm->heap_profiler;
+    if (prof != NULL) {
+        YogHeapProfiler_update(env, prof, YogGenerational_forward_minor, heap, FALSE);
+    }
+    YogGenerational_minor_delete_garbage(env, heap);
+    post_gc(env, heap);
+
+    uint_t size = SIZEOF_REMEMBERED_SET(remembered_set->size);
+    YogGC_free(env, remembered_set, size);
+}
+
 /**
  * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
  */
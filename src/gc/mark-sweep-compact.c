@@ -1,6 +1,11 @@
 #include "yog/config.h"
 #include <errno.h>
+#if defined(GC_MARK_SWEEP_COMPACT)
+#   include <pthread.h>
+#   include <sched.h>
+#endif
 #include <stddef.h>
+#include <stdlib.h>
 /* <sys/types.h> must be before <sys/mman.h> */
 #include <sys/types.h>
 #include <sys/mman.h>
@@ -143,7 +148,9 @@
  * = Huge
  *
  * An arena has upper limit of memory size. If requested size exceeds this
- * limit, this allocator allocate memory with mmap(2).
+ * limit or YogGC_LARGE_OBJECT_SIZE, this allocator allocate memory with
+ * mmap(2). Such chunk is marked as CHUNK_HUGE and released with munmap(2) when
+ * its object dies. Huge objects are never moved.
  *
  * The allocator has no list for huge chunks. It does not reuse huge chunks.
  *
@@ -179,6 +186,30 @@
  * When used chank is collected by GC, this chunk and previous/next free chunks
  * are merged into one free chunk. This larger free chunk is added to a
  * small/large link.
+ *
+ * = Lazy Sweeping
+ *
+ * A GC only marks objects and sets sweep_cursor to the head of the object
+ * list. Threads sweep their own heaps after they resume. Each allocation
+ * sweeps SWEEP_RATIO times of its size, and an allocation which finds no free
+ * chunk sweeps SWEEP_STEP bytes at a time before running GC or adding an
+ * arena. New objects are added to the front of the list, so the sweeper never
+ * sees them. The next GC finishes sweeping before marking, because unswept
+ * living objects are still marked.
+ *
+ * A dead object with a finalizer is not freed by the sweeper. It is queued in
+ * finalizees. The owner thread runs finalizers at its next allocation, and then
+ * frees their chunks. So neither sweeping nor finalizers pause other threads.
+ *
+ * The heap of a finished thread is swept at once, because nobody allocates in
+ * it.
+ *
+ * = Releasing Arenas
+ *
+ * When sweeping finishes, arenas which have no used chunk are unmapped. Free
+ * arenas are kept up to YogVM::heap_headroom percent of living bytes (one
+ * arena at least) to be reused without mmap(2). So the heap shrinks after
+ * living objects decrease. The last arena is never unmapped.
  */
 
 struct Header {
@@ -199,6 +230,9 @@ typedef struct Header Header;
 struct ChunkHeader {
     BOOL prev_used;
     uint_t size;
+    /**
+     * TRUE, FALSE or CHUNK_HUGE. A huge chunk has no neighbors.
+     */
     BOOL used;
 };
 
@@ -210,6 +244,7 @@ typedef struct ChunkHeader ChunkHeader;
 #define CHUNK_USED(chunk)       CHUNK((chunk))->used
 #define NEXT_CHUNK(chunk)       CHUNK((char*)(chunk) + CHUNK_SIZE((chunk)))
 #define payload2chunk(p)        CHUNK((char*)(p) - sizeof(ChunkHeader))
+#define CHUNK_HUGE              2
 
 struct FreeHeader {
     struct ChunkHeader base;
@@ -241,6 +276,9 @@ typedef struct FreeFooter FreeFooter;
 #define LARGE_NUM       32
 #define LARGE_SHIFT     8
 
+#define SWEEP_RATIO     2
+#define SWEEP_STEP      (64 * 1024)
+
 struct Arena {
     struct Arena* next;
 };
@@ -256,7 +294,30 @@ struct MarkSweepCompact {
     struct FreeHeader* small[SMALL_NUM];
     struct FreeHeader* large[LARGE_NUM];
     struct Header* header;
+    /**
+     * The next object to sweep. This is NULL when sweeping finished.
+     * sweeping_objects_num and sweeping_size count living objects swept so
+     * far. See "Lazy Sweeping".
+     */
+    struct Header* sweep_cursor;
+    uint_t sweeping_objects_num;
+    size_t sweeping_size;
+    struct Header* finalizees;
+    /**
+     * Bytes allocated since the last compaction (generational GC) or bytes of
+     * huge chunks since the last GC caused by them (mark-sweep-compact GC).
+     */
     size_t allocated_size;
+    uint_t live_objects_num;
+    size_t live_size;
+    size_t huge_size;
+    /**
+     * The generational GC runs a major GC whenever this many bytes are
+     * promoted. This follows live_size, so the old generation grows up to
+     * about twice of living objects between major GCs. See
+     * update_major_threshold.
+     */
+    size_t major_threshold;
 };
 
 typedef struct MarkSweepCompact MarkSweepCompact;
@@ -456,16 +517,105 @@ check_if_over_threshold(YogEnv* env, MarkSweepCompact* msc, size_t size, size_t
 static void
 turn_on_major_or_compaction(YogEnv* env, MarkSweepCompact* msc, size_t size)
 {
-    if (check_if_over_threshold(env, msc, size, msc->arena_size / 3 * 2)) {
+    size_t threshold = msc->major_threshold;
+    if (check_if_over_threshold(env, msc, size, threshold / 3 * 4)) {
         msc->allocated_size = 0;
         env->vm->compaction_flag = TRUE;
         return;
     }
-    if (check_if_over_threshold(env, msc, size, msc->arena_size / 2)) {
+    if (check_if_over_threshold(env, msc, size, threshold)) {
         env->vm->major_gc_flag = TRUE;
     }
 }
+
+static void
+update_major_threshold(YogEnv* env, MarkSweepCompact* msc)
+{
+    size_t min = msc->arena_size / 2;
+    msc->major_threshold = msc->live_size < min ? min : msc->live_size;
+}
+#endif
+
+static FreeHeader**
+find_list_of_size(YogEnv* env, MarkSweepCompact* msc, size_t size)
+{
+    if (MAX_SMALL_SIZE < size) {
+        return &msc->large[compute_large_index(env, size)];
+    }
+    return &msc->small[size2index(size)];
+}
+
+static FreeHeader*
+merge_with_prev_chunk(YogEnv* env, MarkSweepCompact* msc, ChunkHeader* chunk)
+{
+    FreeFooter* prev_footer = (FreeFooter*)chunk - 1;
+    uint_t prev_size = prev_footer->size;
+    FreeHeader* prev_chunk = (FreeHeader*)((char*)chunk - prev_size);
+    FreeHeader** list = find_list_of_size(env, msc, prev_size);
+    DELETE_FROM_LIST(*list, prev_chunk);
+    uint_t size = prev_size + CHUNK_SIZE(chunk);
+    CHUNK_SIZE(prev_chunk) = size;
+    FreeFooter* footer = chunk2footer(prev_chunk);
+    footer->size = size;
+    return prev_chunk;
+}
+
+static FreeHeader*
+merge_with_next_chunk(YogEnv* env, MarkSweepCompact* msc, FreeHeader* chunk)
+{
+    FreeHeader* next_chunk = FREE(NEXT_CHUNK(chunk));
+    uint_t next_size = CHUNK_SIZE(next_chunk);
+    FreeHeader** list = find_list_of_size(env, msc, next_size);
+    DELETE_FROM_LIST(*list, next_chunk);
+    uint_t size = CHUNK_SIZE(chunk) + next_size;
+    CHUNK_SIZE(chunk) = size;
+    FreeFooter* footer = chunk2footer(chunk);
+    footer->size = size;
+    return chunk;
+}
+
+static void
+delete(YogEnv* env, MarkSweepCompact* msc, Header* header)
+{
+    ChunkHeader* chunk = (ChunkHeader*)header - 1;
+    if (CHUNK_USED(chunk) == CHUNK_HUGE) {
+        msc->huge_size -= CHUNK_SIZE(chunk);
+        do_mummap(env, chunk, CHUNK_SIZE(chunk));
+        return;
+    }
+
+    FreeHeader* merged_chunk1;
+    if (CHUNK_PREV_USED(chunk)) {
+        CHUNK_USED(chunk) = FALSE;
+        FREE_PREV(chunk) = FREE_NEXT(chunk) = NULL;
+        chunk2footer(chunk)->size = CHUNK_SIZE(chunk);
+        merged_chunk1 = FREE(chunk);
+    }
+    else {
+        merged_chunk1 = merge_with_prev_chunk(env, msc, chunk);
+    }
+
+    ChunkHeader* next_chunk = NEXT_CHUNK(merged_chunk1);
+    FreeHeader* merged_chunk2;
+    if (CHUNK_USED(next_chunk)) {
+        CHUNK_PREV_USED(next_chunk) = FALSE;
+        merged_chunk2 = merged_chunk1;
+    }
+    else {
+        merged_chunk2 = merge_with_next_chunk(env, msc, merged_chunk1);
+    }
+
+    add_chunk(env, msc, merged_chunk2);
+}
+
+static void
+release(YogEnv* env, MarkSweepCompact* msc, Header* header)
+{
+#if defined(GC_GENERATIONAL)
+    free(header->generational_part.cards);
 #endif
+    delete(env, msc, header);
+}
 
 static size_t
 compute_upper_limit_of_arena(size_t arena_size)
@@ -473,6 +623,100 @@ compute_upper_limit_of_arena(size_t arena_size)
     return arena_size - sizeof(Arena) - sizeof(ChunkHeader);
 }
 
+static BOOL
+is_free_arena(YogEnv* env, MarkSweepCompact* msc, Arena* arena)
+{
+    FreeHeader* chunk = ARENA_CHUNKS(arena);
+    if (CHUNK_USED(chunk)) {
+        return FALSE;
+    }
+    return CHUNK_SIZE(chunk) == compute_upper_limit_of_arena(msc->arena_size);
+}
+
+static void
+release_free_arenas(YogEnv* env, MarkSweepCompact* msc)
+{
+    size_t arena_size = msc->arena_size;
+    size_t headroom = msc->live_size / 100 * env->vm->heap_headroom;
+    headroom = headroom < arena_size ? arena_size : headroom;
+    size_t free_size = 0;
+    Arena** prev = &msc->arenas;
+    Arena* arena = msc->arenas;
+    while (arena != NULL) {
+        Arena* next = arena->next;
+        if (!is_free_arena(env, msc, arena)) {
+            prev = &arena->next;
+            arena = next;
+            continue;
+        }
+        BOOL last = (msc->arenas == arena) && (next == NULL);
+        if ((free_size < headroom) || last) {
+            free_size += arena_size;
+            prev = &arena->next;
+            arena = next;
+            continue;
+        }
+        FreeHeader* chunk = ARENA_CHUNKS(arena);
+        FreeHeader** list = find_list_of_size(env, msc, CHUNK_SIZE(chunk));
+        DELETE_FROM_LIST(*list, chunk);
+        *prev = next;
+        delete_arena(env, arena, arena_size);
+        arena = next;
+    }
+}
+
+static void
+end_sweeping(YogEnv* env, MarkSweepCompact* msc)
+{
+#if defined(GC_MARK_SWEEP_COMPACT)
+    uint_t delta = msc->sweeping_objects_num - msc->live_objects_num;
+    __sync_fetch_and_add(&env->vm->live_objects_num, delta);
+#endif
+    msc->live_objects_num = msc->sweeping_objects_num;
+    msc->live_size = msc->sweeping_size;
+#if defined(GC_GENERATIONAL)
+    update_major_threshold(env, msc);
+#endif
+    release_free_arenas(env, msc);
+}
+
+/**
+ * Sweeps objects from sweep_cursor until size bytes of chunks are visited.
+ * Returns FALSE when there is nothing to sweep.
+ */
+static BOOL
+sweep(YogEnv* env, MarkSweepCompact* msc, size_t size)
+{
+    Header* header = msc->sweep_cursor;
+    if (header == NULL) {
+        return FALSE;
+    }
+    size_t swept_size = 0;
+    while ((header != NULL) && (swept_size < size)) {
+        Header* current = header;
+        header = header->next;
+        uint_t chunk_size = CHUNK_SIZE((ChunkHeader*)current - 1);
+        swept_size += chunk_size;
+        if (current->marked) {
+            current->marked = FALSE;
+            msc->sweeping_objects_num++;
+            msc->sweeping_size += chunk_size;
+            continue;
+        }
+        DELETE_FROM_LIST(msc->header, current);
+        if (current->finalizer != NULL) {
+            ADD_TO_LIST(msc->finalizees, current);
+            continue;
+        }
+        release(env, msc, current);
+    }
+    msc->sweep_cursor = header;
+    if (header == NULL) {
+        end_sweeping(env, msc);
+    }
+    return TRUE;
+}
+
 static Arena*
 alloc_arena(YogEnv* env, size_t size, Arena* next)
 {
@@ -501,8 +745,23 @@ add_arena(YogEnv* env, MarkSweepCompact* msc)
 static void*
 alloc_huge(YogEnv* env, MarkSweepCompact* msc, size_t size)
 {
+    /**
+     * Huge chunks are out of arenas. GC must count them not to let them grow
+     * without limit.
+     */
+#if defined(GC_MARK_SWEEP_COMPACT)
+    if ((msc->arena_size <= msc->allocated_size + size) || env->vm->gc_stress) {
+        msc->allocated_size = 0;
+        YogGC_perform(env);
+    }
+#elif defined(GC_GENERATIONAL)
+    turn_on_major_or_compaction(env, msc, size);
+#endif
+    msc->allocated_size += size;
+
     ChunkHeader* chunk = (ChunkHeader*)mmap_anonymous(env, size);
-    ChunkHeader_init(env, chunk, size, FALSE, TRUE);
+    msc->huge_size += size;
+    ChunkHeader_init(env, chunk, size, FALSE, CHUNK_HUGE);
     return chunk + 1;
 }
 
@@ -511,7 +770,8 @@ alloc(YogEnv* env, MarkSweepCompact* msc, size_t size)
 {
     size_t limit = compute_upper_limit_of_arena(msc->arena_size);
     size_t size_including_header = size + sizeof(ChunkHeader);
-    if (limit <= size_including_header) {
+    sweep(env, msc, SWEEP_RATIO * size_including_header);
+    if ((limit <= size_including_header) || (YogGC_LARGE_OBJECT_SIZE <= size)) {
         return alloc_huge(env, msc, size_including_header);
     }
 
@@ -522,6 +782,12 @@ alloc(YogEnv* env, MarkSweepCompact* msc, size_t size)
         return handle_free_chunk(env, msc, size_including_header, chunk, list); \
     } \
 } while (0)
+#define SWEEP_AND_FIND_BEST_CHUNK do { \
+    FIND_BEST_CHUNK; \
+    while (sweep(env, msc, SWEEP_STEP)) { \
+        FIND_BEST_CHUNK; \
+    } \
+} while (0)
 
 #if defined(GC_MARK_SWEEP_COMPACT)
     if (env->vm->gc_stress) {
@@ -529,9 +795,9 @@ alloc(YogEnv* env, MarkSweepCompact* msc, size_t size)
         YogGC_compact(env);
     }
 
-    FIND_BEST_CHUNK;
+    SWEEP_AND_FIND_BEST_CHUNK;
     YogGC_perform(env);
-    FIND_BEST_CHUNK;
+    SWEEP_AND_FIND_BEST_CHUNK;
     YogGC_compact(env);
     FIND_BEST_CHUNK;
     add_arena(env, msc);
@@ -540,11 +806,12 @@ alloc(YogEnv* env, MarkSweepCompact* msc, size_t size)
 #elif defined(GC_GENERATIONAL)
     turn_on_major_or_compaction(env, msc, size_including_header);
     msc->allocated_size += size_including_header;
-    FIND_BEST_CHUNK;
+    SWEEP_AND_FIND_BEST_CHUNK;
     add_arena(env, msc);
     FIND_BEST_CHUNK;
     return NULL;
 #endif
+#undef SWEEP_AND_FIND_BEST_CHUNK
 #undef FIND_BEST_CHUNK
 }
 
@@ -552,6 +819,9 @@ void*
 YogMarkSweepCompact_alloc(YogEnv* env, YogHeap* heap, ChildrenKeeper keeper, Finalizer finalizer, size_t size)
 {
     MarkSweepCompact* msc = (MarkSweepCompact*)heap;
+#if defined(GC_MARK_SWEEP_COMPACT)
+    YogMarkSweepCompact_run_finalizers(env, heap);
+#endif
     size_t rounded_size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
     void* ptr = alloc(env, msc, rounded_size + sizeof(Header));
     if (ptr == NULL) {
@@ -567,102 +837,52 @@ YogMarkSweepCompact_alloc(YogEnv* env, YogHeap* heap, ChildrenKeeper keeper, Fin
     return user_area;
 }
 
-static void
-finalize(YogEnv* env, Header* header)
+void
+YogMarkSweepCompact_start_sweeping(YogEnv* env, YogHeap* heap)
 {
-    if (header->finalizer == NULL) {
-        return;
+    MarkSweepCompact* msc = (MarkSweepCompact*)heap;
+    msc->sweep_cursor = msc->header;
+    msc->sweeping_objects_num = 0;
+    msc->sweeping_size = 0;
+    if (msc->sweep_cursor == NULL) {
+        end_sweeping(env, msc);
     }
-    (*header->finalizer)(env, header + 1);
 }
 
-static FreeHeader**
-find_list_of_size(YogEnv* env, MarkSweepCompact* msc, size_t size)
+void
+YogMarkSweepCompact_finish_sweeping(YogEnv* env, YogHeap* heap)
 {
-    if (MAX_SMALL_SIZE < size) {
-        return &msc->large[compute_large_index(env, size)];
+    MarkSweepCompact* msc = (MarkSweepCompact*)heap;
+    while (sweep(env, msc, SWEEP_STEP)) {
     }
-    return &msc->small[size2index(size)];
-}
-
-static FreeHeader*
-merge_with_prev_chunk(YogEnv* env, MarkSweepCompact* msc, ChunkHeader* chunk)
-{
-    FreeFooter* prev_footer = (FreeFooter*)chunk - 1;
-    uint_t prev_size = prev_footer->size;
-    FreeHeader* prev_chunk = (FreeHeader*)((char*)chunk - prev_size);
-    FreeHeader** list = find_list_of_size(env, msc, prev_size);
-    DELETE_FROM_LIST(*list, prev_chunk);
-    uint_t size = prev_size + CHUNK_SIZE(chunk);
-    CHUNK_SIZE(prev_chunk) = size;
-    FreeFooter* footer = chunk2footer(prev_chunk);
-    footer->size = size;
-    return prev_chunk;
 }
 
-static FreeHeader*
-merge_with_next_chunk(YogEnv* env, MarkSweepCompact* msc, FreeHeader* chunk)
-{
-    FreeHeader* next_chunk = FREE(NEXT_CHUNK(chunk));
-    uint_t next_size = CHUNK_SIZE(next_chunk);
-    FreeHeader** list = find_list_of_size(env, msc, next_size);
-    DELETE_FROM_LIST(*list, next_chunk);
-    uint_t size = CHUNK_SIZE(chunk) + next_size;
-    CHUNK_SIZE(chunk) = size;
-    FreeFooter* footer = chunk2footer(chunk);
-    footer->size = size;
-    return chunk;
-}
-
-static void
-delete(YogEnv* env, MarkSweepCompact* msc, Header* header)
+/**
+ * Runs finalizers queued by the sweeper. This must be called by the owner
+ * thread of the heap out of GC.
+ */
+void
+YogMarkSweepCompact_run_finalizers(YogEnv* env, YogHeap* heap)
 {
-    ChunkHeader* chunk = (ChunkHeader*)header - 1;
-    if (compute_upper_limit_of_arena(msc->arena_size) <= CHUNK_SIZE(chunk)) {
-        do_mummap(env, chunk, CHUNK_SIZE(chunk));
-        return;
-    }
-
-    FreeHeader* merged_chunk1;
-    if (CHUNK_PREV_USED(chunk)) {
-        CHUNK_USED(chunk) = FALSE;
-        FREE_PREV(chunk) = FREE_NEXT(chunk) = NULL;
-        chunk2footer(chunk)->size = CHUNK_SIZE(chunk);
-        merged_chunk1 = FREE(chunk);
-    }
-    else {
-        merged_chunk1 = merge_with_prev_chunk(env, msc, chunk);
-    }
-
-    ChunkHeader* next_chunk = NEXT_CHUNK(merged_chunk1);
-    FreeHeader* merged_chunk2;
-    if (CHUNK_USED(next_chunk)) {
-        CHUNK_PREV_USED(next_chunk) = FALSE;
-        merged_chunk2 = merged_chunk1;
-    }
-    else {
-        merged_chunk2 = merge_with_next_chunk(env, msc, merged_chunk1);
+    MarkSweepCompact* msc = (MarkSweepCompact*)heap;
+    while (msc->finalizees != NULL) {
+        Header* header = msc->finalizees;
+        DELETE_FROM_LIST(msc->finalizees, header);
+        (*header->finalizer)(env, header + 1);
+        release(env, msc, header);
     }
-
-    add_chunk(env, msc, merged_chunk2);
 }
 
+/**
+ * Sweeps all garbage at once and runs finalizers. This is for heaps of
+ * finished threads.
+ */
 void
 YogMarkSweepCompact_delete_garbage(YogEnv* env, YogHeap* heap)
 {
-    MarkSweepCompact* msc = (MarkSweepCompact*)heap;
-    Header* header = msc->header;
-    while (header != NULL) {
-        Header* current = header;
-        header = header->next;
-        if (current->marked) {
-            current->marked = FALSE;
-            continue;
-        }
-        finalize(env, current);
-        DELETE_FROM_LIST(msc->header, current);
-        delete(env, msc, current);
-    }
+    YogMarkSweepCompact_start_sweeping(env, heap);
+    YogMarkSweepCompact_finish_sweeping(env, heap);
+    YogMarkSweepCompact_run_finalizers(env, heap);
 }
 
 void*
@@ -687,6 +907,12 @@ YogMarkSweepCompact_mark_recursively(YogEnv* env, void* ptr, ObjectKeeper keeper
     return ptr;
 }
 
+BOOL
+YogMarkSweepCompact_is_marked(YogEnv* env, void* ptr)
+{
+    return PAYLOAD2HEADER(ptr)->marked;
+}
+
 void*
 YogMarkSweepCompact_mark(YogEnv* env, void* ptr, ObjectKeeper keeper, void* heap)
 {
@@ -745,7 +971,22 @@ BOOL
 YogMarkSweepCompact_is_empty(YogEnv* env, YogHeap* heap)
 {
     MarkSweepCompact* msc = (MarkSweepCompact*)heap;
-    return msc->header == NULL ? TRUE : FALSE;
+    return (msc->header == NULL) && (msc->finalizees == NULL) ? TRUE : FALSE;
+}
+
+/**
+ * Returns bytes of arenas and huge chunks.
+ */
+size_t
+YogMarkSweepCompact_get_size(YogEnv* env, YogHeap* heap)
+{
+    MarkSweepCompact* msc = (MarkSweepCompact*)heap;
+    size_t size = msc->huge_size;
+    Arena* arena;
+    for (arena = msc->arenas; arena != NULL; arena = arena->next) {
+        size += msc->arena_size;
+    }
+    return size;
 }
 
 YogHeap*
@@ -755,6 +996,10 @@ YogMarkSweepCompact_new(YogEnv* env, size_t size)
     YogHeap_init(env, (YogHeap*)heap);
 
     heap->header = NULL;
+    heap->sweep_cursor = NULL;
+    heap->sweeping_objects_num = 0;
+    heap->sweeping_size = 0;
+    heap->finalizees = NULL;
 
     Arena* arena = alloc_arena(env, size, NULL);
     heap->arenas = arena;
@@ -770,10 +1015,367 @@ YogMarkSweepCompact_new(YogEnv* env, size_t size)
     add_chunk(env, heap, ARENA_CHUNKS(arena));
 
     heap->allocated_size = 0;
+    heap->live_objects_num = 0;
+    heap->live_size = 0;
+    heap->huge_size = 0;
+    heap->major_threshold = size / 2;
 
     return (YogHeap*)heap;
 }
 
+#if defined(GC_MARK_SWEEP_COMPACT)
+/**
+ * = Parallel Marking
+ *
+ * When the previous GC found many living objects, the mark phase is shared by
+ * markers. Sweeps keep the count in YogVM::live_objects_num, so the check costs
+ * nothing at GC. The thread running GC is the marker 0. The others are GC
+ * worker threads, which are started at the first parallel marking and sleep
+ * between GCs. Each marker has its own stack of objects
+ * whose children are not scanned yet. A marker which emptied its stack steals
+ * a half of the stack of another marker. Marking finishes when all markers
+ * become idle, because only an active marker pushes objects.
+ *
+ * Markers claim an object by setting Header::marked atomically, so children of
+ * an object are scanned by exactly one marker.
+ */
+
+#define STEAL_MAX   256
+
+struct Marker {
+    YogEnv env;
+    struct YogMarkers* markers;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    YogMarkedObjects stack;
+};
+
+typedef struct Marker Marker;
+
+#define ENV2MARKER(env) ((Marker*)((char*)(env) - offsetof(Marker, env)))
+
+struct YogMarkers {
+    uint_t num;
+    struct Marker* markers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start_cond;
+    pthread_cond_t finish_cond;
+    uint_t gc_id;
+    uint_t running_num;
+    BOOL exiting;
+
+    volatile uint_t idle_num;
+};
+
+static void
+lock_mutex(YogEnv* env, pthread_mutex_t* mutex)
+{
+    if (pthread_mutex_lock(mutex) != 0) {
+        YOG_BUG(env, "pthread_mutex_lock failed");
+    }
+}
+
+static void
+unlock_mutex(YogEnv* env, pthread_mutex_t* mutex)
+{
+    if (pthread_mutex_unlock(mutex) != 0) {
+        YOG_BUG(env, "pthread_mutex_unlock failed");
+    }
+}
+
+static void
+push_to_stack(YogEnv* env, YogMarkedObjects* stack, YogVal v)
+{
+    uint_t pos = stack->pos;
+    if (pos == stack->size) {
+        uint_t size = stack->size + 1024;
+        YogVal* ptr = (YogVal*)realloc(stack->ptr, sizeof(YogVal) * size);
+        if (ptr == NULL) {
+            YogError_out_of_memory(env, sizeof(YogVal) * size);
+        }
+        stack->ptr = ptr;
+        stack->size = size;
+    }
+    stack->ptr[pos] = v;
+    stack->pos = pos + 1;
+}
+
+static void
+push_to_marker(YogEnv* env, Marker* marker, YogVal v)
+{
+    lock_mutex(env, &marker->lock);
+    push_to_stack(env, &marker->stack, v);
+    unlock_mutex(env, &marker->lock);
+}
+
+static BOOL
+pop_from_marker(YogEnv* env, Marker* marker, YogVal* v)
+{
+    BOOL found = FALSE;
+    lock_mutex(env, &marker->lock);
+    uint_t pos = marker->stack.pos;
+    if (0 < pos) {
+        *v = marker->stack.ptr[pos - 1];
+        marker->stack.pos = pos - 1;
+        found = TRUE;
+    }
+    unlock_mutex(env, &marker->lock);
+    return found;
+}
+
+static void*
+keep_object_in_parallel(YogEnv* env, void* ptr, void* heap)
+{
+    if (ptr == NULL) {
+        return NULL;
+    }
+    Header* header = PAYLOAD2HEADER(ptr);
+    if (header->marked) {
+        return ptr;
+    }
+    if (!__sync_bool_compare_and_swap(&header->marked, FALSE, TRUE)) {
+        return ptr;
+    }
+    if (header->keeper != NULL) {
+        push_to_marker(env, ENV2MARKER(env), PTR2VAL(ptr));
+    }
+    return ptr;
+}
+
+static BOOL
+steal(YogEnv* env, Marker* marker)
+{
+    YogMarkers* markers = marker->markers;
+    uint_t self = marker - markers->markers;
+    uint_t i;
+    for (i = 1; i < markers->num; i++) {
+        Marker* victim = &markers->markers[(self + i) % markers->num];
+        if (victim->stack.pos == 0) {
+            continue;
+        }
+
+        YogVal stolen[STEAL_MAX];
+        lock_mutex(env, &victim->lock);
+        uint_t pos = victim->stack.pos;
+        uint_t n = pos - pos / 2;
+        n = n < STEAL_MAX ? n : STEAL_MAX;
+        memcpy(stolen, &victim->stack.ptr[pos - n], sizeof(YogVal) * n);
+        victim->stack.pos = pos - n;
+        unlock_mutex(env, &victim->lock);
+        if (n == 0) {
+            continue;
+        }
+
+        lock_mutex(env, &marker->lock);
+        uint_t j;
+        for (j = 0; j < n; j++) {
+            push_to_stack(env, &marker->stack, stolen[j]);
+        }
+        unlock_mutex(env, &marker->lock);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static BOOL
+has_work(YogMarkers* markers)
+{
+    uint_t i;
+    for (i = 0; i < markers->num; i++) {
+        if (0 < markers->markers[i].stack.pos) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static BOOL
+wait_for_work(YogMarkers* markers)
+{
+    __sync_fetch_and_add(&markers->idle_num, 1);
+    while (markers->idle_num < markers->num) {
+        if (has_work(markers)) {
+            __sync_fetch_and_sub(&markers->idle_num, 1);
+            return TRUE;
+        }
+        sched_yield();
+    }
+    return FALSE;
+}
+
+static void
+drain(Marker* marker)
+{
+    YogEnv* env = &marker->env;
+    do {
+        YogVal v;
+        while (pop_from_marker(env, marker, &v)) {
+            void* ptr = VAL2PTR(v);
+            (*PAYLOAD2HEADER(ptr)->keeper)(env, ptr, keep_object_in_parallel, NULL);
+        }
+    } while (steal(env, marker) || wait_for_work(marker->markers));
+}
+
+static void*
+marker_main(void* arg)
+{
+    Marker* marker = (Marker*)arg;
+    YogMarkers* markers = marker->markers;
+    YogEnv* env = &marker->env;
+    uint_t gc_id = 0;
+
+    lock_mutex(env, &markers->lock);
+    while (TRUE) {
+        while (!markers->exiting && (markers->gc_id == gc_id)) {
+            if (pthread_cond_wait(&markers->start_cond, &markers->lock) != 0) {
+                YOG_BUG(env, "pthread_cond_wait failed");
+            }
+        }
+        if (markers->exiting) {
+            break;
+        }
+        gc_id = markers->gc_id;
+        unlock_mutex(env, &markers->lock);
+
+        drain(marker);
+
+        lock_mutex(env, &markers->lock);
+        markers->running_num--;
+        if ((markers->running_num == 0) && (pthread_cond_signal(&markers->finish_cond) != 0)) {
+            YOG_BUG(env, "pthread_cond_signal failed");
+        }
+    }
+    unlock_mutex(env, &markers->lock);
+
+    return NULL;
+}
+
+static void
+Marker_init(YogEnv* env, Marker* marker, YogMarkers* markers)
+{
+    marker->env = *env;
+    marker->markers = markers;
+    if (pthread_mutex_init(&marker->lock, NULL) != 0) {
+        YOG_BUG(env, "pthread_mutex_init failed");
+    }
+    marker->stack.ptr = NULL;
+    marker->stack.size = marker->stack.pos = 0;
+}
+
+YogMarkers*
+YogMarkSweepCompact_new_markers(YogEnv* env, uint_t num)
+{
+    YogMarkers* markers = (YogMarkers*)YogGC_malloc(env, sizeof(YogMarkers));
+    markers->num = num;
+    markers->markers = (Marker*)YogGC_malloc(env, sizeof(Marker) * num);
+    if (pthread_mutex_init(&markers->lock, NULL) != 0) {
+        YOG_BUG(env, "pthread_mutex_init failed");
+    }
+    if (pthread_cond_init(&markers->start_cond, NULL) != 0) {
+        YOG_BUG(env, "pthread_cond_init failed");
+    }
+    if (pthread_cond_init(&markers->finish_cond, NULL) != 0) {
+        YOG_BUG(env, "pthread_cond_init failed");
+    }
+    markers->gc_id = 0;
+    markers->running_num = 0;
+    markers->exiting = FALSE;
+    markers->idle_num = 0;
+
+    uint_t i;
+    for (i = 0; i < num; i++) {
+        Marker_init(env, &markers->markers[i], markers);
+    }
+    for (i = 1; i < num; i++) {
+        Marker* marker = &markers->markers[i];
+        if (pthread_create(&marker->thread, NULL, marker_main, marker) != 0) {
+            YOG_BUG(env, "pthread_create failed");
+        }
+    }
+
+    return markers;
+}
+
+void
+YogMarkSweepCompact_delete_markers(YogEnv* env, YogMarkers* markers)
+{
+    lock_mutex(env, &markers->lock);
+    markers->exiting = TRUE;
+    if (pthread_cond_broadcast(&markers->start_cond) != 0) {
+        YOG_BUG(env, "pthread_cond_broadcast failed");
+    }
+    unlock_mutex(env, &markers->lock);
+
+    uint_t i;
+    for (i = 0; i < markers->num; i++) {
+        Marker* marker = &markers->markers[i];
+        if ((0 < i) && (pthread_join(marker->thread, NULL) != 0)) {
+            YOG_BUG(env, "pthread_join failed");
+        }
+        pthread_mutex_destroy(&marker->lock);
+        free(marker->stack.ptr);
+    }
+    pthread_cond_destroy(&markers->finish_cond);
+    pthread_cond_destroy(&markers->start_cond);
+    pthread_mutex_destroy(&markers->lock);
+    YogGC_free(env, markers->markers, sizeof(Marker) * markers->num);
+    YogGC_free(env, markers, sizeof(YogMarkers));
+}
+
+static void
+distribute_roots(YogEnv* env, YogMarkers* markers)
+{
+    uint_t n = 0;
+    YogHeap* heap;
+    for (heap = env->vm->heaps; heap != NULL; heap = heap->next) {
+        YogMarkedObjects* mo = heap->cur_marked_objects;
+        uint_t i;
+        for (i = 0; i < mo->pos; i++) {
+            Marker* marker = &markers->markers[n % markers->num];
+            push_to_stack(env, &marker->stack, mo->ptr[i]);
+            n++;
+        }
+        mo->pos = 0;
+    }
+}
+
+/**
+ * Scans children of objects which YogMarkSweepCompact_keep_root marked.
+ */
+void
+YogMarkSweepCompact_mark_in_parallel(YogEnv* env, YogMarkers* markers)
+{
+    uint_t i;
+    for (i = 0; i < markers->num; i++) {
+        Marker* marker = &markers->markers[i];
+        marker->env = *env;
+        marker->stack.pos = 0;
+    }
+    distribute_roots(env, markers);
+    markers->idle_num = 0;
+
+    lock_mutex(env, &markers->lock);
+    markers->running_num = markers->num - 1;
+    markers->gc_id++;
+    if (pthread_cond_broadcast(&markers->start_cond) != 0) {
+        YOG_BUG(env, "pthread_cond_broadcast failed");
+    }
+    unlock_mutex(env, &markers->lock);
+
+    drain(&markers->markers[0]);
+
+    lock_mutex(env, &markers->lock);
+    while (markers->running_num != 0) {
+        if (pthread_cond_wait(&markers->finish_cond, &markers->lock) != 0) {
+            YOG_BUG(env, "pthread_cond_wait failed");
+        }
+    }
+    unlock_mutex(env, &markers->lock);
+}
+#endif
+
 #if defined(GC_GENERATIONAL)
 ChildrenKeeper
 YogMarkSweepCompact_get_children_keeper(YogEnv* env, YogHeap* heap, void* ptr)
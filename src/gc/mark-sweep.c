@@ -2,13 +2,22 @@
 #include <string.h>
 #include "yog/gc.h"
 #include "yog/gc/mark-sweep.h"
+#include "yog/misc.h"
 #include "yog/vm.h"
 #include "yog/yog.h"
 
+/**
+ * Sweeping is lazy in the same way as the mark-sweep-compact GC. See "Lazy
+ * Sweeping" in src/gc/mark-sweep-compact.c.
+ */
+#define SWEEP_RATIO 2
+
 struct MarkSweep {
     struct YogHeap base;
 
     struct Header* header;
+    struct Header* sweep_cursor;
+    struct Header* finalizees;
     size_t threshold;
     size_t allocated_size;
 };
@@ -64,10 +73,59 @@ delete(YogEnv* env, MarkSweep* ms, Header* header)
     ms->allocated_size -= size;
 }
 
+/**
+ * Sweeps objects from sweep_cursor until size bytes are visited. Returns FALSE
+ * when there is nothing to sweep.
+ */
+static BOOL
+sweep(YogEnv* env, MarkSweep* ms, size_t size)
+{
+    Header* header = ms->sweep_cursor;
+    if (header == NULL) {
+        return FALSE;
+    }
+    size_t swept_size = 0;
+    while ((header != NULL) && (swept_size < size)) {
+        Header* current = header;
+        header = header->next;
+        swept_size += current->size;
+        if (current->marked) {
+            continue;
+        }
+        DELETE_FROM_LIST(ms->header, current);
+        if (current->finalizer != NULL) {
+            ADD_TO_LIST(ms->finalizees, current);
+            continue;
+        }
+        delete(env, ms, current);
+    }
+    ms->sweep_cursor = header;
+    return TRUE;
+}
+
+static void
+finish_sweeping(YogEnv* env, MarkSweep* ms)
+{
+    while (sweep(env, ms, ms->threshold)) {
+    }
+}
+
+static void
+run_finalizers(YogEnv* env, MarkSweep* ms)
+{
+    while (ms->finalizees != NULL) {
+        Header* header = ms->finalizees;
+        DELETE_FROM_LIST(ms->finalizees, header);
+        finalize(env, header);
+        delete(env, ms, header);
+    }
+}
+
 void
 YogMarkSweep_prepare(YogEnv* env, YogHeap* heap)
 {
     MarkSweep* ms = (MarkSweep*)heap;
+    finish_sweeping(env, ms);
     Header* header = ms->header;
     while (header != NULL) {
         header->marked = FALSE;
@@ -76,31 +134,35 @@ YogMarkSweep_prepare(YogEnv* env, YogHeap* heap)
 }
 
 void
-YogMarkSweep_delete_garbage(YogEnv* env, YogHeap* heap)
+YogMarkSweep_start_sweeping(YogEnv* env, YogHeap* heap)
 {
     MarkSweep* ms = (MarkSweep*)heap;
-    Header* header = ms->header;
-    while (header != NULL) {
-        Header* next = header->next;
-
-        if (!header->marked) {
-            finalize(env, header);
+    ms->sweep_cursor = ms->header;
+}
 
-            if (header->prev != NULL) {
-                header->prev->next = next;
-            }
-            else {
-                ms->header = next;
-            }
-            if (next != NULL) {
-                next->prev = header->prev;
-            }
+/**
+ * Sweeps all garbage at once and runs finalizers. This is for heaps of
+ * finished threads.
+ */
+void
+YogMarkSweep_delete_garbage(YogEnv* env, YogHeap* heap)
+{
+    MarkSweep* ms = (MarkSweep*)heap;
+    YogMarkSweep_start_sweeping(env, heap);
+    finish_sweeping(env, ms);
+    run_finalizers(env, ms);
+}
 
-            delete(env, ms, header);
-        }
+BOOL
+YogMarkSweep_is_marked(YogEnv* env, void* ptr)
+{
+    return ((Header*)ptr - 1)->marked;
+}
 
-        header = next;
-    }
+size_t
+YogMarkSweep_get_size(YogEnv* env, YogHeap* heap)
+{
+    return ((MarkSweep*)heap)->allocated_size;
 }
 
 YogHeap*
@@ -110,6 +172,8 @@ YogMarkSweep_new(YogEnv* env, size_t threshold)
     YogHeap_init(env, (YogHeap*)heap);
 
     heap->header = NULL;
+    heap->sweep_cursor = NULL;
+    heap->finalizees = NULL;
     heap->threshold = threshold;
     heap->allocated_size = 0;
 
@@ -120,6 +184,7 @@ void
 YogMarkSweep_delete(YogEnv* env, YogHeap* heap)
 {
     MarkSweep* ms = (MarkSweep*)heap;
+    run_finalizers(env, ms);
     Header* header = ms->header;
     while (header != NULL) {
         Header* next = header->next;
@@ -135,11 +200,17 @@ void*
 YogMarkSweep_alloc(YogEnv* env, YogHeap* heap, ChildrenKeeper keeper, Finalizer finalizer, size_t size)
 {
     MarkSweep* ms = (MarkSweep*)heap;
+    run_finalizers(env, ms);
+    size_t total_size = size + sizeof(Header);
+    sweep(env, ms, SWEEP_RATIO * total_size);
+    if (ms->threshold <= ms->allocated_size) {
+        finish_sweeping(env, ms);
+        run_finalizers(env, ms);
+    }
     if (env->vm->gc_stress || (ms->threshold <= ms->allocated_size)) {
         YogGC_perform(env);
     }
 
-    size_t total_size = size + sizeof(Header);
     Header* header = (Header*)YogGC_malloc(env, total_size);
     header->prev = NULL;
     header->next = ms->header;
@@ -168,7 +239,7 @@ BOOL
 YogMarkSweep_is_empty(YogEnv* env, YogHeap* heap)
 {
     MarkSweep* ms = (MarkSweep*)heap;
-    if (ms->header == NULL) {
+    if ((ms->header == NULL) && (ms->finalizees == NULL)) {
         return TRUE;
     }
     return FALSE;
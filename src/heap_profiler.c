@@ -0,0 +1,511 @@
+#include "yog/config.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "yog/callable.h"
+#include "yog/class.h"
+#include "yog/code.h"
+#include "yog/error.h"
+#include "yog/frame.h"
+#include "yog/heap_profiler.h"
+#include "yog/object.h"
+#include "yog/string.h"
+#include "yog/sysdeps.h"
+#include "yog/thread.h"
+#include "yog/vm.h"
+#include "yog/yog.h"
+
+/**
+ * = Heap Profiler
+ *
+ * The heap profiler samples one allocation in every rate bytes of each
+ * thread. A sample remembers the object, the Yog stack of the allocation and
+ * the class of the object. The class is known at YogBasicObj_init, which
+ * follows the allocation. Other objects (bodies of arrays and strings) are
+ * shown as <internal>. A sample stands for max(size, rate) bytes.
+ *
+ * Sampling must not allocate GC objects, because the new object is not
+ * initialized yet. So a stack is a list of IDs and line numbers. Names are
+ * given at writing.
+ *
+ * Every GC forwards samples to new addresses of their objects. A sample of a
+ * dead object is counted into the allocation profile and is freed. After a
+ * major GC, living samples are counted by class for the live heap dump.
+ *
+ * The allocation profile is written at exit as folded stacks, which
+ * flamegraph.pl reads. Its leaves are classes. The live heap dump is written
+ * to path.live after every major GC.
+ */
+
+#define MAX_DEPTH   64
+#define STACKS_NUM  1024
+
+struct Frame {
+    ID class_name;
+    ID func_name;
+    uint_t lineno;
+};
+
+typedef struct Frame Frame;
+
+struct Site {
+    struct Site* next;
+    ID class_name;
+    uint64_t size;
+};
+
+typedef struct Site Site;
+
+struct Stack {
+    struct Stack* next;
+    uint_t hash;
+    struct Site* sites;
+    uint_t frames_num;
+    struct Frame frames[0];
+};
+
+typedef struct Stack Stack;
+
+struct YogHeapSample {
+    struct YogHeapSample* next;
+    void* ptr;
+    ID class_name;
+    size_t size;
+    struct Stack* stack;
+    BOOL pending;
+};
+
+typedef struct YogHeapSample YogHeapSample;
+
+struct ClassSize {
+    ID class_name;
+    uint64_t size;
+};
+
+typedef struct ClassSize ClassSize;
+
+struct YogHeapProfiler {
+    pthread_mutex_t lock;
+    const char* path;
+    size_t rate;
+    struct Stack* stacks[STACKS_NUM];
+    struct YogHeapSample* samples;
+
+    struct ClassSize* live;
+    uint_t live_num;
+    uint_t live_size;
+    BOOL live_updated;
+};
+
+static void*
+malloc_or_die(YogEnv* env, size_t size)
+{
+    void* ptr = malloc(size);
+    if (ptr == NULL) {
+        YOG_BUG(env, "can't allocate memory for the heap profiler");
+    }
+    return ptr;
+}
+
+YogHeapProfiler*
+YogHeapProfiler_new(YogEnv* env, const char* path, size_t rate)
+{
+    YogHeapProfiler* prof = (YogHeapProfiler*)malloc_or_die(env, sizeof(YogHeapProfiler));
+    pthread_mutex_init(&prof->lock, NULL);
+    prof->path = path;
+    prof->rate = 0 < rate ? rate : 1;
+    uint_t i;
+    for (i = 0; i < STACKS_NUM; i++) {
+        prof->stacks[i] = NULL;
+    }
+    prof->samples = NULL;
+    prof->live = NULL;
+    prof->live_num = prof->live_size = 0;
+    prof->live_updated = FALSE;
+    return prof;
+}
+
+void
+YogHeapProfiler_delete(YogEnv* env, YogHeapProfiler* prof)
+{
+    YogHeapSample* sample = prof->samples;
+    while (sample != NULL) {
+        YogHeapSample* next = sample->next;
+        free(sample);
+        sample = next;
+    }
+    uint_t i;
+    for (i = 0; i < STACKS_NUM; i++) {
+        Stack* stack = prof->stacks[i];
+        while (stack != NULL) {
+            Stack* next = stack->next;
+            Site* site = stack->sites;
+            while (site != NULL) {
+                Site* next_site = site->next;
+                free(site);
+                site = next_site;
+            }
+            free(stack);
+            stack = next;
+        }
+    }
+    free(prof->live);
+    pthread_mutex_destroy(&prof->lock);
+    free(prof);
+}
+
+static uint_t
+walk_stack(YogEnv* env, Frame* frames)
+{
+    uint_t n = 0;
+    YogVal frame = env->frame;
+    while (IS_PTR(frame) && (n < MAX_DEPTH)) {
+        Frame* f = &frames[n];
+        switch (PTR_AS(YogFrame, frame)->type) {
+        case FRAME_C:
+            {
+                YogVal func = PTR_AS(YogCFrame, frame)->f;
+                f->lineno = 0;
+                if (IS_PTR(func) && (BASIC_OBJ_TYPE(func) == TYPE_NATIVE_FUNCTION)) {
+                    f->class_name = PTR_AS(YogNativeFunction, func)->class_name;
+                    f->func_name = PTR_AS(YogNativeFunction, func)->func_name;
+                }
+                else {
+                    f->class_name = f->func_name = INVALID_ID;
+                }
+                n++;
+            }
+            break;
+        case FRAME_SCRIPT:
+            {
+                YogVal code = PTR_AS(YogScriptFrame, frame)->code;
+                pc_t pc = PTR_AS(YogScriptFrame, frame)->pc;
+                uint_t lineno = 0;
+                YogCode_get_lineno(env, code, 0 < pc ? pc - 1 : 0, &lineno);
+                f->lineno = lineno;
+                f->class_name = PTR_AS(YogCode, code)->class_name;
+                f->func_name = PTR_AS(YogCode, code)->func_name;
+                n++;
+            }
+            break;
+        case FRAME_FINISH:
+        default:
+            break;
+        }
+        frame = PTR_AS(YogFrame, frame)->prev;
+    }
+    return n;
+}
+
+static uint_t
+hash_frames(Frame* frames, uint_t n)
+{
+    uint_t h = n;
+    uint_t i;
+    for (i = 0; i < n; i++) {
+        h = h * 31 + frames[i].class_name;
+        h = h * 31 + frames[i].func_name;
+        h = h * 31 + frames[i].lineno;
+    }
+    return h;
+}
+
+static Stack*
+find_or_add_stack(YogEnv* env, YogHeapProfiler* prof, Frame* frames, uint_t n)
+{
+    uint_t hash = hash_frames(frames, n);
+    Stack** bucket = &prof->stacks[hash % STACKS_NUM];
+    Stack* stack;
+    for (stack = *bucket; stack != NULL; stack = stack->next) {
+        if ((stack->hash != hash) || (stack->frames_num != n)) {
+            continue;
+        }
+        if (memcmp(stack->frames, frames, sizeof(Frame) * n) == 0) {
+            return stack;
+        }
+    }
+
+    stack = (Stack*)malloc_or_die(env, sizeof(Stack) + sizeof(Frame) * n);
+    stack->hash = hash;
+    stack->sites = NULL;
+    stack->frames_num = n;
+    memcpy(stack->frames, frames, sizeof(Frame) * n);
+    stack->next = *bucket;
+    *bucket = stack;
+    return stack;
+}
+
+/**
+ * Called by YogGC_alloc for each allocation of a thread while profiling.
+ */
+void
+YogHeapProfiler_sample(YogEnv* env, YogHeapProfiler* prof, void* ptr, size_t size)
+{
+    YogThread* thread = PTR_AS(YogThread, env->thread);
+    if (size < thread->bytes_to_sample) {
+        thread->bytes_to_sample -= size;
+        return;
+    }
+    size_t rate = prof->rate;
+    thread->bytes_to_sample = rate;
+
+    Frame frames[MAX_DEPTH];
+    uint_t n = walk_stack(env, frames);
+
+    pthread_mutex_lock(&prof->lock);
+    YogHeapSample* sample = (YogHeapSample*)malloc_or_die(env, sizeof(YogHeapSample));
+    sample->ptr = ptr;
+    sample->class_name = INVALID_ID;
+    sample->size = size < rate ? rate : size;
+    sample->stack = find_or_add_stack(env, prof, frames, n);
+    sample->pending = TRUE;
+    sample->next = prof->samples;
+    prof->samples = sample;
+    if (thread->heap_sample != NULL) {
+        thread->heap_sample->pending = FALSE;
+    }
+    thread->heap_sample = sample;
+    pthread_mutex_unlock(&prof->lock);
+}
+
+/**
+ * Called by YogBasicObj_init. Gives the class to the last sample of the
+ * thread if obj is the sampled object.
+ */
+void
+YogHeapProfiler_set_class(YogEnv* env, YogHeapProfiler* prof, YogVal obj, YogVal klass)
+{
+    YogHeapSample* sample = PTR_AS(YogThread, env->thread)->heap_sample;
+    if ((sample == NULL) || (sample->ptr != VAL2PTR(obj)) || !IS_PTR(klass)) {
+        return;
+    }
+    sample->class_name = PTR_AS(YogClass, klass)->name;
+}
+
+static void
+count_site(YogEnv* env, YogHeapSample* sample)
+{
+    Stack* stack = sample->stack;
+    Site* site;
+    for (site = stack->sites; site != NULL; site = site->next) {
+        if (site->class_name == sample->class_name) {
+            site->size += sample->size;
+            return;
+        }
+    }
+    site = (Site*)malloc_or_die(env, sizeof(Site));
+    site->class_name = sample->class_name;
+    site->size = sample->size;
+    site->next = stack->sites;
+    stack->sites = site;
+}
+
+static void
+count_live(YogEnv* env, YogHeapProfiler* prof, YogHeapSample* sample)
+{
+    uint_t i;
+    for (i = 0; i < prof->live_num; i++) {
+        if (prof->live[i].class_name == sample->class_name) {
+            prof->live[i].size += sample->size;
+            return;
+        }
+    }
+    if (prof->live_size <= prof->live_num) {
+        uint_t size = prof->live_size + 64;
+        ClassSize* live = (ClassSize*)realloc(prof->live, sizeof(ClassSize) * size);
+        if (live == NULL) {
+            return;
+        }
+        prof->live = live;
+        prof->live_size = size;
+    }
+    prof->live[prof->live_num].class_name = sample->class_name;
+    prof->live[prof->live_num].size = sample->size;
+    prof->live_num++;
+}
+
+/**
+ * Called by GC after marking and before sweeping. forward returns the new
+ * address of an object (or NULL for a dead one) with param. When major is
+ * TRUE, living samples are counted by class.
+ */
+void
+YogHeapProfiler_update(YogEnv* env, YogHeapProfiler* prof, YogSampleForwarder forward, void* param, BOOL major)
+{
+    pthread_mutex_lock(&prof->lock);
+    if (major) {
+        prof->live_num = 0;
+    }
+    YogHeapSample** prev = &prof->samples;
+    YogHeapSample* sample = prof->samples;
+    while (sample != NULL) {
+        YogHeapSample* next = sample->next;
+        if (sample->ptr != NULL) {
+            void* ptr = (*forward)(env, sample->ptr, param);
+            if (ptr != sample->ptr) {
+                sample->ptr = ptr;
+            }
+            if (ptr == NULL) {
+                count_site(env, sample);
+            }
+            else if (major) {
+                count_live(env, prof, sample);
+            }
+        }
+        if ((sample->ptr == NULL) && !sample->pending) {
+            *prev = next;
+            free(sample);
+        }
+        else {
+            prev = &sample->next;
+        }
+        sample = next;
+    }
+    if (major) {
+        prof->live_updated = TRUE;
+    }
+    pthread_mutex_unlock(&prof->lock);
+}
+
+static void
+write_name(YogEnv* env, FILE* fp, ID id)
+{
+    YogVal s = YogVM_id2name(env, env->vm, id);
+    uint_t size = STRING_SIZE(s);
+    uint_t i;
+    for (i = 0; i < size; i++) {
+        YogChar c = STRING_CHARS(s)[i];
+        fputc((c < 0x80) && (c != ';') && (c != ' ') ? (int)c : '?', fp);
+    }
+}
+
+static void
+write_class(YogEnv* env, FILE* fp, ID class_name)
+{
+    if (class_name == INVALID_ID) {
+        fputs("<internal>", fp);
+        return;
+    }
+    write_name(env, fp, class_name);
+}
+
+static void
+write_frame(YogEnv* env, FILE* fp, Frame* frame)
+{
+    if (frame->func_name == INVALID_ID) {
+        fputs("<native>", fp);
+        return;
+    }
+    if (frame->class_name != INVALID_ID) {
+        write_name(env, fp, frame->class_name);
+        fputc('#', fp);
+    }
+    write_name(env, fp, frame->func_name);
+    if (0 < frame->lineno) {
+        fprintf(fp, ":%u", (unsigned int)frame->lineno);
+    }
+}
+
+static FILE*
+open_output(YogEnv* env, const char* path, const char* suffix)
+{
+    char* name = (char*)YogSysdeps_alloca(strlen(path) + strlen(suffix) + 1);
+    strcpy(name, path);
+    strcat(name, suffix);
+    FILE* fp = fopen(name, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "can't open %s: %s\n", name, strerror(errno));
+    }
+    return fp;
+}
+
+static int
+compare_class_sizes(const void* a, const void* b)
+{
+    uint64_t x = ((const ClassSize*)a)->size;
+    uint64_t y = ((const ClassSize*)b)->size;
+    return x < y ? 1 : (y < x ? -1 : 0);
+}
+
+/**
+ * Writes the live heap by class at the last major GC into path.live. This is
+ * called out of GC, because names of classes are looked up with locks.
+ */
+void
+YogHeapProfiler_dump_live(YogEnv* env, YogHeapProfiler* prof)
+{
+    pthread_mutex_lock(&prof->lock);
+    if (!prof->live_updated) {
+        pthread_mutex_unlock(&prof->lock);
+        return;
+    }
+    prof->live_updated = FALSE;
+    uint_t num = prof->live_num;
+    ClassSize* live = (ClassSize*)YogSysdeps_alloca(sizeof(ClassSize) * num);
+    memcpy(live, prof->live, sizeof(ClassSize) * num);
+    pthread_mutex_unlock(&prof->lock);
+
+    qsort(live, num, sizeof(ClassSize), compare_class_sizes);
+    FILE* fp = open_output(env, prof->path, ".live");
+    if (fp == NULL) {
+        return;
+    }
+    uint_t i;
+    for (i = 0; i < num; i++) {
+        write_class(env, fp, live[i].class_name);
+        fprintf(fp, " %llu\n", (unsigned long long)live[i].size);
+    }
+    fclose(fp);
+}
+
+static void
+write_stack(YogEnv* env, FILE* fp, Stack* stack)
+{
+    Site* site;
+    for (site = stack->sites; site != NULL; site = site->next) {
+        int_t i;
+        for (i = stack->frames_num - 1; 0 <= i; i--) {
+            write_frame(env, fp, &stack->frames[i]);
+            fputc(';', fp);
+        }
+        write_class(env, fp, site->class_name);
+        fprintf(fp, " %llu\n", (unsigned long long)site->size);
+    }
+}
+
+/**
+ * Writes the allocation profile into path. Samples of living objects are
+ * counted here.
+ */
+void
+YogHeapProfiler_write(YogEnv* env, YogHeapProfiler* prof)
+{
+    pthread_mutex_lock(&prof->lock);
+    YogHeapSample* sample;
+    for (sample = prof->samples; sample != NULL; sample = sample->next) {
+        if (sample->ptr != NULL) {
+            count_site(env, sample);
+            sample->ptr = NULL;
+        }
+    }
+    pthread_mutex_unlock(&prof->lock);
+
+    FILE* fp = open_output(env, prof->path, "");
+    if (fp == NULL) {
+        return;
+    }
+    uint_t i;
+    for (i = 0; i < STACKS_NUM; i++) {
+        Stack* stack;
+        for (stack = prof->stacks[i]; stack != NULL; stack = stack->next) {
+            write_stack(env, fp, stack);
+        }
+    }
+    fclose(fp);
+}
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
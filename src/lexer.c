@@ -1244,7 +1244,14 @@ YogLexer_read_encoding(YogEnv* env, YogVal lexer)
     SAVE_LOCALS(env);
     PUSH_LOCAL(env, lexer);
 
+    /**
+     * A file without a coding comment is decoded in the default encoding,
+     * which comes from LANG. See src/code_cache.c.
+     */
     YogVal enc = read_encoding(env, lexer);
+    if (!IS_PTR(enc)) {
+        enc = env->vm->default_encoding;
+    }
     if (!IS_PTR(enc)) {
         enc = YogEncoding_get_default(env);
     }
@@ -20,15 +20,26 @@
 #include "yog/code.h"
 #include "yog/error.h"
 #include "yog/eval.h"
+#include "yog/gc.h"
 #include "yog/handle.h"
+#include "yog/heap_profiler.h"
 #include "yog/package.h"
 #include "yog/path.h"
 #include "yog/repl.h"
 #include "yog/string.h"
+#include "yog/sysdeps.h"
 #include "yog/thread.h"
 #include "yog/vm.h"
 #include "yog/yog.h"
 
+/**
+ * The boot snapshot is written at the first start of each version, so it is
+ * kept in the cache directory of the user ($XDG_CACHE_HOME or ~/.cache).
+ */
+#define BOOT_SNAPSHOT   "yog/" YOG_PACKAGE_VERSION "/boot.yogc"
+#define GC_THREADS_MAX  16
+#define HEAP_HEADROOM_MAX   10000
+
 static void
 print_version()
 {
@@ -52,13 +63,35 @@ usage()
 {
     puts("yog [options] [file]");
     puts("options:");
+    puts("  --boot-snapshot=path: read/write compiled builtin scripts at path (default ~/.cache/" BOOT_SNAPSHOT ")");
     puts("  --debug-import: print importing log");
+    puts("  --gc-pause-target=ms: resize the young generation to pause for less than ms (generational GC)");
+    puts("  --gc-stats: print statistics of GC at exit");
     puts("  --gc-stress:");
+    puts("  --gc-threads=n: mark objects with n threads (mark-sweep-compact GC)");
     puts("  --help: show this message");
+    puts("  --heap-headroom=percent: keep free arenas up to percent of living objects (default 50)");
+    puts("  --heap-profile=path: write sampled allocations to path and living objects to path.live");
+    puts("  --heap-profile-rate=size: sample an allocation in every size bytes (default 512K)");
     puts("  --heap-size=size:");
+    puts("  --no-boot-snapshot: compile builtin scripts at every start");
+    puts("  --no-code-cache: don't read or write .yogc files");
     puts("  --version: print version");
 }
 
+static const char*
+get_cache_home(const char** subdir)
+{
+    const char* dir = getenv("XDG_CACHE_HOME");
+    if ((dir != NULL) && (dir[0] != '\0')) {
+        *subdir = "";
+        return dir;
+    }
+    *subdir = "/.cache";
+    dir = getenv("HOME");
+    return (dir != NULL) && (dir[0] != '\0') ? dir : NULL;
+}
+
 static size_t
 parse_size(const char* s)
 {
@@ -94,6 +127,34 @@ parse_size(const char* s)
     return total_size;
 }
 
+static uint_t
+parse_uint(const char* s, const char* name, uint_t min, uint_t max)
+{
+    char* end = NULL;
+    errno = 0;
+    long n = strtol(s, &end, 10);
+    if ((errno != 0) || (end == s) || (*end != '\0') || (n < (long)min) || ((long)max < n)) {
+        fprintf(stderr, "Invalid %s.\n", name);
+        usage();
+        exit(1);
+    }
+    return n;
+}
+
+static uint_t
+get_default_gc_threads_num()
+{
+#if defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) {
+        return 1;
+    }
+    return GC_THREADS_MAX < n ? GC_THREADS_MAX : n;
+#else
+    return 1;
+#endif
+}
+
 static void
 proc_stdin(YogEnv* env)
 {
@@ -230,22 +291,42 @@ int
 main(int argc, char* argv[])
 {
     int debug_import = 0;
+    int gc_stats = 0;
     int help = 0;
+    int no_boot_snapshot = 0;
+    int no_code_cache = 0;
     uint_t gc_stress_level = 0;
+    uint_t gc_threads_num = get_default_gc_threads_num();
+    uint_t heap_headroom = 50;
     size_t young_heap_size = 1 * 1024 * 1024;
     size_t old_heap_size = 1 * 1024 * 1024;
 #if !defined(GC_GENERATIONAL)
     size_t heap_size = young_heap_size + old_heap_size;
 #endif
     uint_t max_age = 32;
+#if defined(GC_GENERATIONAL)
+    uint_t gc_pause_target = 10;
+#endif
     char* lib_path = NULL;
+    const char* boot_snapshot = NULL;
+    const char* heap_profile = NULL;
+    size_t heap_profile_rate = 512 * 1024;
     struct option options[] = {
+        { "boot-snapshot", required_argument, NULL, 'b' },
         { "debug-import", no_argument, &debug_import, 1 },
+        { "gc-pause-target", required_argument, NULL, 'p' },
+        { "gc-stats", no_argument, &gc_stats, 1 },
         { "gc-stress", no_argument, NULL, 'g' },
+        { "gc-threads", required_argument, NULL, 't' },
+        { "heap-headroom", required_argument, NULL, 'H' },
+        { "heap-profile", required_argument, NULL, 'h' },
+        { "heap-profile-rate", required_argument, NULL, 'r' },
         { "heap-size", required_argument, NULL, 'i' },
         { "help", no_argument, &help, 1 },
         { "lib-path", required_argument, NULL, 'I' },
         { "max-age", required_argument, NULL, 'a' },
+        { "no-boot-snapshot", no_argument, &no_boot_snapshot, 1 },
+        { "no-code-cache", no_argument, &no_code_cache, 1 },
         { "old-heap-size", required_argument, NULL, 'o' },
         { "version", no_argument, NULL, 'v' },
         { "young-heap-size", required_argument, NULL, 'y' },
@@ -256,6 +337,9 @@ main(int argc, char* argv[])
         switch (c) {
         case 0:
             break;
+        case 'H':
+            heap_headroom = parse_uint(optarg, "heap headroom", 0, HEAP_HEADROOM_MAX);
+            break;
         case 'I':
             lib_path = (char*)alloca(strlen(optarg) + 1);
             strcpy(lib_path, optarg);
@@ -263,9 +347,15 @@ main(int argc, char* argv[])
         case 'a':
             max_age = atoi(optarg);
             break;
+        case 'b':
+            boot_snapshot = optarg;
+            break;
         case 'g':
             gc_stress_level++;
             break;
+        case 'h':
+            heap_profile = optarg;
+            break;
         case 'i':
 #if !defined(GC_GENERATIONAL)
             heap_size = parse_size(optarg);
@@ -274,6 +364,21 @@ main(int argc, char* argv[])
         case 'o':
             old_heap_size = parse_size(optarg);
             break;
+        case 'p':
+#if defined(GC_GENERATIONAL)
+            gc_pause_target = parse_uint(optarg, "GC pause target", 1, UINT_MAX / 1000);
+#endif
+            break;
+        case 'r':
+            heap_profile_rate = parse_size(optarg);
+            break;
+        case 't':
+            gc_threads_num = parse_uint(optarg, "number of GC threads", 1, GC_THREADS_MAX);
+#if !defined(GC_MARK_SWEEP_COMPACT)
+            fprintf(stderr, "--gc-threads is available only with the mark-sweep-compact GC.\n");
+            exit(1);
+#endif
+            break;
         case 'v':
             print_version();
             exit(0);
@@ -292,6 +397,16 @@ main(int argc, char* argv[])
         usage();
         return 0;
     }
+    if (boot_snapshot == NULL) {
+        const char* subdir;
+        const char* cache_home = get_cache_home(&subdir);
+        if (cache_home != NULL) {
+            size_t size = strlen(cache_home) + strlen(subdir) + strlen(BOOT_SNAPSHOT) + 2;
+            char* path = (char*)alloca(size);
+            YogSysdeps_snprintf(path, size, "%s%s/%s", cache_home, subdir, BOOT_SNAPSHOT);
+            boot_snapshot = path;
+        }
+    }
 
 #if defined(__MINGW32__) || defined(_MSC_VER)
     if (!pthread_win32_process_attach_np()) {
@@ -309,7 +424,14 @@ main(int argc, char* argv[])
     YogVM vm;
     YogVM_init(&vm);
     enable_gc_stress(&vm, gc_stress_level, 2);
+    vm.gc_threads_num = gc_threads_num;
+    vm.heap_headroom = heap_headroom;
+#if defined(GC_GENERATIONAL)
+    vm.gc_pause_target = gc_pause_target * 1000;
+#endif
     vm.debug_import = debug_import != 0 ? TRUE : FALSE;
+    vm.use_code_cache = no_code_cache != 0 ? FALSE : TRUE;
+    vm.boot_snapshot_path = no_boot_snapshot != 0 ? NULL : boot_snapshot;
     env.vm = &vm;
     YogVM_add_locals(&env, env.vm, &locals);
     YogVM_add_handles(&env, env.vm, &handles);
@@ -334,6 +456,9 @@ main(int argc, char* argv[])
     env.thread = main_thread;
     handles.heap = locals.heap = PTR_AS(YogThread, main_thread)->heap;
     YogVM_set_main_thread(&env, &vm, main_thread);
+    if (heap_profile != NULL) {
+        vm.heap_profiler = YogHeapProfiler_new(&env, heap_profile, heap_profile_rate);
+    }
 
     DECL_LOCALS(env_guard);
     env_guard.num_vals = 3;
@@ -372,6 +497,17 @@ main(int argc, char* argv[])
     YogVM_remove_thread(&env, env.vm, env.thread);
 
     YogVM_wait_finish(&env, env.vm);
+#if defined(PROFILE_INSTS)
+    YogEval_print_inst_profile(&env);
+#endif
+    if (gc_stats != 0) {
+        YogGC_print_stats(&env);
+    }
+    if (vm.heap_profiler != NULL) {
+        YogHeapProfiler_write(&env, vm.heap_profiler);
+        YogHeapProfiler_delete(&env, vm.heap_profiler);
+        vm.heap_profiler = NULL;
+    }
     YogVM_remove_handles(&env, env.vm, &handles);
     YogVM_remove_locals(&env, env.vm, &locals);
     YogVM_delete(&env, env.vm);
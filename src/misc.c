@@ -1,11 +1,10 @@
 #include "yog/config.h"
 #include "yog/binary.h"
-#include "yog/compile.h"
+#include "yog/code_cache.h"
 #include "yog/encoding.h"
 #include "yog/error.h"
 #include "yog/eval.h"
 #include "yog/handle.h"
-#include "yog/parser.h"
 #include "yog/sprintf.h"
 #include "yog/string.h"
 #include "yog/sysdeps.h"
@@ -89,10 +88,7 @@ YogMisc_format_method(YogEnv* env, YogHandle* class_name, YogHandle* func_name)
 void
 YogMisc_eval_source(YogEnv* env, YogHandle* obj, const char* src)
 {
-    YogHandle* name = VAL2HDL(env, YogString_from_string(env, "builtins"));
-    YogVal s = YogString_from_string(env, src);
-    YogVal stmts = YogParser_parse(env, s);
-    YogVal code = YogCompiler_compile_package(env, name, stmts);
+    YogVal code = YogCodeCache_get_boot_code(env, env->vm, src);
     YogEval_eval_package(env, obj, code);
 }
 
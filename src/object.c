@@ -5,8 +5,12 @@
 #include "yog/frame.h"
 #include "yog/gc.h"
 #include "yog/get_args.h"
+#include "yog/heap_profiler.h"
 #include "yog/misc.h"
+#include "yog/module.h"
 #include "yog/object.h"
+#include "yog/package.h"
+#include "yog/shape.h"
 #include "yog/sprintf.h"
 #include "yog/string.h"
 #include "yog/sysdeps.h"
@@ -18,6 +22,14 @@
 YogVal
 YogObj_get_attr(YogEnv* env, YogVal obj, ID name)
 {
+    YogVal shape = PTR_AS(YogObj, obj)->shape;
+    if (IS_PTR(shape)) {
+        int_t index = YogShape_find(env, shape, name);
+        if (index < 0) {
+            return YUNDEF;
+        }
+        return PTR_AS(YogValArray, PTR_AS(YogObj, obj)->attrs)->items[index];
+    }
     if (!IS_PTR(PTR_AS(YogObj, obj)->attrs)) {
         return YUNDEF;
     }
@@ -30,12 +42,110 @@ YogObj_get_attr(YogEnv* env, YogVal obj, ID name)
     return YUNDEF;
 }
 
+static BOOL
+can_have_shape(YogEnv* env, YogVal obj)
+{
+    if ((BASIC_OBJ_FLAGS(obj) & (FLAG_CLASS | FLAG_PKG)) != 0) {
+        return FALSE;
+    }
+    type_t type = BASIC_OBJ_TYPE(obj);
+    return (type != TYPE_MODULE) && (type != TYPE_PACKAGE);
+}
+
+static YogVal
+grow_slots(YogEnv* env, YogVal slots, uint_t size)
+{
+    SAVE_ARG(env, slots);
+    YogVal new_slots = YUNDEF;
+    PUSH_LOCAL(env, new_slots);
+
+#define MIN_SLOTS_SIZE  4
+    uint_t new_size = MIN_SLOTS_SIZE < 2 * size ? 2 * size : MIN_SLOTS_SIZE;
+#undef MIN_SLOTS_SIZE
+    new_slots = YogValArray_new(env, new_size);
+    uint_t i;
+    for (i = 0; i < size; i++) {
+        YogVal val = PTR_AS(YogValArray, slots)->items[i];
+        YogGC_UPDATE_PTR(env, PTR_AS(YogValArray, new_slots), items[i], val);
+    }
+
+    RETURN(env, new_slots);
+}
+
+static BOOL
+set_attr_to_slot(YogEnv* env, YogVal obj, ID name, YogVal val)
+{
+    SAVE_ARGS2(env, obj, val);
+    YogVal shape = YUNDEF;
+    YogVal slots = YUNDEF;
+    PUSH_LOCALS2(env, shape, slots);
+
+    shape = PTR_AS(YogObj, obj)->shape;
+    slots = PTR_AS(YogObj, obj)->attrs;
+    int_t index = YogShape_find(env, shape, name);
+    if (0 <= index) {
+        YogGC_UPDATE_PTR(env, PTR_AS(YogValArray, slots), items[index], val);
+        RETURN(env, TRUE);
+    }
+
+    uint_t size = PTR_AS(YogShape, shape)->size;
+    if (SHAPE_MAX_ATTRS <= size) {
+        RETURN(env, FALSE);
+    }
+    shape = YogShape_add(env, shape, name);
+    if (!IS_PTR(shape)) {
+        RETURN(env, FALSE);
+    }
+    if (!IS_PTR(slots) || (PTR_AS(YogValArray, slots)->size <= size)) {
+        slots = grow_slots(env, slots, size);
+        YogGC_UPDATE_PTR(env, PTR_AS(YogObj, obj), attrs, slots);
+    }
+    YogGC_UPDATE_PTR(env, PTR_AS(YogValArray, slots), items[size], val);
+    YogGC_UPDATE_PTR(env, PTR_AS(YogObj, obj), shape, shape);
+
+    RETURN(env, TRUE);
+}
+
+static void
+convert_slots_to_table(YogEnv* env, YogVal obj)
+{
+    SAVE_ARG(env, obj);
+    YogVal attrs = YUNDEF;
+    YogVal shape = YUNDEF;
+    PUSH_LOCALS2(env, attrs, shape);
+
+    attrs = YogTable_create_symbol_table(env);
+    shape = PTR_AS(YogObj, obj)->shape;
+    while (0 < PTR_AS(YogShape, shape)->size) {
+        YogVal slots = PTR_AS(YogObj, obj)->attrs;
+        uint_t index = PTR_AS(YogShape, shape)->size - 1;
+        YogVal val = PTR_AS(YogValArray, slots)->items[index];
+        YogTable_insert(env, attrs, ID2VAL(PTR_AS(YogShape, shape)->name), val);
+        shape = PTR_AS(YogShape, shape)->parent;
+    }
+    YogGC_UPDATE_PTR(env, PTR_AS(YogObj, obj), attrs, attrs);
+    PTR_AS(YogObj, obj)->shape = YUNDEF;
+
+    RETURN_VOID(env);
+}
+
 void
 YogObj_set_attr_id(YogEnv* env, YogVal obj, ID name, YogVal val)
 {
     SAVE_LOCALS(env);
     PUSH_LOCALS2(env, obj, val);
 
+    if (!IS_PTR(PTR_AS(YogObj, obj)->attrs) && can_have_shape(env, obj)) {
+        YogVal root = env->vm->root_shape;
+        YogGC_UPDATE_PTR(env, PTR_AS(YogObj, obj), shape, root);
+    }
+    if (IS_PTR(PTR_AS(YogObj, obj)->shape)) {
+        if (set_attr_to_slot(env, obj, name, val)) {
+            RETURN_VOID(env);
+        }
+        convert_slots_to_table(env, obj);
+    }
+
     YogVal key = ID2VAL(name);
 
     if (!IS_PTR(PTR_AS(YogObj, obj)->attrs)) {
@@ -44,6 +154,12 @@ YogObj_set_attr_id(YogEnv* env, YogVal obj, ID name, YogVal val)
     }
 
     YogTable_insert(env, PTR_AS(YogObj, obj)->attrs, key, val);
+    if ((BASIC_OBJ_FLAGS(obj) & FLAG_CLASS) != 0) {
+        YogClass_invalidate_attr_caches(env, obj);
+    }
+    else if (BASIC_OBJ_TYPE(obj) == TYPE_MODULE) {
+        env->vm->attr_cache_serial++;
+    }
 
     RETURN_VOID(env);
 }
@@ -66,6 +182,9 @@ YogBasicObj_init(YogEnv* env, YogVal obj, type_t type, uint_t flags, YogVal klas
     PTR_AS(YogBasicObj, obj)->type = type;
     PTR_AS(YogBasicObj, obj)->flags = flags;
     YogGC_UPDATE_PTR(env, PTR_AS(YogBasicObj, obj), klass, klass);
+    if (env->vm->heap_profiler != NULL) {
+        YogHeapProfiler_set_class(env, env->vm->heap_profiler, obj, klass);
+    }
 }
 
 void
@@ -73,6 +192,7 @@ YogObj_init(YogEnv* env, YogVal obj, uint_t type, uint_t flags, YogVal klass)
 {
     YogBasicObj_init(env, obj, type, flags | HAS_ATTRS, klass);
     PTR_AS(YogObj, obj)->attrs = YUNDEF;
+    PTR_AS(YogObj, obj)->shape = YUNDEF;
 }
 
 void
@@ -89,6 +209,7 @@ YogObj_keep_children(YogEnv* env, void* ptr, ObjectKeeper keeper, void* heap)
 
     YogObj* obj = PTR_AS(YogObj, ptr);
     YogGC_KEEP(env, obj, attrs, keeper, heap);
+    YogGC_KEEP(env, obj, shape, keeper, heap);
 }
 
 YogVal
@@ -215,7 +336,7 @@ not_equal(YogEnv* env, YogVal self, YogVal pkg, YogVal args, YogVal kw, YogVal b
     YogCArg params[] = { { "obj", &obj }, { NULL, NULL } };
     YogGetArgs_parse_args(env, "!=", params, args, kw);
 
-    b = YogEval_call_method1(env, self, "==", obj);
+    b = YogEval_call_method_id1(env, self, env->vm->id_eq, obj);
     if (YOG_TEST(b)) {
         RETURN(env, YFALSE);
     }
@@ -1672,17 +1672,17 @@ term(A) ::= factor(B). {
 
 factor(A) ::= PLUS(B) factor(C). {
     uint_t lineno = NODE_LINENO(B);
-    ID id = YogVM_intern(env, env->vm, "+self");
+    ID id = env->vm->id_plus_self;
     A = FuncCall_new3(env, lineno, C, id);
 }
 factor(A) ::= MINUS(B) factor(C). {
     uint_t lineno = NODE_LINENO(B);
-    ID id = YogVM_intern(env, env->vm, "-self");
+    ID id = env->vm->id_minus_self;
     A = FuncCall_new3(env, lineno, C, id);
 }
 factor(A) ::= TILDA(B) factor(C). {
     uint_t lineno = NODE_LINENO(B);
-    ID id = YogVM_intern(env, env->vm, "~self");
+    ID id = env->vm->id_tilda_self;
     A = FuncCall_new3(env, lineno, C, id);
 }
 factor(A) ::= power(B). {
@@ -222,8 +222,11 @@ static YogVal
 do_waitpid(YogEnv* env, YogHandle* self, int options)
 {
     CHECK_SELF_TYPE(env, self);
+    pid_t pid = HDL_AS(Process, self)->pid;
     int status;
-    switch (waitpid(HDL_AS(Process, self)->pid, &status, options)) {
+    pid_t retval;
+    YogGC_BLOCKING_REGION(env, retval = waitpid(pid, &status, options));
+    switch (retval) {
     case -1:
         YogError_raise_sys_err(env, errno, YUNDEF);
         /**
@@ -0,0 +1,668 @@
+#include "yog/config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(YOG_HAVE_ARPA_INET_H)
+#   include <arpa/inet.h>
+#endif
+#if defined(YOG_HAVE_NETDB_H)
+#   include <netdb.h>
+#endif
+#if defined(YOG_HAVE_SYS_EPOLL_H)
+#   include <sys/epoll.h>
+#endif
+#if defined(YOG_HAVE_SYS_SOCKET_H)
+#   include <sys/socket.h>
+#endif
+#include <sys/types.h>
+#include <time.h>
+#if defined(YOG_HAVE_UNISTD_H)
+#   include <unistd.h>
+#endif
+#include "yog/array.h"
+#include "yog/binary.h"
+#include "yog/class.h"
+#include "yog/error.h"
+#include "yog/float.h"
+#include "yog/gc.h"
+#include "yog/handle.h"
+#include "yog/misc.h"
+#include "yog/object.h"
+#include "yog/package.h"
+#include "yog/reactor.h"
+#include "yog/string.h"
+#include "yog/sysdeps.h"
+#include "yog/vm.h"
+#include "yog/yog.h"
+
+/**
+ * = The reactor Package
+ *
+ * This package has primitives for lib/eventloop.yog. Poller is a thin wrapper
+ * of epoll. The other functions work on non-blocking file descriptors. They
+ * never wait. They return nil instead of raising EAGAIN, so that callers can
+ * suspend the current coroutine until the descriptor gets ready.
+ *
+ * read and write are not in YogGC_BLOCKING_REGION. They do not block, and
+ * freeing a thread from GC at every call costs much when one thread serves
+ * many connections. Only Poller#wait and getaddrinfo(3), which may block for
+ * long, free the thread from GC.
+ */
+
+struct Poller {
+    struct YogBasicObj base;
+    int fd;
+};
+
+typedef struct Poller Poller;
+
+#define TYPE_POLLER TO_TYPE(Poller_alloc)
+
+#define MAX_EVENTS  256
+#define MAX_READ_SIZE   65536
+
+#if defined(YOG_HAVE_ARPA_INET_H) && defined(YOG_HAVE_NETDB_H) && defined(YOG_HAVE_SYS_SOCKET_H)
+#   define SOCKET_ENABLED
+#endif
+
+#define CHECK_SELF_POLLER(env, self)  do { \
+    YogVal val = HDL2VAL((self)); \
+    if (!IS_PTR(val) || (BASIC_OBJ_TYPE(val) != TYPE_POLLER)) { \
+        YogError_raise_TypeError((env), "self must be Poller, not %C", val); \
+    } \
+} while (0)
+
+static void
+Poller_finalize(YogEnv* env, void* ptr)
+{
+    Poller* poller = (Poller*)ptr;
+    if (poller->fd < 0) {
+        return;
+    }
+    close(poller->fd);
+    poller->fd = -1;
+}
+
+static YogVal
+Poller_alloc(YogEnv* env, YogVal klass)
+{
+    SAVE_ARG(env, klass);
+    YogVal poller = ALLOC_OBJ(env, YogBasicObj_keep_children, Poller_finalize, Poller);
+    PUSH_LOCAL(env, poller);
+    YogBasicObj_init(env, poller, TYPE_POLLER, 0, klass);
+    PTR_AS(Poller, poller)->fd = -1;
+    RETURN(env, poller);
+}
+
+static int
+get_fd(YogEnv* env, YogHandle* fd)
+{
+    YogMisc_check_Fixnum(env, fd, "fd");
+    return VAL2INT(HDL2VAL(fd));
+}
+
+static int
+get_poller_fd(YogEnv* env, YogHandle* self)
+{
+    CHECK_SELF_POLLER(env, self);
+    int fd = HDL_AS(Poller, self)->fd;
+    if (fd < 0) {
+        YogError_raise_IOError(env, "Poller is closed");
+    }
+    return fd;
+}
+
+#if defined(YOG_HAVE_SYS_EPOLL_H)
+static YogVal
+Poller_init(YogEnv* env, YogHandle* self, YogHandle* pkg)
+{
+    CHECK_SELF_POLLER(env, self);
+    int fd = epoll_create1(EPOLL_CLOEXEC);
+    if (fd < 0) {
+        YogError_raise_sys_err(env, errno, YNIL);
+    }
+    HDL_AS(Poller, self)->fd = fd;
+    return HDL2VAL(self);
+}
+
+static int
+do_ctl(YogEnv* env, YogHandle* self, int op, YogHandle* fd, YogHandle* events)
+{
+    int epfd = get_poller_fd(env, self);
+    struct epoll_event ev;
+    bzero(&ev, sizeof(ev));
+    if (events != NULL) {
+        ev.events = YogVal_to_uint(env, HDL2VAL(events), "events");
+    }
+    ev.data.fd = get_fd(env, fd);
+    return epoll_ctl(epfd, op, ev.data.fd, &ev);
+}
+
+/**
+ * Returns false for a descriptor which epoll does not support, like a regular
+ * file. Such a descriptor is always ready.
+ */
+static YogVal
+Poller_register(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* fd, YogHandle* events)
+{
+    if (do_ctl(env, self, EPOLL_CTL_ADD, fd, events) != 0) {
+        if (errno == EPERM) {
+            return YFALSE;
+        }
+        YogError_raise_sys_err(env, errno, YNIL);
+    }
+    return YTRUE;
+}
+
+static YogVal
+Poller_modify(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* fd, YogHandle* events)
+{
+    if (do_ctl(env, self, EPOLL_CTL_MOD, fd, events) != 0) {
+        YogError_raise_sys_err(env, errno, YNIL);
+    }
+    return YNIL;
+}
+
+static YogVal
+Poller_unregister(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* fd)
+{
+    if (do_ctl(env, self, EPOLL_CTL_DEL, fd, NULL) != 0) {
+        YogError_raise_sys_err(env, errno, YNIL);
+    }
+    return YNIL;
+}
+
+static int
+timeout2msec(YogEnv* env, YogHandle* timeout)
+{
+    if ((timeout == NULL) || IS_NIL(HDL2VAL(timeout))) {
+        return -1;
+    }
+    YogVal val = HDL2VAL(timeout);
+    double sec;
+    if (IS_FIXNUM(val)) {
+        sec = VAL2INT(val);
+    }
+    else if (IS_PTR(val) && (BASIC_OBJ_TYPE(val) == TYPE_FLOAT)) {
+        sec = FLOAT_NUM(val);
+    }
+    else {
+        const char* fmt = "timeout must be Fixnum, Float or nil, not %C";
+        YogError_raise_TypeError(env, fmt, val);
+        /* NOTREACHED */
+        sec = 0;
+    }
+    if (sec <= 0) {
+        return 0;
+    }
+    /**
+     * Rounds up not to wake up before the earliest timer and to poll again
+     * with zero timeout.
+     */
+    int msec = (int)(sec * 1000);
+    return msec < sec * 1000 ? msec + 1 : msec;
+}
+
+/**
+ * Returns an array of [fd, events].
+ */
+static YogVal
+Poller_wait(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* timeout)
+{
+    int epfd = get_poller_fd(env, self);
+    int msec = timeout2msec(env, timeout);
+    struct epoll_event events[MAX_EVENTS];
+    int n;
+    YogGC_BLOCKING_REGION(env, n = epoll_wait(epfd, events, MAX_EVENTS, msec));
+    if (n < 0) {
+        if (errno != EINTR) {
+            YogError_raise_sys_err(env, errno, YNIL);
+        }
+        n = 0;
+    }
+
+    YogHandle* a = VAL2HDL(env, YogArray_new(env));
+    int i;
+    for (i = 0; i < n; i++) {
+        YogHandle* pair = VAL2HDL(env, YogArray_new(env));
+        YogArray_push(env, HDL2VAL(pair), INT2VAL(events[i].data.fd));
+        YogVal ev = YogVal_from_unsigned_int(env, events[i].events);
+        YogArray_push(env, HDL2VAL(pair), ev);
+        YogArray_push(env, HDL2VAL(a), HDL2VAL(pair));
+    }
+    return HDL2VAL(a);
+}
+#else
+static YogVal
+Poller_init(YogEnv* env, YogHandle* self, YogHandle* pkg)
+{
+    YogError_raise_sys_err(env, ENOSYS, YNIL);
+    /* NOTREACHED */
+    return YUNDEF;
+}
+#endif
+
+static YogVal
+Poller_close(YogEnv* env, YogHandle* self, YogHandle* pkg)
+{
+    int fd = get_poller_fd(env, self);
+    HDL_AS(Poller, self)->fd = -1;
+    if (close(fd) != 0) {
+        YogError_raise_sys_err(env, errno, YNIL);
+    }
+    return YNIL;
+}
+
+static int
+make_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+    if ((flags < 0) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0)) {
+        return -1;
+    }
+    flags = fcntl(fd, F_GETFD);
+    if ((flags < 0) || (fcntl(fd, F_SETFD, flags | FD_CLOEXEC) != 0)) {
+        return -1;
+    }
+    return 0;
+}
+
+static void
+set_nonblocking(YogEnv* env, int fd)
+{
+    if (make_nonblocking(fd) != 0) {
+        int errno_ = errno;
+        close(fd);
+        YogError_raise_sys_err(env, errno_, YNIL);
+    }
+}
+
+static BOOL
+is_again(int errno_)
+{
+    return (errno_ == EAGAIN) || (errno_ == EWOULDBLOCK);
+}
+
+/**
+ * Reads at most size bytes (and at most MAX_READ_SIZE at once). Returns an
+ * empty Binary at end of file, or nil if no data is ready.
+ */
+static YogVal
+read_(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* fd, YogHandle* size)
+{
+    int n = get_fd(env, fd);
+    YogMisc_check_Fixnum(env, size, "size");
+    if (VAL2INT(HDL2VAL(size)) <= 0) {
+        const char* fmt = "size must be greater than zero, not %d";
+        YogError_raise_ValueError(env, fmt, VAL2INT(HDL2VAL(size)));
+    }
+    uint_t bufsize = VAL2INT(HDL2VAL(size));
+    bufsize = bufsize < MAX_READ_SIZE ? bufsize : MAX_READ_SIZE;
+    /**
+     * Data is read into the body of the Binary directly. Nothing here causes
+     * GC until bin is returned.
+     */
+    YogVal bin = YogBinary_of_size(env, bufsize);
+    ssize_t nbytes;
+    do {
+        nbytes = read(n, BINARY_CSTR(bin), bufsize);
+    } while ((nbytes < 0) && (errno == EINTR));
+    if (nbytes < 0) {
+        if (is_again(errno)) {
+            return YNIL;
+        }
+        YogError_raise_sys_err(env, errno, YNIL);
+    }
+    BINARY_SIZE(bin) = nbytes;
+    return bin;
+}
+
+/**
+ * Writes a Binary from pos, and returns the number of written bytes, or nil if
+ * the descriptor is not ready.
+ */
+static YogVal
+write_(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* fd, YogHandle* data, YogHandle* pos)
+{
+    int n = get_fd(env, fd);
+    YogMisc_check_Fixnum_optional(env, pos, "pos");
+    YogVal bin = HDL2VAL(data);
+    if (!IS_PTR(bin) || (BASIC_OBJ_TYPE(bin) != TYPE_BINARY)) {
+        YogError_raise_TypeError(env, "data must be Binary, not %C", bin);
+    }
+    uint_t size = BINARY_SIZE(bin);
+    int_t from = pos == NULL ? 0 : VAL2INT(HDL2VAL(pos));
+    if ((from < 0) || (size < (uint_t)from)) {
+        YogError_raise_IndexError(env, "pos out of range: %d", from);
+    }
+
+    ssize_t nbytes;
+    do {
+        nbytes = write(n, BINARY_CSTR(bin) + from, size - from);
+    } while ((nbytes < 0) && (errno == EINTR));
+    if (nbytes < 0) {
+        if (is_again(errno)) {
+            return YNIL;
+        }
+        YogError_raise_sys_err(env, errno, YNIL);
+    }
+    return INT2VAL(nbytes);
+}
+
+static YogVal
+close_(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* fd)
+{
+    if (close(get_fd(env, fd)) != 0) {
+        YogError_raise_sys_err(env, errno, YNIL);
+    }
+    return YNIL;
+}
+
+static YogVal
+fds2array(YogEnv* env, int fds[2])
+{
+    YogHandle* a = VAL2HDL(env, YogArray_new(env));
+    YogArray_push(env, HDL2VAL(a), INT2VAL(fds[0]));
+    YogArray_push(env, HDL2VAL(a), INT2VAL(fds[1]));
+    return HDL2VAL(a);
+}
+
+/**
+ * Returns [fd to read, fd to write].
+ */
+static YogVal
+pipe_(YogEnv* env, YogHandle* self, YogHandle* pkg)
+{
+    int fds[2];
+    if (pipe(fds) != 0) {
+        YogError_raise_sys_err(env, errno, YNIL);
+    }
+    if ((make_nonblocking(fds[0]) != 0) || (make_nonblocking(fds[1]) != 0)) {
+        int errno_ = errno;
+        close(fds[0]);
+        close(fds[1]);
+        YogError_raise_sys_err(env, errno_, YNIL);
+    }
+    return fds2array(env, fds);
+}
+
+static int
+mode2flags(YogEnv* env, YogHandle* mode)
+{
+    if (mode == NULL) {
+        return O_RDONLY;
+    }
+    YogMisc_check_String(env, mode, "mode");
+    YogVal s = YogString_to_bin_in_default_encoding(env, mode);
+    const char* m = BINARY_CSTR(s);
+    if (strcmp(m, "r") == 0) {
+        return O_RDONLY;
+    }
+    if (strcmp(m, "w") == 0) {
+        return O_WRONLY | O_CREAT | O_TRUNC;
+    }
+    if (strcmp(m, "a") == 0) {
+        return O_WRONLY | O_CREAT | O_APPEND;
+    }
+    if (strcmp(m, "r+") == 0) {
+        return O_RDWR;
+    }
+    if (strcmp(m, "w+") == 0) {
+        return O_RDWR | O_CREAT | O_TRUNC;
+    }
+    if (strcmp(m, "a+") == 0) {
+        return O_RDWR | O_CREAT | O_APPEND;
+    }
+    YogError_raise_ValueError(env, "Invalid mode: %S", HDL2VAL(mode));
+    /* NOTREACHED */
+    return 0;
+}
+
+static YogVal
+open_(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* path, YogHandle* mode)
+{
+    YogMisc_check_String(env, path, "path");
+    int flags = mode2flags(env, mode) | O_NONBLOCK | O_CLOEXEC;
+    YogVal s = YogString_to_bin_in_default_encoding(env, path);
+    char* name = (char*)YogSysdeps_alloca(strlen(BINARY_CSTR(s)) + 1);
+    strcpy(name, BINARY_CSTR(s));
+    int fd;
+    YogGC_BLOCKING_REGION(env, fd = open(name, flags, 0666));
+    if (fd < 0) {
+        YogError_raise_sys_err(env, errno, HDL2VAL(path));
+    }
+    return INT2VAL(fd);
+}
+
+#if defined(SOCKET_ENABLED)
+static struct addrinfo*
+resolve(YogEnv* env, YogHandle* host, YogHandle* port, int flags)
+{
+    const char* node = NULL;
+    if ((host != NULL) && !IS_NIL(HDL2VAL(host))) {
+        YogMisc_check_String(env, host, "host");
+        YogVal s = YogString_to_bin_in_default_encoding(env, host);
+        char* p = (char*)YogSysdeps_alloca(strlen(BINARY_CSTR(s)) + 1);
+        strcpy(p, BINARY_CSTR(s));
+        node = p;
+    }
+    YogMisc_check_Fixnum(env, port, "port");
+    char service[16];
+    snprintf(service, sizeof(service), "%d", (int)VAL2INT(HDL2VAL(port)));
+
+    struct addrinfo hints;
+    bzero(&hints, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = flags;
+    struct addrinfo* res;
+    int retval;
+    YogGC_BLOCKING_REGION(env, retval = getaddrinfo(node, service, &hints, &res));
+    if (retval != 0) {
+        YogError_raise_IOError(env, "%s", gai_strerror(retval));
+    }
+    return res;
+}
+
+static int
+open_socket(YogEnv* env, struct addrinfo* ai)
+{
+    int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) {
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (make_nonblocking(fd) != 0) {
+        int errno_ = errno;
+        close(fd);
+        errno = errno_;
+        return -1;
+    }
+    return fd;
+}
+
+static YogVal
+listen_(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* host, YogHandle* port, YogHandle* backlog)
+{
+    YogMisc_check_Fixnum_optional(env, backlog, "backlog");
+    int n = backlog == NULL ? SOMAXCONN : VAL2INT(HDL2VAL(backlog));
+    struct addrinfo* res = resolve(env, host, port, AI_PASSIVE);
+    int fd = -1;
+    int errno_ = 0;
+    struct addrinfo* ai;
+    for (ai = res; ai != NULL; ai = ai->ai_next) {
+        fd = open_socket(env, ai);
+        if (fd < 0) {
+            errno_ = errno;
+            continue;
+        }
+        if ((bind(fd, ai->ai_addr, ai->ai_addrlen) == 0) && (listen(fd, n) == 0)) {
+            break;
+        }
+        errno_ = errno;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0) {
+        YogError_raise_sys_err(env, errno_, YNIL);
+    }
+    return INT2VAL(fd);
+}
+
+/**
+ * Starts connecting, and returns a descriptor. The connection may be in
+ * progress. Wait until the descriptor is writable, and then call
+ * finish_connect.
+ */
+static YogVal
+connect_(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* host, YogHandle* port)
+{
+    struct addrinfo* res = resolve(env, host, port, 0);
+    int fd = -1;
+    int errno_ = 0;
+    struct addrinfo* ai;
+    for (ai = res; ai != NULL; ai = ai->ai_next) {
+        fd = open_socket(env, ai);
+        if (fd < 0) {
+            errno_ = errno;
+            continue;
+        }
+        if ((connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) || (errno == EINPROGRESS)) {
+            break;
+        }
+        errno_ = errno;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0) {
+        YogError_raise_sys_err(env, errno_, YNIL);
+    }
+    return INT2VAL(fd);
+}
+
+static YogVal
+finish_connect(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* fd)
+{
+    int err;
+    socklen_t len = sizeof(err);
+    if (getsockopt(get_fd(env, fd), SOL_SOCKET, SO_ERROR, &err, &len) != 0) {
+        YogError_raise_sys_err(env, errno, YNIL);
+    }
+    if (err != 0) {
+        YogError_raise_sys_err(env, err, YNIL);
+    }
+    return YNIL;
+}
+
+/**
+ * Returns a descriptor of a new connection, or nil if no one is waiting.
+ */
+static YogVal
+accept_(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* fd)
+{
+    int listener = get_fd(env, fd);
+    int conn;
+    do {
+        conn = accept(listener, NULL, NULL);
+    } while ((conn < 0) && (errno == EINTR));
+    if (conn < 0) {
+        if (is_again(errno) || (errno == ECONNABORTED)) {
+            return YNIL;
+        }
+        YogError_raise_sys_err(env, errno, YNIL);
+    }
+    set_nonblocking(env, conn);
+    return INT2VAL(conn);
+}
+
+static YogVal
+get_local_port(YogEnv* env, YogHandle* self, YogHandle* pkg, YogHandle* fd)
+{
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(get_fd(env, fd), (struct sockaddr*)&addr, &len) != 0) {
+        YogError_raise_sys_err(env, errno, YNIL);
+    }
+    if (addr.ss_family == AF_INET6) {
+        return INT2VAL(ntohs(((struct sockaddr_in6*)&addr)->sin6_port));
+    }
+    return INT2VAL(ntohs(((struct sockaddr_in*)&addr)->sin_port));
+}
+#endif
+
+/**
+ * Returns seconds from an unspecified point as Float. It never goes back.
+ */
+static YogVal
+now(YogEnv* env, YogHandle* self, YogHandle* pkg)
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        YogError_raise_sys_err(env, errno, YNIL);
+    }
+    return YogFloat_from_float(env, ts.tv_sec + ts.tv_nsec / 1000000000.0);
+}
+
+static void
+define_Poller(YogEnv* env, YogHandle* pkg)
+{
+    YogVM* vm = env->vm;
+    YogHandle* cPoller = VAL2HDL(env, YogClass_new(env, "Poller", vm->cObject));
+    YogClass_define_allocator(env, HDL2VAL(cPoller), Poller_alloc);
+#define DEFINE_METHOD(name, ...) do { \
+    YogClass_define_method2(env, HDL2VAL(cPoller), HDL2VAL(pkg), (name), __VA_ARGS__); \
+} while (0)
+    DEFINE_METHOD("close", Poller_close, NULL);
+    DEFINE_METHOD("init", Poller_init, NULL);
+#if defined(YOG_HAVE_SYS_EPOLL_H)
+    DEFINE_METHOD("modify", Poller_modify, "fd", "events", NULL);
+    DEFINE_METHOD("register", Poller_register, "fd", "events", NULL);
+    DEFINE_METHOD("unregister", Poller_unregister, "fd", NULL);
+    DEFINE_METHOD("wait", Poller_wait, "|", "timeout", NULL);
+#endif
+#undef DEFINE_METHOD
+    YogObj_set_attr(env, HDL2VAL(pkg), "Poller", HDL2VAL(cPoller));
+}
+
+void
+YogReactor_boot(YogEnv* env, YogHandle* pkg)
+{
+    define_Poller(env, pkg);
+#define DEFINE_FUNCTION(name, ...) do { \
+    YogPackage_define_function2(env, pkg, (name), __VA_ARGS__); \
+} while (0)
+    DEFINE_FUNCTION("close", close_, "fd", NULL);
+#if defined(SOCKET_ENABLED)
+    DEFINE_FUNCTION("accept", accept_, "fd", NULL);
+    DEFINE_FUNCTION("connect", connect_, "host", "port", NULL);
+    DEFINE_FUNCTION("finish_connect", finish_connect, "fd", NULL);
+    DEFINE_FUNCTION("get_local_port", get_local_port, "fd", NULL);
+    DEFINE_FUNCTION("listen", listen_, "host", "port", "|", "backlog", NULL);
+#endif
+    DEFINE_FUNCTION("now", now, NULL);
+    DEFINE_FUNCTION("open", open_, "path", "|", "mode", NULL);
+    DEFINE_FUNCTION("pipe", pipe_, NULL);
+    DEFINE_FUNCTION("read", read_, "fd", "size", NULL);
+    DEFINE_FUNCTION("write", write_, "fd", "data", "|", "pos", NULL);
+#undef DEFINE_FUNCTION
+
+#define DEFINE_CONST(name, val) do { \
+    YogVal v = YogVal_from_unsigned_int(env, (val)); \
+    YogObj_set_attr(env, HDL2VAL(pkg), (name), v); \
+} while (0)
+#if defined(YOG_HAVE_SYS_EPOLL_H)
+    DEFINE_CONST("READABLE", EPOLLIN);
+    DEFINE_CONST("WRITABLE", EPOLLOUT);
+    DEFINE_CONST("HANGUP", EPOLLHUP | EPOLLERR);
+    DEFINE_CONST("ONESHOT", EPOLLONESHOT);
+#endif
+#undef DEFINE_CONST
+}
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
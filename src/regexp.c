@@ -66,6 +66,15 @@ YogMatch_new(YogEnv* env, YogHandle* str, YogHandle* regexp)
     return match;
 }
 
+static void
+YogRegexp_keep_children(YogEnv* env, void* ptr, ObjectKeeper keeper, void* heap)
+{
+    YogBasicObj_keep_children(env, ptr, keeper, heap);
+
+    YogRegexp* regexp = PTR_AS(YogRegexp, ptr);
+    YogGC_KEEP(env, regexp, pattern, keeper, heap);
+}
+
 static void
 YogRegexp_finalize(YogEnv* env, void* ptr)
 {
@@ -77,13 +86,15 @@ YogRegexp_finalize(YogEnv* env, void* ptr)
 YogVal
 YogRegexp_new(YogEnv* env, YogVal pattern, BOOL ignore_case)
 {
-    YogHandle* h = VAL2HDL(env, pattern);
-    YogVal regexp = ALLOC_OBJ(env, YogBasicObj_keep_children, YogRegexp_finalize, YogRegexp);
+    YogHandle* h = VAL2HDL(env, YogString_clone(env, pattern));
+    YogVal regexp = ALLOC_OBJ(env, YogRegexp_keep_children, YogRegexp_finalize, YogRegexp);
     YogBasicObj_init(env, regexp, TYPE_REGEXP, 0, env->vm->cRegexp);
     size_t size = sizeof(CorgiRegexp);
     CorgiRegexp* corgi_regexp = (CorgiRegexp*)YogGC_malloc(env, size);
     corgi_init_regexp(corgi_regexp);
     PTR_AS(YogRegexp, regexp)->corgi_regexp = corgi_regexp;
+    YogGC_UPDATE_PTR(env, PTR_AS(YogRegexp, regexp), pattern, HDL2VAL(h));
+    PTR_AS(YogRegexp, regexp)->ignore_case = ignore_case;
 
     CorgiChar* begin = STRING_CHARS(HDL2VAL(h));
     CorgiOptions opts = 0;
@@ -0,0 +1,132 @@
+#include "yog/gc.h"
+#include "yog/shape.h"
+#include "yog/table.h"
+#include "yog/vm.h"
+#include "yog/yog.h"
+
+static void
+keep_children(YogEnv* env, void* ptr, ObjectKeeper keeper, void* heap)
+{
+    YogShape* shape = PTR_AS(YogShape, ptr);
+#define KEEP(member)    YogGC_KEEP(env, shape, member, keeper, heap)
+    KEEP(parent);
+    KEEP(index);
+    KEEP(children);
+    KEEP(next_sibling);
+#undef KEEP
+}
+
+static YogVal
+make_index(YogEnv* env, YogVal shape)
+{
+    SAVE_ARG(env, shape);
+    YogVal index = YUNDEF;
+    PUSH_LOCAL(env, index);
+
+    index = YogTable_create_symbol_table(env);
+    while (0 < PTR_AS(YogShape, shape)->size) {
+        YogVal name = ID2VAL(PTR_AS(YogShape, shape)->name);
+        YogVal slot = INT2VAL(PTR_AS(YogShape, shape)->size - 1);
+        YogTable_insert(env, index, name, slot);
+        shape = PTR_AS(YogShape, shape)->parent;
+    }
+
+    RETURN(env, index);
+}
+
+static YogVal
+alloc(YogEnv* env, YogVal parent, ID name, uint_t size)
+{
+    SAVE_ARG(env, parent);
+    YogVal shape = YUNDEF;
+    PUSH_LOCAL(env, shape);
+
+    shape = ALLOC_OBJ(env, keep_children, NULL, YogShape);
+    YogGC_UPDATE_PTR(env, PTR_AS(YogShape, shape), parent, parent);
+    PTR_AS(YogShape, shape)->name = name;
+    PTR_AS(YogShape, shape)->size = size;
+    PTR_AS(YogShape, shape)->index = YUNDEF;
+    PTR_AS(YogShape, shape)->children = YUNDEF;
+    PTR_AS(YogShape, shape)->next_sibling = YUNDEF;
+    PTR_AS(YogShape, shape)->children_num = 0;
+    if (SHAPE_INDEX_MIN < size) {
+        YogVal index = make_index(env, shape);
+        YogGC_UPDATE_PTR(env, PTR_AS(YogShape, shape), index, index);
+    }
+
+    RETURN(env, shape);
+}
+
+YogVal
+YogShape_new(YogEnv* env)
+{
+    return alloc(env, YUNDEF, INVALID_ID, 0);
+}
+
+/**
+ * Never causes GC. Callers keep raw pointers over this.
+ */
+int_t
+YogShape_find(YogEnv* env, YogVal self, ID name)
+{
+    YogVal index = PTR_AS(YogShape, self)->index;
+    if (IS_PTR(index)) {
+        YogVal slot;
+        if (!YogTable_lookup_sym(env, index, ID2VAL(name), &slot)) {
+            return -1;
+        }
+        return VAL2INT(slot);
+    }
+
+    YogVal shape = self;
+    while (0 < PTR_AS(YogShape, shape)->size) {
+        if (PTR_AS(YogShape, shape)->name == name) {
+            return PTR_AS(YogShape, shape)->size - 1;
+        }
+        shape = PTR_AS(YogShape, shape)->parent;
+    }
+    return -1;
+}
+
+/**
+ * Returns the shape which has name in addition to self, or YUNDEF when no more
+ * shapes are made for it.
+ */
+YogVal
+YogShape_add(YogEnv* env, YogVal self, ID name)
+{
+    YogVal child = PTR_AS(YogShape, self)->children;
+    while (IS_PTR(child)) {
+        if (PTR_AS(YogShape, child)->name == name) {
+            return child;
+        }
+        child = PTR_AS(YogShape, child)->next_sibling;
+    }
+    if (SHAPE_MAX_CHILDREN <= PTR_AS(YogShape, self)->children_num) {
+        return YUNDEF;
+    }
+    if (SHAPE_MAX_NUM <= env->vm->shapes_num) {
+        return YUNDEF;
+    }
+
+    SAVE_ARG(env, self);
+    child = alloc(env, self, name, PTR_AS(YogShape, self)->size + 1);
+    /**
+     * Other threads may read children at the same time. A new shape is
+     * published after it is initialized. When two threads add children
+     * concurrently, one of them may be dropped from the list. It is harmless
+     * because objects keep their own shapes. The counts may be short for the
+     * same reason, which only lets the tree grow a little larger.
+     */
+    YogVal next = PTR_AS(YogShape, self)->children;
+    YogGC_UPDATE_PTR(env, PTR_AS(YogShape, child), next_sibling, next);
+    YogGC_UPDATE_PTR(env, PTR_AS(YogShape, self), children, child);
+    PTR_AS(YogShape, self)->children_num++;
+    env->vm->shapes_num++;
+
+    RETURN(env, child);
+}
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
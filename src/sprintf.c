@@ -187,7 +187,7 @@ conv_to_string(YogEnv* env, YogVal o)
         RETURN(env, o);
     }
 
-    s = YogEval_call_method0(env, o, "to_s");
+    s = YogEval_call_method_id0(env, o, env->vm->id_to_s);
     if (!IS_STRING(s)) {
         YogError_raise_TypeError(env, "to_s returned non-string");
     }
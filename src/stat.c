@@ -1,5 +1,6 @@
 #include "yog/config.h"
 #include <errno.h>
+#include <string.h>
 #include <strings.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -11,6 +12,7 @@
 #include "yog/handle.h"
 #include "yog/object.h"
 #include "yog/string.h"
+#include "yog/sysdeps.h"
 #include "yog/vm.h"
 #include "yog/yog.h"
 
@@ -39,9 +41,15 @@ do_stat(YogEnv* env, YogHandle* path, int (*f)(const char*, struct stat*))
 {
     YogHandle* st = VAL2HDL(env, alloc(env, env->vm->cStat));
     YogVal s = YogString_to_bin_in_default_encoding(env, path);
-    if (f(BINARY_CSTR(s), &HDL_AS(Stat, st)->st) != 0) {
+    char* name = (char*)YogSysdeps_alloca(strlen(BINARY_CSTR(s)) + 1);
+    strcpy(name, BINARY_CSTR(s));
+    struct stat buf;
+    int retval;
+    YogGC_BLOCKING_REGION(env, retval = f(name, &buf));
+    if (retval != 0) {
         YogError_raise_sys_err(env, errno, HDL2VAL(path));
     }
+    HDL_AS(Stat, st)->st = buf;
     return HDL2VAL(st);
 }
 
@@ -19,6 +19,7 @@
 #include "yog/string.h"
 #include "yog/table.h"
 #include "yog/thread.h"
+#include "yog/vm.h"
 #include "yog/yog.h"
 
 #define ST_DEFAULT_MAX_DENSITY 5
@@ -38,22 +39,11 @@
 #define TABLE_ENTRY_TOP(table, i) \
                     PTR_AS(YogTableEntryArray, TABLE_BINS((table)))->items[(i)]
 
-static void
-keep_bins_children(YogEnv* env, void* ptr, ObjectKeeper keeper, void* heap)
-{
-    YogTableEntryArray* array = PTR_AS(YogTableEntryArray, ptr);
-    uint_t size = array->size;
-    uint_t i;
-    for (i = 0; i < size; i++) {
-        YogGC_KEEP(env, array, items[i], keeper, heap);
-    }
-}
-
 static YogVal
 alloc_bins(YogEnv* env, int_t size)
 {
     YogGC_check_multiply_overflow(env, size, sizeof(YogVal));
-    YogVal array = ALLOC_OBJ_ITEM(env, keep_bins_children, NULL, YogTableEntryArray, size, YogVal);
+    YogVal array = ALLOC_OBJ_ITEM(env, YogGC_keep_slots, NULL, YogTableEntryArray, size, YogVal);
 
     PTR_AS(YogTableEntryArray, array)->size = size;
     int_t i;
@@ -557,7 +547,7 @@ compare_val(YogEnv* env, YogVal a, YogVal b)
     }
     INIT_JMPBUF(env, jmpbuf);
     PUSH_JMPBUF(env->thread, jmpbuf);
-    val = YogEval_call_method1(env, a, "==", b);
+    val = YogEval_call_method_id1(env, a, env->vm->id_eq, b);
     POP_JMPBUF(env);
 
     RETURN(env, YOG_TEST(val) ? TRUE : FALSE);
@@ -570,7 +560,7 @@ hash_val(YogEnv* env, YogVal val)
     YogVal hash = YUNDEF;
     PUSH_LOCAL(env, hash);
 
-    hash = YogEval_call_method0(env, val, "hash");
+    hash = YogEval_call_method_id0(env, val, env->vm->id_hash);
     int_t h = YogVal_to_signed_type(env, hash, "hash");
 
     RETURN(env, h);
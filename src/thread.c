@@ -12,6 +12,7 @@
 #include "yog/array.h"
 #include "yog/callable.h"
 #include "yog/class.h"
+#include "yog/coroutine.h"
 #include "yog/error.h"
 #include "yog/eval.h"
 #include "yog/frame.h"
@@ -105,15 +106,29 @@ YogThread_put_c_frame(YogEnv* env, YogVal self, YogVal frame)
 }
 
 YogVal
-YogThread_get_script_frame(YogEnv* env, YogVal self)
+YogThread_get_script_frame(YogEnv* env, YogVal self, uint_t slots_num)
 {
+    /**
+     * Frames near the top were used recently. They are likely to be in the
+     * cache and to fit the next call of the same function.
+     */
     uint_t n = PTR_AS(YogThread, self)->script_frames_num;
-    if (n == 0) {
-        return YNIL;
+    uint_t i = n;
+    while (0 < i) {
+        YogVal frame = PTR_AS(YogThread, self)->script_frames[i - 1];
+        if (slots_num <= SCRIPT_FRAME_SLOTS_NUM(frame)) {
+            uint_t j;
+            for (j = i; j < n; j++) {
+                YogVal next = PTR_AS(YogThread, self)->script_frames[j];
+                YogGC_UPDATE_PTR(env, PTR_AS(YogThread, self), script_frames[j - 1], next);
+            }
+            PTR_AS(YogThread, self)->script_frames[n - 1] = YUNDEF;
+            PTR_AS(YogThread, self)->script_frames_num--;
+            return frame;
+        }
+        i--;
     }
-    YogVal frame = PTR_AS(YogThread, self)->script_frames[n - 1];
-    PTR_AS(YogThread, self)->script_frames_num--;
-    return frame;
+    return YNIL;
 }
 
 void
@@ -150,6 +165,8 @@ YogThread_init(YogEnv* env, YogVal thread, YogVal klass)
     YogBasicObj_init(env, thread, TYPE_THREAD, 0, klass);
 
     PTR_AS(YogThread, thread)->heap = NULL;
+    PTR_AS(YogThread, thread)->bytes_to_sample = 0;
+    PTR_AS(YogThread, thread)->heap_sample = NULL;
 
     PTR_AS(YogThread, thread)->jmp_buf_list = NULL;
     PTR_AS(YogThread, thread)->jmp_val = YUNDEF;
@@ -164,6 +181,7 @@ YogThread_init(YogEnv* env, YogVal thread, YogVal klass)
     PTR_AS(YogThread, thread)->finish_frames_num = 0;
     PTR_AS(YogThread, thread)->script_frames_num = 0;
     PTR_AS(YogThread, thread)->c_frames_num = 0;
+    PTR_AS(YogThread, thread)->machine_stacks_num = 0;
 }
 
 #if defined(GC_COPYING)
@@ -342,6 +360,7 @@ thread_main(void* arg)
 
     RESTORE_LOCALS(&env);
 
+    YogCoroutine_unmap_machine_stacks(&env, env.thread);
     YogVM_remove_thread(&env, vm, env.thread);
     YogVM_remove_handles(&env, vm, &handles);
     YogVM_remove_locals(&env, vm, &locals);
@@ -391,6 +410,12 @@ run(YogEnv* env, YogVal self, YogVal pkg, YogVal args, YogVal kw, YogVal block)
     PTR_AS(ThreadArg, arg)->vm = env->vm;
     YogGC_UPDATE_PTR(env, PTR_AS(ThreadArg, arg), thread, self);
     YogGC_UPDATE_PTR(env, PTR_AS(ThreadArg, arg), vararg, vararg);
+    /**
+     * The new thread refers these objects. Their heaps cannot be collected
+     * locally until the next stop-the-world GC.
+     */
+    YogGC_share(env, self);
+    YogGC_share(env, arg);
 
     YogVM_add_thread(env, env->vm, self);
 
@@ -8,6 +8,7 @@
 #   include <malloc.h>
 #endif
 #include <pthread.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -35,6 +36,7 @@
 #include "yog/class.h"
 #include "yog/classmethod.h"
 #include "yog/code.h"
+#include "yog/code_cache.h"
 #include "yog/comparable.h"
 #include "yog/compile.h"
 #include "yog/coroutine.h"
@@ -57,12 +59,15 @@
 #include "yog/module.h"
 #include "yog/nil.h"
 #include "yog/package.h"
+#include "yog/parser.h"
 #include "yog/path.h"
 #include "yog/private.h"
 #include "yog/process.h"
 #include "yog/property.h"
+#include "yog/reactor.h"
 #include "yog/regexp.h"
 #include "yog/set.h"
+#include "yog/shape.h"
 #include "yog/stat.h"
 #include "yog/string.h"
 #include "yog/symbol.h"
@@ -112,24 +117,29 @@ release_symbols_lock(YogEnv* env, YogVM* vm)
     pthread_rwlock_unlock(&vm->sym_lock);
 }
 
+/**
+ * Stores the name of id into name, or returns FALSE if id is not interned.
+ */
+BOOL
+YogVM_lookup_name(YogEnv* env, YogVM* vm, ID id, YogVal* name)
+{
+    acquire_symbols_read_lock(env, vm);
+    BOOL found = YogTable_lookup(env, vm->id2name, ID2VAL(id), name);
+    release_symbols_lock(env, vm);
+    return found;
+}
+
 YogVal
 YogVM_id2name(YogEnv* env, YogVM* vm, ID id)
 {
     SAVE_LOCALS(env);
-    YogVal s = YUNDEF;
     YogVal val = YUNDEF;
-    PUSH_LOCALS2(env, s, val);
+    PUSH_LOCAL(env, val);
 
-    acquire_symbols_read_lock(env, vm);
-
-    YogVal sym = ID2VAL(id);
-    val = YUNDEF;
-    if (!YogTable_lookup(env, env->vm->id2name, sym, &val)) {
+    if (!YogVM_lookup_name(env, vm, id, &val)) {
         YOG_BUG(env, "can't find symbol (0x%x)", id);
     }
 
-    release_symbols_lock(env, vm);
-
     RETURN(env, val);
 }
 
@@ -165,12 +175,75 @@ YogVM_intern2(YogEnv* env, YogVM* vm, YogVal name)
     RETURN(env, id);
 }
 
+static struct {
+    size_t offset;
+    const char* name;
+} well_known_symbols[] = {
+#define SYMBOL(member, name)    { offsetof(YogVM, member), (name) }
+    SYMBOL(id_amp, "&"),
+    SYMBOL(id_bar, "|"),
+    SYMBOL(id_call, "call"),
+    SYMBOL(id_caret, "^"),
+    SYMBOL(id_each, "each"),
+    SYMBOL(id_eq, "=="),
+    SYMBOL(id_ge, ">="),
+    SYMBOL(id_gt, ">"),
+    SYMBOL(id_hash, "hash"),
+    SYMBOL(id_init, "init"),
+    SYMBOL(id_le, "<="),
+    SYMBOL(id_lshift, "<<"),
+    SYMBOL(id_lt, "<"),
+    SYMBOL(id_match, "=~"),
+    SYMBOL(id_minus, "-"),
+    SYMBOL(id_minus_self, "-self"),
+    SYMBOL(id_ne, "!="),
+    SYMBOL(id_new, "new"),
+    SYMBOL(id_percent, "%"),
+    SYMBOL(id_plus, "+"),
+    SYMBOL(id_plus_self, "+self"),
+    SYMBOL(id_rshift, ">>"),
+    SYMBOL(id_slash, "/"),
+    SYMBOL(id_slash2, "//"),
+    SYMBOL(id_star, "*"),
+    SYMBOL(id_star2, "**"),
+    SYMBOL(id_subscript, "[]"),
+    SYMBOL(id_subscript_assign, "[]="),
+    SYMBOL(id_tilda_self, "~self"),
+    SYMBOL(id_to_s, "to_s"),
+    SYMBOL(id_ufo, "<=>"),
+#undef SYMBOL
+};
+
+#define WELL_KNOWN_SYMBOLS_NUM \
+    (sizeof(well_known_symbols) / sizeof(well_known_symbols[0]))
+#define WELL_KNOWN_SYMBOL(vm, i) \
+    ((ID*)((char*)(vm) + well_known_symbols[(i)].offset))
+
 ID
 YogVM_intern(YogEnv* env, YogVM* vm, const char* name)
 {
     return YogVM_intern2(env, vm, YogString_from_string(env, name));
 }
 
+static void
+setup_well_known_symbols(YogEnv* env, YogVM* vm)
+{
+    uint_t i;
+    for (i = 0; i < WELL_KNOWN_SYMBOLS_NUM; i++) {
+        const char* name = well_known_symbols[i].name;
+        *WELL_KNOWN_SYMBOL(vm, i) = YogVM_intern(env, vm, name);
+    }
+}
+
+static void
+init_well_known_symbols(YogVM* vm)
+{
+    uint_t i;
+    for (i = 0; i < WELL_KNOWN_SYMBOLS_NUM; i++) {
+        *WELL_KNOWN_SYMBOL(vm, i) = INVALID_ID;
+    }
+}
+
 #define BUILTINS_NAME "builtins"
 
 static void
@@ -181,6 +254,24 @@ setup_builtins(YogEnv* env, YogVM* vm, YogHandle* builtins)
     YogVM_register_package(env, vm, name, builtins);
 }
 
+static void
+setup_gc_package(YogEnv* env, YogVM* vm)
+{
+    YogHandle* pkg = VAL2HDL(env, YogPackage_new(env));
+    YogBuiltins_boot_gc(env, pkg);
+    YogHandle* name = VAL2HDL(env, YogString_from_string(env, "gc"));
+    YogVM_register_package(env, vm, name, pkg);
+}
+
+static void
+setup_reactor_package(YogEnv* env, YogVM* vm)
+{
+    YogHandle* pkg = VAL2HDL(env, YogPackage_new(env));
+    YogReactor_boot(env, pkg);
+    YogHandle* name = VAL2HDL(env, YogString_from_string(env, "reactor"));
+    YogVM_register_package(env, vm, name, pkg);
+}
+
 static void
 register_to_builtins(YogEnv* env, YogVM* vm, const char* key, YogHandle* val)
 {
@@ -357,7 +448,8 @@ get_default_encoding_name()
 static void
 setup_default_encoding(YogEnv* env, YogVM* vm)
 {
-    YogVal s = YogString_from_string(env, get_default_encoding_name());
+    vm->default_encoding_name = get_default_encoding_name();
+    YogVal s = YogString_from_string(env, vm->default_encoding_name);
     vm->default_encoding = YogDict_get(env, vm->encodings, s);
 }
 
@@ -369,6 +461,8 @@ YogVM_boot(YogEnv* env, YogVM* vm)
 
     setup_encodings1(env, vm);
     setup_symbol_tables(env, vm);
+    setup_well_known_symbols(env, vm);
+    vm->root_shape = YogShape_new(env);
     setup_basic_classes(env, vm);
     YogHandle* builtins = YogHandle_REGISTER(env, alloc_skelton_pkg(env, vm));
     setup_classes(env, vm, HDL2VAL(builtins));
@@ -386,11 +480,10 @@ YogVM_boot(YogEnv* env, YogVM* vm)
 
     vm->finish_code = YogCompiler_compile_finish_code(env);
 
-    vm->id_star = YogVM_intern(env, vm, "*");
-    vm->id_star2 = YogVM_intern(env, vm, "**");
-    vm->id_amp = YogVM_intern(env, vm, "&");
-
+    YogCodeCache_load_boot_snapshot(env, vm);
     setup_builtins(env, vm, builtins);
+    setup_gc_package(env, vm);
+    setup_reactor_package(env, vm);
     YogArray_eval_builtin_script(env, vm->cArray);
     YogBinary_eval_builtin_script(env, vm->cBinary);
     YogDatetime_eval_builtin_script(env, vm->cDatetime);
@@ -403,6 +496,7 @@ YogVM_boot(YogEnv* env, YogVM* vm)
     YogSymbol_eval_builtin_script(env, vm->cSymbol);
     YogCallable_eval_builtin_script(env, vm->mCallable);
     YogEnumerable_eval_builtin_script(env, vm->mEnumerable);
+    YogCodeCache_store_boot_snapshot(env, vm);
 
     YogHandleScope_close(env);
 }
@@ -495,20 +589,9 @@ keep_handles(YogEnv* env, YogHandles* handles, ObjectKeeper keeper, void* heap)
     }
 }
 
-void
-YogVM_keep_children(YogEnv* env, void* ptr, ObjectKeeper keeper, void* heap)
+static void
+keep_members(YogEnv* env, YogVM* vm, ObjectKeeper keeper, void* heap)
 {
-    YogVM* vm = PTR_AS(YogVM, ptr);
-
-    YogLocalsAnchor* locals;
-    for (locals = vm->locals; locals != NULL; locals = locals->next) {
-        keep_locals_list(env, locals->body, keeper, locals->heap);
-    }
-    YogHandles* handles;
-    for (handles = vm->handles; handles != NULL; handles = handles->next) {
-        keep_handles(env, handles, keeper, handles->heap);
-    }
-
 #define KEEP(member)    do { \
     vm->member = YogGC_keep(env, vm->member, keeper, heap); \
 } while (0)
@@ -605,11 +688,30 @@ YogVM_keep_children(YogEnv* env, void* ptr, ObjectKeeper keeper, void* heap)
     KEEP(default_encoding);
 
     KEEP(finish_code);
+    KEEP(boot_codes);
+    KEEP(root_shape);
     KEEP(main_thread);
     KEEP(running_threads);
 
     KEEP(path_separator);
 #undef KEEP
+}
+
+void
+YogVM_keep_children(YogEnv* env, void* ptr, ObjectKeeper keeper, void* heap)
+{
+    YogVM* vm = PTR_AS(YogVM, ptr);
+
+    YogLocalsAnchor* locals;
+    for (locals = vm->locals; locals != NULL; locals = locals->next) {
+        keep_locals_list(env, locals->body, keeper, locals->heap);
+    }
+    YogHandles* handles;
+    for (handles = vm->handles; handles != NULL; handles = handles->next) {
+        keep_handles(env, handles, keeper, handles->heap);
+    }
+
+    keep_members(env, vm, keeper, heap);
 
     YogIndirectPointer* indirect_ptr = vm->indirect_ptr;
     while (indirect_ptr != NULL) {
@@ -618,6 +720,33 @@ YogVM_keep_children(YogEnv* env, void* ptr, ObjectKeeper keeper, void* heap)
     }
 }
 
+/**
+ * Keeps roots for a thread-local GC of heap. Locals and handles of other
+ * threads are not touched, because these threads are running. Indirect
+ * pointers are skipped too, because YogVM_alloc_indirect_ptr shares heap of a
+ * young object.
+ */
+void
+YogVM_keep_local_roots(YogEnv* env, YogVM* vm, ObjectKeeper keeper, YogHeap* heap)
+{
+    YogLocalsAnchor* locals;
+    for (locals = vm->locals; locals != NULL; locals = locals->next) {
+        if (locals->heap != heap) {
+            continue;
+        }
+        keep_locals_list(env, locals->body, keeper, heap);
+    }
+    YogHandles* handles;
+    for (handles = vm->handles; handles != NULL; handles = handles->next) {
+        if (handles->heap != heap) {
+            continue;
+        }
+        keep_handles(env, handles, keeper, heap);
+    }
+
+    keep_members(env, vm, keeper, heap);
+}
+
 static void
 init_read_write_lock(pthread_rwlock_t* lock)
 {
@@ -663,6 +792,7 @@ YogVM_init(YogVM* vm)
     INIT(id2name);
     INIT(name2id);
     init_read_write_lock(&vm->sym_lock);
+    init_well_known_symbols(vm);
 
     INIT(cArray);
     INIT(cArrayField);
@@ -753,8 +883,16 @@ YogVM_init(YogVM* vm)
     INIT(encAscii);
     INIT(encUtf8);
     INIT(default_encoding);
+    vm->default_encoding_name = NULL;
 
     INIT(finish_code);
+    vm->boot_snapshot_path = NULL;
+    INIT(boot_codes);
+    vm->boot_scripts_num = 0;
+    vm->boot_snapshot_stale = FALSE;
+    vm->attr_cache_serial = 0;
+    INIT(root_shape);
+    vm->shapes_num = 0;
 
     INIT(running_threads);
     vm->next_thread_id = 0;
@@ -785,15 +923,23 @@ YogVM_init(YogVM* vm)
     vm->gc_id = 0;
     vm->locals = NULL;
     vm->handles = NULL;
+    vm->gc_threads_num = 1;
+    vm->heap_headroom = 50;
+    vm->markers = NULL;
+    vm->live_objects_num = 0;
+    bzero(&vm->gc_stats, sizeof(vm->gc_stats));
+    vm->heap_profiler = NULL;
 #if defined(GC_GENERATIONAL)
     vm->major_gc_flag = FALSE;
     vm->compaction_flag = FALSE;
+    vm->gc_pause_target = 10 * 1000;
 #endif
 
     vm->indirect_ptr = NULL;
     pthread_mutex_init(&vm->indirect_ptr_lock, NULL);
 
     vm->debug_import = FALSE;
+    vm->use_code_cache = TRUE;
     INIT(path_separator);
 #undef INIT
 }
@@ -1185,9 +1331,22 @@ import_yog(YogEnv* env, YogHandle* yog, YogHandle* pkg_name)
         print_error(env, yog);
         return YNIL;
     }
-    YogVal pkg = YogEval_eval_file(env, fp, yog, pkg_name);
+    if (!env->vm->use_code_cache) {
+        YogVal pkg = YogEval_eval_file(env, fp, yog, pkg_name);
+        fclose(fp);
+        return pkg;
+    }
+
+    YogSourceStamp stamp;
+    YogVal code = YogCodeCache_load(env, yog, fp, &stamp);
+    if (IS_UNDEF(code)) {
+        YogVal stmts = YogParser_parse_file(env, fp, yog, FALSE);
+        YogHandle* h = VAL2HDL(env, YogCompiler_compile_package(env, yog, stmts));
+        YogCodeCache_store(env, yog, &stamp, h);
+        code = HDL2VAL(h);
+    }
     fclose(fp);
-    return pkg;
+    return YogEval_eval_code(env, pkg_name, code);
 }
 
 static YogHandle*
@@ -1444,6 +1603,7 @@ YogVM_alloc_indirect_ptr(YogEnv* env, YogVM* vm, YogVal val)
     }
     ADD_TO_LIST(vm->indirect_ptr, ptr);
     ptr->val = val;
+    YogGC_share(env, val);
     release_indirect_ptr_lock(env, vm);
     return ptr;
 }
@@ -149,6 +149,19 @@ def foo()
   print(self)
 end
 foo()
+""", stderr=test_stderr)
+
+    def test_UnboundLocalError20(self):
+        def test_stderr(stderr):
+            assert 0 <= stderr.find("UnboundLocalError: Local variable \"baz\" referenced before assignment")
+
+        self._test("""
+def foo()
+  bar = 42
+  print(bar + baz)
+  baz = 26
+end
+foo()
 """, stderr=test_stderr)
 
     def test_multi_assign0(self):
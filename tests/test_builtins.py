@@ -1,10 +1,12 @@
 # -*- coding: utf-8 -*-
 
 from filecmp import cmp
-from os import makedirs, unlink
-from os.path import abspath, isdir, join
+from glob import glob
+from os import environ, makedirs, stat, unlink
+from os.path import abspath, exists, isdir, join
 from re import match
 from shutil import rmtree
+from tempfile import mkdtemp
 from testcase import TestCase, enumerate_tuples
 
 class TestBuiltins(TestCase):
@@ -370,4 +372,41 @@ foo()""", "4226")
         self._test("print(tee(42))", """42
 42""")
 
+    def _test_boot_snapshot(self, options):
+        self._test("""
+print([3, 1, 2].sort())
+print([1, 2].reduce(0) do |x, y|
+  next x + y
+end)
+""", "[1, 2, 3]3", options=options)
+
+    def test_boot_snapshot0(self):
+        dir = mkdtemp()
+        try:
+            path = join(dir, "boot.yogc")
+            options = ["--boot-snapshot=" + path]
+            self._test_boot_snapshot(options)
+            ino = stat(path).st_ino
+            # The second run reads the snapshot. A stale snapshot is replaced
+            # by renaming a new file, which changes the inode.
+            self._test_boot_snapshot(options)
+            assert stat(path).st_ino == ino
+        finally:
+            rmtree(dir)
+
+    def test_boot_snapshot10(self):
+        dir = mkdtemp()
+        old = environ.get("XDG_CACHE_HOME")
+        environ["XDG_CACHE_HOME"] = join(dir, "cache")
+        try:
+            self._test_boot_snapshot([])
+            paths = glob(join(dir, "cache", "yog", "*", "boot.yogc"))
+            assert len(paths) == 1
+        finally:
+            if old is None:
+                del environ["XDG_CACHE_HOME"]
+            else:
+                environ["XDG_CACHE_HOME"] = old
+            rmtree(dir)
+
 # vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
@@ -521,6 +521,46 @@ end
 co.resume()
 """, "42")
 
+    def test_machine_stack_size10(self):
+        # A size which is not a multiple of the page size
+        self._test("""
+co = Coroutine.new(machine_stack_size: 100000) do
+  print(42)
+end
+co.resume()
+""", "42")
+
+    def test_machine_stack0(self):
+        # Dead coroutines give their machine stacks to next ones.
+        self._test("""
+1000.times() do
+  co = Coroutine.new() do
+    Coroutine.yield()
+  end
+  co.resume()
+  co.resume()
+end
+co = Coroutine.new() do
+  print(42)
+end
+co.resume()
+""", "42")
+
+    def test_machine_stack10(self):
+        self._test("""
+coros = []
+1000.times() do
+  co = Coroutine.new() do
+    print(Coroutine.yield())
+  end
+  co.resume()
+  coros.push(co)
+end
+coros.each() do |co|
+  co.resume(".")
+end
+""", 1000 * ".")
+
     def test_bug0(self):
         # If any context are not resumed in Coroutine#yield, the following Yog
         # code causes segmentation fault. This bug appeared at commit
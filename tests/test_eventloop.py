@@ -0,0 +1,110 @@
+# -*- coding: utf-8 -*-
+
+from testcase import TestCase
+
+class TestEventLoop(TestCase):
+
+    def test_pipe0(self):
+        self._test("""
+import eventloop
+loop = eventloop.Loop.new()
+r, w = eventloop.pipe(loop)
+loop.spawn() do
+  print(r.read(16))
+  r.close()
+end
+loop.spawn() do
+  w.write("foo")
+  w.close()
+end
+loop.run()
+""", "foo")
+
+    def test_pipe10(self):
+        self._test("""
+import eventloop
+loop = eventloop.Loop.new()
+r, w = eventloop.pipe(loop)
+loop.spawn() do
+  while (s = r.read(16)) != ""
+    print(s)
+  end
+  r.close()
+end
+loop.spawn() do
+  w.write("foo")
+  loop.sleep(0.01)
+  w.write("bar")
+  w.close()
+end
+loop.run()
+""", "foobar")
+
+    def test_close0(self):
+        self._test("""
+import eventloop
+loop = eventloop.Loop.new()
+r, w = eventloop.pipe(loop)
+loop.spawn() do
+  try
+    r.read(16)
+  except IOError
+    print("closed")
+  end
+end
+loop.spawn() do
+  r.close()
+  w.close()
+end
+loop.run()
+""", "closed")
+
+    def test_sleep0(self):
+        self._test("""
+import eventloop
+loop = eventloop.Loop.new()
+loop.spawn() do
+  loop.sleep(0.02)
+  print(42)
+end
+loop.spawn() do
+  loop.sleep(0.01)
+  print(26)
+end
+loop.run()
+""", "2642")
+
+    def test_sleep10(self):
+        self._test("""
+import eventloop
+loop = eventloop.Loop.new()
+[5, 3, 0, 4, 1, 3, 2].each() do |n|
+  loop.spawn() do
+    loop.sleep(n / 100)
+    print(n)
+  end
+end
+loop.run()
+""", "0123345")
+
+    def test_tcp0(self):
+        self._test("""
+import eventloop
+loop = eventloop.Loop.new()
+server = eventloop.listen(loop, "127.0.0.1", 0)
+loop.spawn() do
+  conn = server.accept()
+  conn.write(conn.read(16))
+  conn.close()
+  server.close()
+end
+loop.spawn() do
+  client = eventloop.connect(loop, "127.0.0.1", server.port)
+  client.write("foo")
+  print(client.read(16))
+  client.close()
+end
+loop.run()
+""", "foo")
+
+# vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4 filetype=python
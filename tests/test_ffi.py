@@ -20,6 +20,23 @@ f = lib.load_func(\"foo\")
 f()
 """ % locals(), "42")
 
+    def test_load_func10(self):
+        path = get_lib_path()
+        self._test("""
+lib = load_lib(\"%(path)s\")
+f = lib.load_func(\"foo\", [], nil, blocking: true)
+f()
+""" % locals(), "42")
+
+    def test_load_func20(self):
+        path = get_lib_path()
+        self._test("""
+enable_gc_stress()
+lib = load_lib(\"%(path)s\")
+f = lib.load_func(\"print_string\", [[\'string, ENCODINGS[\"utf-8\"]]], blocking: true)
+f(\"foo\")
+""" % locals(), "foo", options=[])
+
     # Tests for uint8
     def test_Struct10(self):
         def test_stderr(stderr):
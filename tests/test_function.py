@@ -83,6 +83,49 @@ end
 
 puts(foo())
 """, """nil
+""")
+
+    def test_reused_frame0(self):
+        self._test("""
+def foo(a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p, q)
+    return a + b + c + d + e + f + g + h + i + j + k + l + m + n + o + p + q
+end
+
+def bar(a)
+    return a
+end
+
+def baz(a)
+    return bar(a) + foo(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17)
+end
+
+puts(baz(bar(42)))
+puts(baz(26))
+""", """195
+179
+""")
+
+    def test_reused_frame10(self):
+        self._test("""
+def foo(a)
+    def baz()
+        return a
+    end
+    return baz
+end
+
+def bar(a)
+    return a * 2
+end
+
+f = foo(42)
+g = foo(26)
+puts(bar(1))
+puts(f())
+puts(g())
+""", """2
+42
+26
 """)
 
     def test_uncallable0(self):
@@ -1,6 +1,7 @@
 # -*- coding: utf-8 -*-
 
-from testcase import TestCase
+import pytest
+from testcase import TestCase, get_gc_name
 
 class TestGc(TestCase):
 
@@ -14,4 +15,223 @@ end
     def test_gc_stress0(self):
         self._test("", options=[ "--gc-stress", "--gc-stress" ])
 
+    @pytest.mark.skipif("get_gc_name() == \"mark-sweep-compact\"")
+    def test_gc_threads0(self):
+        def test_stderr(stderr):
+            assert 0 <= stderr.find("--gc-threads is available only with the mark-sweep-compact GC.")
+        self._test("", stderr=test_stderr, status=1, options=[ "--gc-threads=4" ])
+
+    @pytest.mark.skipif("get_gc_name() != \"mark-sweep-compact\"")
+    def test_gc_threads10(self):
+        # The first major GC counts more living objects than
+        # PARALLEL_MARK_THRESHOLD, and the second one marks them in parallel.
+        self._test("""
+import gc
+a = []
+100000.times() do |n|
+    a << [n]
+end
+major_gc()
+major_gc()
+puts(0 < gc.stats()['parallel_mark_num])
+puts(a[99999][0])
+""", "true\n99999\n", options=[ "--gc-threads=4" ])
+
+    def test_gc_threads20(self):
+        def test_stderr(stderr):
+            assert 0 <= stderr.find("Invalid number of GC threads.")
+        self._test("", stdout=None, stderr=test_stderr, status=1, options=[ "--gc-threads=-1" ])
+
+    @pytest.mark.skipif("get_gc_name() != \"generational\"")
+    def test_local_gc0(self):
+        self._test("""
+import concurrent
+import gc
+
+def main()
+  threads = []
+  4.times() do
+    thread = concurrent.Thread.new() do
+      a = []
+      1000.times() do |n|
+        a << [n]
+        minor_gc()
+      end
+    end
+    thread.run()
+    threads << thread
+  end
+  a = []
+  1000.times() do |n|
+    a << [n]
+  end
+  minor_gc()
+  threads.each() do |thread|
+    thread.join()
+  end
+  puts(a.size)
+  puts(0 < gc.stats()['local_gc_num])
+end
+
+main()
+""", "1000\ntrue\n")
+
+    @pytest.mark.skipif("get_gc_name() != \"generational\"")
+    def test_local_gc10(self):
+        # Raising an exception stores it into the remembered thread object.
+        # Its children must be kept only once in a thread-local GC.
+        def test_stderr(stderr):
+            assert 0 <= stderr.find("Traceback (most recent call last):")
+            assert 0 <= stderr.find("TypeError: Fixnum is not callable")
+        self._test("""
+a = 42
+a()
+""", stderr=test_stderr, options=[ "--gc-stress" ])
+
+    def test_card0(self):
+        self._test("""
+a = []
+1000.times() do |n|
+    a << n
+end
+minor_gc()
+minor_gc()
+500.times() do |n|
+    a[2 * n] = [n]
+end
+minor_gc()
+minor_gc()
+puts(a[998][0])
+puts(a[999])
+""", "499\n999\n", options=[ "--max-age=1" ])
+
+    def test_large_object0(self):
+        self._test("""
+a = []
+20000.times() do |n|
+    a << n
+end
+minor_gc()
+a[19999] = [42]
+s = "x" * 100000
+minor_gc()
+major_gc()
+puts(a[19999][0])
+puts(s.size)
+""", "42\n100000\n")
+
+    def test_pause_target0(self):
+        self._test("""
+a = []
+100000.times() do |n|
+    a << [n]
+    if n % 1000 == 0
+        a = []
+    end
+end
+puts(a.size)
+""", "999\n", options=[ "--gc-pause-target=1", "--young-heap-size=64k" ])
+
+    def test_pause_target20(self):
+        # Every allocation runs a minor GC and a major GC, which resize the
+        # young generation just after survivors were copied.
+        self._test("""
+a = []
+3000.times() do |n|
+    a << [n]
+    if n % 100 == 0
+        a = []
+    end
+end
+puts(a.size)
+""", "99\n", options=[ "--gc-stress", "--gc-pause-target=1", "--young-heap-size=64k" ])
+
+    @pytest.mark.skipif("get_gc_name() != \"generational\"")
+    def test_pause_target10(self):
+        def test_stderr(stderr):
+            assert 0 <= stderr.find("Invalid GC pause target.")
+        self._test("", stdout=None, stderr=test_stderr, status=1, options=[ "--gc-pause-target=-1" ])
+
+    def test_stats0(self):
+        self._test("""
+import gc
+minor_gc()
+stats = gc.stats()
+puts(0 < stats['minor_gc]['num])
+puts(stats['minor_gc]['histogram].size)
+puts(0 < stats['allocated_size])
+puts(0 < stats['heap_size])
+""", "true\n6\ntrue\ntrue\n")
+
+    def test_gc_stats0(self):
+        def test_stderr(stderr):
+            assert 0 <= stderr.find("time to safepoint (max): ")
+            assert 0 <= stderr.find("minor GC (histogram): ")
+        self._test("""
+minor_gc()
+""", stderr=test_stderr, options=[ "--gc-stats" ])
+
+    def test_lazy_sweep0(self):
+        self._test("""
+a = []
+3.times() do
+    b = []
+    2000.times() do |n|
+        b << [n]
+    end
+    major_gc()
+    a = []
+    1000.times() do |n|
+        a << b[1000 + n]
+    end
+    b = nil
+    major_gc()
+    10000.times() do |n|
+        [n]
+    end
+end
+puts(a.size)
+puts(a[999][0])
+""", "1000\n1999\n", options=[ "--young-heap-size=64k" ])
+
+    def test_release_arenas0(self):
+        self._test("""
+import gc
+a = []
+100000.times() do |n|
+    a << [n]
+end
+major_gc()
+peak = gc.stats()['heap_size]
+a = nil
+major_gc()
+major_gc()
+puts(gc.stats()['heap_size] < peak)
+""", "true\n", options=[ "--max-age=1", "--heap-headroom=0" ])
+
+    def test_heap_headroom0(self):
+        def test_stderr(stderr):
+            assert 0 <= stderr.find("Invalid heap headroom.")
+        self._test("", stdout=None, stderr=test_stderr, status=1, options=[ "--heap-headroom=-1" ])
+
+    def test_heap_profile0(self):
+        path = self.make_temp_file(suffix=".folded")
+        try:
+            self._test("""
+class Foo
+end
+a = []
+10000.times() do |n|
+    a << Foo.new()
+end
+major_gc()
+""", options=[ "--heap-profile=" + path, "--heap-profile-rate=1" ])
+            profile = open(path).read()
+            assert 0 <= profile.find(";Foo ")
+            live = open(path + ".live").read()
+            assert 0 <= live.find("Foo ")
+        finally:
+            self.unlink(path)
+            self.unlink(path + ".live")
+
 # vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
@@ -1,10 +1,13 @@
 # -*- coding: utf-8 -*-
 
-from os import chdir, getcwd
-from os.path import dirname
+from os import chdir, environ, getcwd
+from os.path import dirname, exists, join
 from re import match
+from shutil import rmtree
+from subprocess import PIPE, Popen
+from tempfile import mkdtemp
 
-from testcase import TestCase
+from testcase import TestCase, get_command
 
 class TestImport(TestCase):
 
@@ -115,4 +118,82 @@ print(test_package8.foo.bar)
     def test_lib_path0(self):
         self.run_test("import foo", "42", options=["--lib-path=test_lib_path0"])
 
+    def run_cache_test(self, srcs, stdouts):
+        dir = mkdtemp()
+        try:
+            options = ["--lib-path=" + dir]
+            for src, stdout in zip(srcs, stdouts):
+                self.write_source(join(dir, "foo.yog"), src)
+                self._test("import foo", stdout, options=options)
+                assert exists(join(dir, "foo.yogc"))
+        finally:
+            rmtree(dir)
+
+    def test_code_cache0(self):
+        src = """
+def bar(x, y=1, *z)
+  return x + y + z.size
+end
+
+class Baz
+  def init(s)
+    self.s = s
+  end
+end
+
+puts(bar(40, 1, 42))
+puts(Baz.new("foo").s)
+puts(4294967296000000000000)
+puts(3.5 < 4.0)
+puts('qux)
+"""
+        stdout = """42
+foo
+4294967296000000000000
+true
+qux
+"""
+        self.run_cache_test([src, src], [stdout, stdout])
+
+    def test_code_cache10(self):
+        # The second source has the same size and likely the same mtime.
+        self.run_cache_test(["puts(42)", "puts(26)"], ["42\n", "26\n"])
+
+    def test_code_cache20(self):
+        self.run_cache_test(["puts(42)", "puts(42 + 26)"], ["42\n", "68\n"])
+
+    def test_code_cache30(self):
+        # A source without a coding comment is decoded in the default encoding,
+        # so its cache must not be used in another one.
+        dir = mkdtemp()
+        try:
+            self.write_source(join(dir, "foo.yog"), u"puts(\"\u3042\".size)", "utf-8")
+            main = join(dir, "main.yog")
+            self.write_source(main, "import foo")
+            for lang, stdout in [("ja_JP.UTF-8", "1\n"), ("C", "3\n"), ("ja_JP.UTF-8", "1\n")]:
+                env = environ.copy()
+                env["LANG"] = lang
+                args = [get_command(), "--lib-path=" + dir, main]
+                proc = Popen(args, stdout=PIPE, env=env, universal_newlines=True)
+                assert proc.communicate()[0] == stdout
+                assert proc.returncode == 0
+        finally:
+            rmtree(dir)
+
+    def test_code_cache40(self):
+        # An imported name is a local variable of the package.
+        src = """
+import base64
+puts(base64.base64_to_s("Kg==", ENCODINGS["utf-8"]))
+"""
+        self.run_cache_test([src, src], ["*\n", "*\n"])
+
+    def test_code_cache50(self):
+        src = """
+puts(/fO+/i.search("xfoo").group())
+puts(/fO+/.search("xfoo"))
+"""
+        stdout = "foo\nnil\n"
+        self.run_cache_test([src, src], [stdout, stdout])
+
 # vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
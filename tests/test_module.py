@@ -20,4 +20,31 @@ baz = Baz.new()
 baz.bar()
 """, "42")
 
+    def test_include_after_call(self):
+        self._test("""
+module Foo
+  def bar()
+    print(42)
+  end
+end
+
+class Baz
+  def bar()
+    print(26)
+  end
+end
+
+class Quux > Baz
+end
+
+def call_bar(obj)
+  obj.bar()
+end
+
+quux = Quux.new()
+call_bar(quux)
+include_module(Quux, Foo)
+call_bar(quux)
+""", "2642")
+
 # vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
@@ -44,6 +44,42 @@ AttributeError: String object has no attribute "bar"
 "foo".bar = 42
 """, stderr=test_stderr)
 
+    def test_set_attribute20(self):
+        self._test("""
+def make(x, y)
+  o = Object.new()
+  o.x = x
+  o.y = y
+  return o
+end
+
+foo = make(42, 26)
+bar = make("foo", "bar")
+baz = Object.new()
+baz.y = 0
+baz.x = 1
+bar.x = "baz"
+print(foo.x, foo.y, bar.x, bar.y, baz.x, baz.y)
+""", "4226bazbar10")
+
+    def test_set_attribute30(self):
+        src = ["o = Object.new()"]
+        for i in range(80):
+            src.append("o.foo%d = %d" % (i, i))
+        src.append("o.foo0 = 42")
+        src.append("print(o.foo0, o.foo63, o.foo64, o.foo79)")
+        self._test("\n".join(src) + "\n", "42636479")
+
+    def test_set_attribute40(self):
+        # Objects with many distinct attribute names fall back to symbol tables.
+        src = []
+        for i in range(40):
+            src.append("o%d = Object.new()" % (i, ))
+            src.append("o%d.foo%d = %d" % (i, i, i))
+            src.append("o%d.bar = %d" % (i, i))
+        src.append("print(o0.foo0, o0.bar, o39.foo39, o39.bar)")
+        self._test("\n".join(src) + "\n", "003939")
+
     def test_kind_of0(self):
         self._test("""
 print(Object.new().kind_of?(Object))
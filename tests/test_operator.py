@@ -757,4 +757,57 @@ print(Foo.new()[26] = 42)
     def test_conditional_operator50(self):
         self._test("print(true ? \"foo\" : 42 + 26)", "foo")
 
+    def test_quickening0(self):
+        self._test("""
+def add(a, b)
+  return a + b
+end
+puts(add(42, 26))
+puts(add(42, 26))
+puts(add(4611686018427387903, 1))
+puts(add(1.5, 2.25))
+puts(add(1.5, 2.25))
+puts(add("foo", "bar"))
+puts(add(42, 26))
+""", """68
+68
+4611686018427387904
+3.75
+3.75
+foobar
+68
+""")
+
+    def test_quickening10(self):
+        self._test("""
+def sub(a, b)
+  return a - b
+end
+puts(sub(42, 26))
+puts(sub(-4611686018427387904, 1))
+puts(sub(3.75, 2.25))
+puts(sub(42, 0.5))
+puts(sub(42, 26))
+""", """16
+-4611686018427387905
+1.5
+41.5
+16
+""")
+
+    def test_quickening20(self):
+        self._test("""
+def less(a, b)
+  return a < b
+end
+puts(less(26, 42))
+puts(less(42, 26))
+puts(less("bar", "foo"))
+puts(less(26, 42))
+""", """true
+false
+true
+true
+""")
+
 # vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
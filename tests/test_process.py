@@ -31,6 +31,13 @@ finally
   proc.wait()
 end""", stderr=test_stderr)
 
+    def test_blocking0(self):
+        self._test("""
+proc = Process.new([\"/bin/echo\", \"foo\"]).run()
+print(proc.stdout.readline())
+print(proc.wait())
+""", "foo\n0")
+
     def test_kill_term0(self):
         self._test("Process.new([\"/bin/cat\"]).run().kill_term()")
 
@@ -82,4 +82,38 @@ puts(42)
 42
 """)
 
+    def test_less0(self):
+        self._test("""
+i = 0.5
+while i < 3.0
+    print(i)
+    i = i + 1.0
+end""", "0.51.52.5")
+
+    def test_less10(self):
+        self._test("""
+s = "a"
+while s < "aaa"
+    print(s)
+    s = s + "a"
+end""", "aaa")
+
+    def test_less20(self):
+        self._test("""
+class Foo
+    def init(n)
+        self.n = n
+    end
+
+    def <(other)
+        return self.n < other
+    end
+end
+
+foo = Foo.new(0)
+while foo < 3
+    print(foo.n)
+    foo.n = foo.n + 1
+end""", "012")
+
 # vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
@@ -38,6 +38,14 @@ def get_command():
         pass
     return abspath(join(abspath(dirname(__file__)), "..", "src", "yog"))
 
+def get_gc_name():
+    args = [get_command(), "--version"]
+    out = Popen(args, stdout=PIPE, universal_newlines=True).communicate()[0]
+    m = search(r"(\S+) GC$", out.strip())
+    if m is None:
+        return "generational"
+    return m.group(1)
+
 class TestCase(object):
 
     def get_exact_path(self, name):
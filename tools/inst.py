@@ -7,6 +7,7 @@ from os.path import join
 from re import finditer
 from string import Template
 from sys import argv
+from zlib import crc32
 import re
 
 class Operand(object):
@@ -20,8 +21,9 @@ class Operand(object):
 
 class Inst(object):
 
-    def __init__(self, name, lineno):
+    def __init__(self, name, lineno, derived=False):
         self.name = name
+        self.derived = derived
         self.operands = []
         self.pop_values = []
         self.pop_size = "0"
@@ -59,7 +61,7 @@ class CodeGenerator(object):
 
     comment_start = re.compile(r"\A/\*")
     comment_end = re.compile(r"\*/\Z")
-    inst_start = re.compile(r"\Ainst\s+(?P<name>\w+)\Z")
+    inst_start = re.compile(r"\Ainst\s+(?P<name>\w+)(\s+(?P<attr>derived))?\Z")
     inst_end = re.compile(r"\A}\Z")
 
     def split_values(self, s):
@@ -76,8 +78,8 @@ class CodeGenerator(object):
         u = s[n + len(t):]
         return finditer(r"(?P<star>\*)|(?P<plus>\+)|(?P<name>[a-z]+)|(?P<number>[0-9]+)", u)
 
-    def parse_inst(self, name):
-        inst = Inst(name, self.lineno)
+    def parse_inst(self, name, attr):
+        inst = Inst(name, self.lineno, attr == "derived")
 
         line = self.readline()
         operands = self.split_values(line)
@@ -168,7 +170,10 @@ class CodeGenerator(object):
             s = "    OP(%(name)s) = %(i)d,\n" \
                     % { "name": inst.name.upper(), "i": i }
             opcodes.write(s)
-        kw = { "opcodes": opcodes.getvalue() }
+        kw = {
+                "opcodes": opcodes.getvalue(),
+                "opcodes_num": len(self.insts),
+                "opcodes_digest": "0x%08x" % (self.digest, ) }
         s = self.substitute_template(opcodes_h_tmpl, kw)
         self.write_file(opcodes_h, s)
 
@@ -213,21 +218,11 @@ class CodeGenerator(object):
             lineno += 1
 
             s = """
-    case OP(%(name)s):
+    INST_BEGIN(%(name)s)
         {""" % { "name": inst.name.upper() }
             lineno += len(s.split("\n")) - 1
             inc.write(s)
 
-            if 0 < len(inst.operands):
-                s = """
-            YogVal __frame__ = env->frame;
-            YogVal __code__ = SCRIPT_FRAME(__frame__)->code;
-            YogVal __insts__ = PTR_AS(YogCode, __code__)->insts;
-            const char* __bytes__ = PTR_AS(YogByteArray, __insts__)->items;
-            uint_t __size__ = PTR_AS(YogByteArray, __insts__)->size;
-            pc_t __pc__ = SCRIPT_FRAME(__frame__)->pc;"""
-                lineno += len(s.split("\n")) - 1
-                inc.write(s)
             declared_names = set()
             for operand in inst.operands:
                 name = operand.name
@@ -235,15 +230,17 @@ class CodeGenerator(object):
                     raise Exception("%(name)s is used." % { "name": name })
 
                 s = """
-            YOG_ASSERT(env, __pc__ < __size__, "pc is over code length.");
-            %(type)s %(name)s = *((%(type)s*)(&__bytes__[__pc__]));
-            __pc__ += sizeof(%(type)s);""" % { "type": operand.type, "name": name }
+            YOG_ASSERT(env, pc < INSTS_SIZE, "pc is over code length.");
+            %(type)s %(name)s = *((%(type)s*)(&INSTS_BYTES[pc]));
+            pc += sizeof(%(type)s);""" % { "type": operand.type, "name": name }
                 lineno += len(s.split("\n")) - 1
                 inc.write(s)
                 declared_names.add(name)
-            if 0 < len(inst.operands):
+            if 0 < len(inst.codes):
+                # The body may call a function or raise an exception, both of
+                # which read pc of the current frame.
                 s = """
-            SCRIPT_FRAME(__frame__)->pc = __pc__;"""
+            SAVE_PC();"""
                 lineno += len(s.split("\n")) - 1
                 inc.write(s)
 
@@ -311,7 +308,7 @@ class CodeGenerator(object):
                 inc.write(s)
 
             s = """
-            break;
+            INST_END;
         }"""
             lineno += len(s.split("\n")) - 1
             inc.write(s)
@@ -319,6 +316,14 @@ class CodeGenerator(object):
         inc.write("\n" + self.get_c_footer())
         self.write_file(eval_inc, inc.getvalue())
 
+    def gen_eval_labels_inc(self, eval_labels_inc):
+        labels = StringIO()
+        for inst in self.insts:
+            labels.write("""
+    &&INST_LABEL(%(name)s),""" % { "name": inst.name.upper() })
+        labels.write("\n" + self.get_c_footer())
+        self.write_file(eval_labels_inc, labels.getvalue())
+
     def type_name2func_name(self, name):
         name = name.lower().replace(" ", "_")
         suffix = "_t"
@@ -326,17 +331,32 @@ class CodeGenerator(object):
             name = name[:- len(suffix)]
         return name
 
+    def get_id_offset(self, inst):
+        ids = [i for i, operand in enumerate(inst.operands)
+                if operand.type == "ID"]
+        if len(ids) == 0:
+            return "0"
+        assert len(ids) == 1, "%s has two or more ID operands" % (inst.name, )
+        return " + ".join(["sizeof(uint8_t)"] + [
+            "sizeof(%(type)s)" % { "type": operand.type }
+            for operand in inst.operands[:ids[0]]])
+
     def gen_inst_c(self, inst_c, inst_c_tmpl):
         inst2size = StringIO()
+        inst2id_offset = StringIO()
         for inst in self.insts:
             inst2size.write(" " * 8 + "sizeof(uint8_t)")
             for i, operand in enumerate(inst.operands):
                 inst2size.write(
                         " + sizeof(%(type)s)" % { "type": operand.type })
             inst2size.write(", /* %(name)s */\n" % { "name": inst.name })
+            inst2id_offset.write(" " * 8 + "%(offset)s, /* %(name)s */\n" % {
+                "offset": self.get_id_offset(inst), "name": inst.name })
 
-        s = self.substitute_template(
-                inst_c_tmpl, { "inst2size": inst2size.getvalue() })
+        kw = {
+                "inst2size": inst2size.getvalue(),
+                "inst2id_offset": inst2id_offset.getvalue() }
+        s = self.substitute_template(inst_c_tmpl, kw)
         with open(inst_c, "w") as f:
             f.write(self.make_attention())
             f.write(s)
@@ -371,7 +391,7 @@ class CodeGenerator(object):
     def gen_compile_inc(self, compile_inc, compile_inc_tmpl):
         compile_data = StringIO()
         for inst in self.insts:
-            if inst.name == "finish":
+            if (inst.name == "finish") or inst.derived:
                 continue
 
             compile_data.write("""
@@ -487,6 +507,7 @@ CompileData_add_%(inst)s(YogEnv* env, YogVal data, uint_t lineno""" % { "inst":
             code_inc_tmpl=None, debug=False, basedir=""):
         self.open(def_)
         self.parse_def()
+        self.digest = crc32("".join(self.lines)) & 0xffffffff
         if debug:
             for inst in self.insts:
                 print `inst`
@@ -506,6 +527,10 @@ CompileData_add_%(inst)s(YogEnv* env, YogVal data, uint_t lineno""" % { "inst":
         eval_inc = eval_inc or join(basedir, src_dir, "eval.inc")
         self.gen_eval_inc(def_, eval_inc)
 
+        # Generate eval_labels.inc (no templates).
+        eval_labels_inc = join(basedir, src_dir, "eval_labels.inc")
+        self.gen_eval_labels_inc(eval_labels_inc)
+
         # Generate compile.inc.
         compile_inc = compile_inc or join(basedir, src_dir, "compile.inc")
         compile_inc_tmpl = compile_inc_tmpl or compile_inc + ".tmpl"